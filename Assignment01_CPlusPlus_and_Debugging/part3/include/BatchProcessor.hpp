@@ -0,0 +1,36 @@
+/** @file BatchProcessor.hpp
+ *  @brief Runs a list of operations over many PPM files at once.
+ *
+ *  Usage:
+ *
+ *      ./prog [-j threads] [-o outputDirectory] -p operations inputs...
+ *
+ *  inputs are .ppm files or directories (every .ppm directly inside a
+ *  directory is used). Globs such as *.ppm are expanded by the shell.
+ *  operations is a comma separated list applied in order:
+ *
+ *      darken, lighten          halve or double every color value
+ *      resize=WxH               bilinear resize to W by H pixels
+ *      convolve=blur|sharpen|edge
+ *                               3x3 filter
+ *      p3, p6                   save as ASCII or binary (default: same as input)
+ *
+ *  e.g. ./prog -p resize=256x256,sharpen,p6 ../../common/textures
+ *
+ *  Each file is one task on a WorkStealingPool, and each task works on
+ *  a single thread, so the pool decides how the cores are shared.
+ *  Results go to outputDirectory (./batch_out by default) under the
+ *  input's file name, so two inputs with the same file name are rejected. The time, MB/s, and megapixels/s of every file is
+ *  printed as it finishes, followed by the totals for the whole batch.
+ *
+ *  @author your_name_here
+ *  @bug No known bugs.
+ */
+#ifndef BATCHPROCESSOR_HPP
+#define BATCHPROCESSOR_HPP
+
+// Parses the command line above and processes every file.
+// Returns 0 if every file was processed, 1 otherwise.
+int runBatch(int argc, char* argv[]);
+
+#endif
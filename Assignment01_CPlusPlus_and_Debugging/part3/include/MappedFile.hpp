@@ -0,0 +1,55 @@
+/** @file MappedFile.hpp
+ *  @brief Gives read access to the raw bytes of a file.
+ *
+ *  On Linux and Mac the file is memory mapped (mmap), so no copy of the
+ *  file is made until a page is actually touched. The mapping is private,
+ *  meaning writes to the bytes only change our copy, never the file.
+ *  On other platforms the file is simply read into a heap buffer.
+ *
+ *  @author your_name_here
+ *  @bug No known bugs.
+ */
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+class MappedFile{
+public:
+    // Constructor
+    MappedFile();
+    // Destructor unmaps (or frees) the file data
+    ~MappedFile();
+    // A mapping has a single owner, so it may be moved but not copied.
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+    // Maps the file at filepath. Returns false if it cannot be opened.
+    bool Open(const std::string& filepath);
+    // Releases the data
+    void Close();
+    // Returns a pointer to the first byte of the file
+    inline uint8_t* GetData() const{
+        return m_data;
+    }
+    // Returns the size of the file in bytes
+    inline size_t GetSize() const{
+        return m_size;
+    }
+    // Returns true if a file is currently open
+    inline bool IsOpen() const{
+        return m_data != nullptr;
+    }
+private:
+    // Bytes of the file
+    uint8_t* m_data{nullptr};
+    // Number of bytes in the file
+    size_t m_size{0};
+    // True if m_data came from mmap, false if it was allocated with new[]
+    bool m_mapped{false};
+};
+
+#endif
@@ -1,7 +1,7 @@
 /** @file PPM.hpp
  *  @brief Class for working with PPM images
  *  
- *  Class for working with P3 PPM images specifically.
+ *  Class for working with P3 (ASCII) and P6 (binary) PPM images.
  *
  *  @author your_name_here
  *  @bug No known bugs.
@@ -12,15 +12,31 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+
+#include "ImageCompare.hpp"
+
+class PixelPipeline;
 
 class PPM{
 public:
     // Constructor loads a filename with the .ppm extension
-    PPM(std::string fileName);
+    // Either P3 or P6 files may be loaded.
+    // threadCount of 0 decodes P3 files with one thread per core.
+    PPM(std::string fileName, unsigned int threadCount=0);
     // Destructor clears any memory that has been allocated
     ~PPM();
     // Saves a PPM Image to a new file.
-    void savePPM(std::string outputFileName) const;
+    // binary - true writes a P6 file, false (the default) writes a P3 file.
+    // threadCount of 0 formats P3 files with one thread per core.
+    // Returns false (and prints why) if the file could not be written.
+    bool savePPM(std::string outputFileName, bool binary=false, unsigned int threadCount=0) const;
+    // Measures how different this image is from other (see ImageCompare.hpp).
+    // Returns false if the two images are not the same size.
+    bool compare(const PPM& other, ImageDifference& result, const CompareSettings& settings=CompareSettings()) const;
+    // Writes a P6 heatmap of where this image differs from other.
+    // scale of 0 makes the largest difference white.
+    void saveDifferenceHeatmap(const PPM& other, std::string outputFileName, int scale=0) const;
     // Darken halves (integer division by 2) each of the red, green
     // and blue color components of all of the pixels
     // in the PPM. Note that no values may be less than
@@ -31,6 +47,22 @@ public:
     // in the PPM. Note that no values may be greater than
     // 255 in a ppm.
     void lighten();
+    // The same operations on a plain array of color values, so they can
+    // also be applied a band at a time to a stream (see PPMStream.hpp).
+    static void darkenValues(uint8_t* values, size_t count);
+    static void lightenValues(uint8_t* values, size_t count);
+    // Runs a chain of per-pixel operations (see PixelPipeline.hpp) over
+    // every pixel in a single pass, e.g.
+    // myPPM.apply(PixelPipeline().grayscale().threshold(128));
+    void apply(const PixelPipeline& pipeline, unsigned int threadCount=0);
+    // Resizes the image to width x height. Each new pixel blends the
+    // four nearest old pixels (bilinear filtering).
+    void resize(int width, int height);
+    // Replaces each color component with the weighted sum of the 3x3
+    // block around it, clamped to 0 through the maximum color value.
+    // kernel holds the 9 weights, top row first.
+    // Pixels past the edge repeat the nearest edge pixel.
+    void convolve(const float kernel[9]);
     // Sets a pixel to a specific R,G,B value 
     // Note: You do not have to use this function in your implementation,
     //       but it is probably a useful helper function to have.
@@ -46,6 +78,8 @@ public:
     inline int getWidth() const { return m_width; }
     // Returns image height
     inline int getHeight() const { return m_height; }
+    // Returns true if the file loaded was a P6 (binary) file
+    inline bool isBinary() const { return m_binary; }
 // NOTE:    You may add any helper functions you like in the
 //          private section.
 private:    
@@ -59,6 +93,7 @@ private:
     int m_height{0};
     int m_maxrange{0};
     int m_maxColorValue{0};
+    bool m_binary{false};
 };
 
 
@@ -0,0 +1,90 @@
+/** @file PPMStream.hpp
+ *  @brief Reads and writes PPM images a band of rows at a time.
+ *
+ *  The PPM class holds every pixel of an image in memory, which is not
+ *  possible for images larger than RAM. PPMReader hands out a few rows
+ *  at a time from a P3 or P6 file, and PPMWriter appends rows to a new
+ *  file, so an image of any size can be processed in a fixed amount of
+ *  memory.
+ *
+ *  @author your_name_here
+ *  @bug No known bugs.
+ */
+#ifndef PPMSTREAM_HPP
+#define PPMSTREAM_HPP
+
+#include "PPMFormat.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+class PPMReader{
+public:
+    // textBufferSize is how many bytes of a P3 file are held at once.
+    // Numbers and comments may be split across reads of any size.
+    PPMReader(size_t textBufferSize = 1024*1024);
+    // Opens a file and reads its header. Returns false if the file can
+    // not be opened or is not a P3 or P6 PPM.
+    bool open(std::string fileName);
+    // Reads up to maxRows rows of R,G,B values into out, which must hold
+    // maxRows*width*3 bytes. Returns the number of rows read, which is
+    // 0 once every row has been read.
+    int readRows(uint8_t* out, int maxRows);
+    // Image width
+    inline int getWidth() const { return m_header.width; }
+    // Image height
+    inline int getHeight() const { return m_header.height; }
+    // Maximum color value
+    inline int getMaxColorValue() const { return m_header.maxValue; }
+    // True for a P6 (binary) source
+    inline bool isBinary() const { return m_header.binary; }
+private:
+    // Reads more of a P3 file and decodes every complete value in it
+    bool fillValues();
+
+    std::ifstream m_file;
+    PPMHeader m_header;
+    // Rows handed out so far
+    int m_rowsRead{0};
+    // P3 text that has been read but not decoded yet
+    std::vector<uint8_t> m_text;
+    size_t m_textSize{0};
+    // P3 values that have been decoded but not handed out yet
+    std::vector<uint8_t> m_values;
+    size_t m_valuesBegin{0};
+    size_t m_valuesEnd{0};
+    bool m_endOfFile{false};
+    // True while skipping a comment that started in an earlier read
+    bool m_inComment{false};
+};
+
+class PPMWriter{
+public:
+    // Creates a file and writes its header. Returns false if the file
+    // can not be created.
+    bool open(std::string fileName, int width, int height, int maxColorValue, bool binary);
+    // Appends rowCount rows of R,G,B values to the file
+    bool writeRows(const uint8_t* rows, int rowCount);
+    // Finishes the file. Returns false if fewer rows than the header
+    // promised were written, or if anything failed to write.
+    bool close();
+private:
+    std::ofstream m_file;
+    int m_width{0};
+    int m_height{0};
+    bool m_binary{false};
+    int m_rowsWritten{0};
+    // Text of the rows being written (P3 only)
+    std::vector<char> m_text;
+};
+
+// Reads inputFileName a band of rows at a time, calls operation on the
+// R,G,B values of each band, and writes the result to outputFileName.
+// Roughly memoryBudget bytes are used no matter how large the image is.
+bool transformPPM(std::string inputFileName, std::string outputFileName, bool binary,
+                  size_t memoryBudget, const std::function<void(uint8_t*, size_t)>& operation);
+
+#endif
@@ -0,0 +1,57 @@
+/** @file PixelPipeline.hpp
+ *  @brief Chains per-pixel operations and runs them in a single pass.
+ *
+ *  Calling darken() and then lighten() on a PPM walks over every pixel
+ *  twice. A PixelPipeline instead records a list of operations, e.g.
+ *
+ *      PixelPipeline().scale(0.5f).add(20).invert()
+ *
+ *  and nothing happens until run() is called. run() then goes over the
+ *  image once: a small tile of pixels is loaded, every operation is
+ *  applied to it while it is still in the cache, and it is stored back.
+ *  The operations work on 16 or 32 bytes at a time (SSE2 / SSSE3 / AVX2,
+ *  whichever the CPU has, with plain C++ otherwise) and large images are
+ *  split into bands of rows on separate threads.
+ *
+ *  All operations saturate, so results always stay within 0-255.
+ *
+ *  @author your_name_here
+ *  @bug No known bugs.
+ */
+#ifndef PIXELPIPELINE_HPP
+#define PIXELPIPELINE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class PixelPipeline{
+public:
+    // Multiplies every color value by factor (0 to 255.99).
+    // The factor is kept to 1/256ths, and the result rounds down.
+    PixelPipeline& scale(float factor);
+    // Adds amount (which may be negative) to every color value
+    PixelPipeline& add(int amount);
+    // Replaces every color value v with 255-v
+    PixelPipeline& invert();
+    // Replaces R,G,B with their luminance (0.30 R + 0.59 G + 0.11 B)
+    PixelPipeline& grayscale();
+    // Color values of at least level become 255, the rest become 0
+    PixelPipeline& threshold(uint8_t level);
+    // Runs every operation, in the order they were added, over
+    // pixelCount R,G,B pixels. threadCount of 0 uses one thread per core.
+    void run(uint8_t* pixels, size_t pixelCount, unsigned int threadCount = 0) const;
+    // True if no operations have been added
+    inline bool empty() const { return m_ops.empty(); }
+private:
+    enum class OpType { Scale, Add, Invert, Grayscale, Threshold };
+    struct Op {
+        OpType type;
+        int value;
+    };
+    // Runs every operation over one tile of pixels
+    void runTile(uint8_t* values, size_t count) const;
+    std::vector<Op> m_ops;
+};
+
+#endif
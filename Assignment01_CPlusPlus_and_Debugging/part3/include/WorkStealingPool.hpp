@@ -0,0 +1,71 @@
+/** @file WorkStealingPool.hpp
+ *  @brief A fixed set of worker threads that steal work from each other.
+ *
+ *  Every worker owns a queue of tasks. A worker takes new work from the
+ *  back of its own queue, and when that queue is empty it takes work from
+ *  the front of another worker's queue instead. Tasks that take very
+ *  different amounts of time (e.g. a 4K image next to a thumbnail) then
+ *  still keep every core busy until the last task is done.
+ *
+ *  @author your_name_here
+ *  @bug No known bugs.
+ */
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+class WorkStealingPool{
+public:
+    // Starts threadCount workers. threadCount of 0 starts one per core.
+    WorkStealingPool(unsigned int threadCount=0);
+    // Waits for every task to finish and stops the workers
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Queues a task. Tasks are handed to the workers in turn.
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task has finished
+    void wait();
+    // Number of worker threads
+    inline unsigned int threadCount() const { return static_cast<unsigned int>(m_workers.size()); }
+    // Number of tasks a worker took from another worker's queue
+    inline size_t stolenCount() const { return m_stolen; }
+
+private:
+    // A task queue and the lock that guards it
+    struct WorkQueue{
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Main loop of worker number index
+    void workerLoop(unsigned int index);
+    // Takes a task from the back of queue index, or the front of any
+    // other queue. Returns false if every queue is empty.
+    bool takeTask(unsigned int index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    // Workers sleep on m_wakeCondition when there is nothing to do, and
+    // wait() sleeps on m_doneCondition until m_pending reaches 0.
+    std::mutex m_stateMutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    std::atomic<size_t> m_queued{0};
+    size_t m_pending{0};
+    bool m_stopping{false};
+    std::atomic<unsigned int> m_nextQueue{0};
+    std::atomic<size_t> m_stolen{0};
+};
+
+#endif
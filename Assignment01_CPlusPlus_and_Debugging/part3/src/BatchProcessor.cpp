@@ -0,0 +1,193 @@
+#include "BatchProcessor.hpp"
+#include "WorkStealingPool.hpp"
+#include "PPM.hpp"
+#include "PixelPipeline.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+// One step of the operation list
+struct BatchOperation {
+    enum Type { Darken, Lighten, Resize, Convolve };
+    Type type;
+    int width{0};
+    int height{0};
+    float kernel[9];
+};
+
+// Everything parsed from the command line
+struct BatchSettings {
+    std::vector<BatchOperation> operations;
+    std::vector<fs::path> inputs;
+    fs::path outputDirectory{"./batch_out"};
+    unsigned int threadCount{0};
+    // -1 keeps the format of each input, 0 writes P3, 1 writes P6
+    int binary{-1};
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printUsage() {
+    std::cerr << "Usage: prog [-j threads] [-o outputDirectory] -p operations inputs..." << std::endl;
+    std::cerr << "  operations: darken,lighten,resize=WxH,convolve=blur|sharpen|edge,p3,p6" << std::endl;
+}
+
+static bool parseKernel(const std::string& name, float kernel[9]) {
+    static const float blur[9] = {1/16.0f, 2/16.0f, 1/16.0f, 2/16.0f, 4/16.0f, 2/16.0f, 1/16.0f, 2/16.0f, 1/16.0f};
+    static const float sharpen[9] = {0, -1, 0, -1, 5, -1, 0, -1, 0};
+    static const float edge[9] = {-1, -1, -1, -1, 8, -1, -1, -1, -1};
+    const float* chosen = nullptr;
+    if (name == "blur") { chosen = blur; }
+    else if (name == "sharpen") { chosen = sharpen; }
+    else if (name == "edge") { chosen = edge; }
+    if (chosen == nullptr) { return false; }
+    std::copy(chosen, chosen + 9, kernel);
+    return true;
+}
+
+// Splits "darken,resize=64x64,p6" into operations
+static bool parseOperations(const std::string& list, BatchSettings& settings) {
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        BatchOperation operation{};
+        std::string name = item.substr(0, item.find('='));
+        std::string value = item.find('=') == std::string::npos ? "" : item.substr(item.find('=') + 1);
+        if (name == "darken") { operation.type = BatchOperation::Darken; }
+        else if (name == "lighten") { operation.type = BatchOperation::Lighten; }
+        else if (name == "p3") { settings.binary = 0; continue; }
+        else if (name == "p6") { settings.binary = 1; continue; }
+        else if (name == "resize") {
+            operation.type = BatchOperation::Resize;
+            char separator = 0;
+            std::stringstream size(value);
+            if (!(size >> operation.width >> separator >> operation.height) || separator != 'x' || operation.width <= 0 || operation.height <= 0) { std::cerr << "Error: resize needs a size like resize=256x256" << std::endl; return false; }
+        }
+        else if (name == "convolve" || name == "blur" || name == "sharpen" || name == "edge") {
+            operation.type = BatchOperation::Convolve;
+            if (!parseKernel(name == "convolve" ? value : name, operation.kernel)) { std::cerr << "Error: unknown kernel " << item << std::endl; return false; }
+        }
+        else { std::cerr << "Error: unknown operation " << item << std::endl; return false; }
+        settings.operations.push_back(operation);
+    }
+    return true;
+}
+
+static bool parseArguments(int argc, char* argv[], BatchSettings& settings) {
+    bool haveOperations = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if ((argument == "-j" || argument == "-o" || argument == "-p") && i + 1 >= argc) { std::cerr << "Error: " << argument << " needs a value" << std::endl; return false; }
+        if (argument == "-j") {
+            char* end = nullptr;
+            long threads = std::strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || threads < 1 || threads > 1024) { std::cerr << "Error: -j needs a thread count from 1 to 1024, not " << argv[i] << std::endl; return false; }
+            settings.threadCount = static_cast<unsigned int>(threads);
+        }
+        else if (argument == "-o") { settings.outputDirectory = argv[++i]; }
+        else if (argument == "-p") {
+            if (!parseOperations(argv[++i], settings)) { return false; }
+            haveOperations = true;
+        }
+        else if (fs::is_directory(argument)) {
+            // Sorted so the output order is the same from run to run
+            std::vector<fs::path> found;
+            for (const fs::directory_entry& entry : fs::directory_iterator(argument)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".ppm") { found.push_back(entry.path()); }
+            }
+            std::sort(found.begin(), found.end());
+            settings.inputs.insert(settings.inputs.end(), found.begin(), found.end());
+        }
+        else if (fs::is_regular_file(argument)) { settings.inputs.push_back(argument); }
+        else { std::cerr << "Error: input " << argument << " not found" << std::endl; return false; }
+    }
+    if (!haveOperations || settings.inputs.empty()) { printUsage(); return false; }
+    // Every result is named after its input, so two inputs with the same
+    // file name would overwrite each other's result
+    std::vector<fs::path> sorted = settings.inputs;
+    std::sort(sorted.begin(), sorted.end(), [](const fs::path& a, const fs::path& b) { return a.filename() < b.filename(); });
+    for (size_t i = 1; i < sorted.size(); i++) {
+        if (sorted[i].filename() == sorted[i-1].filename()) {
+            std::cerr << "Error: " << sorted[i-1] << " and " << sorted[i] << " would both be written to "
+                      << settings.outputDirectory / sorted[i].filename() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int runBatch(int argc, char* argv[]) {
+    BatchSettings settings;
+    if (!parseArguments(argc, argv, settings)) { return 1; }
+    std::error_code error;
+    fs::create_directories(settings.outputDirectory, error);
+    if (error) { std::cerr << "Error: cannot create " << settings.outputDirectory << std::endl; return 1; }
+
+    std::mutex printMutex;
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<uint64_t> totalPixels{0};
+    std::atomic<size_t> failures{0};
+    auto batchStart = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(settings.threadCount);
+        std::cout << "Processing " << settings.inputs.size() << " files on " << pool.threadCount() << " threads" << std::endl;
+        for (const fs::path& input : settings.inputs) {
+            pool.submit([&, input] {
+                auto start = std::chrono::steady_clock::now();
+                // The pool already keeps every core busy, so each file
+                // is read, processed, and written on a single thread.
+                PPM image(input.string(), 1);
+                double readTime = secondsSince(start);
+                if (image.getWidth() <= 0 || image.getHeight() <= 0) { failures++; return; }
+                std::error_code sizeError;
+                uint64_t bytes = fs::file_size(input, sizeError);
+                uint64_t pixels = static_cast<uint64_t>(image.getWidth()) * image.getHeight();
+
+                auto processStart = std::chrono::steady_clock::now();
+                for (const BatchOperation& operation : settings.operations) {
+                    switch (operation.type) {
+                        case BatchOperation::Darken: image.apply(PixelPipeline().scale(0.5f), 1); break;
+                        case BatchOperation::Lighten: image.apply(PixelPipeline().scale(2.0f), 1); break;
+                        case BatchOperation::Resize: image.resize(operation.width, operation.height); break;
+                        case BatchOperation::Convolve: image.convolve(operation.kernel); break;
+                    }
+                }
+                double processTime = secondsSince(processStart);
+
+                auto writeStart = std::chrono::steady_clock::now();
+                bool binary = settings.binary < 0 ? image.isBinary() : settings.binary == 1;
+                if (!image.savePPM((settings.outputDirectory / input.filename()).string(), binary, 1)) { failures++; return; }
+                double writeTime = secondsSince(writeStart);
+                double total = secondsSince(start);
+
+                totalBytes += bytes;
+                totalPixels += pixels;
+                std::lock_guard<std::mutex> lock(printMutex);
+                std::cout << std::fixed << std::setprecision(1)
+                          << input.filename().string() << ": " << bytes / 1048576.0 << " MB, "
+                          << "read " << readTime * 1000 << " ms, process " << processTime * 1000 << " ms, write " << writeTime * 1000 << " ms, "
+                          << bytes / 1048576.0 / total << " MB/s, " << pixels / 1e6 / total << " Mpixels/s" << std::endl;
+            });
+        }
+        pool.wait();
+        double wall = secondsSince(batchStart);
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Total: " << settings.inputs.size() - failures << " files, " << totalBytes / 1048576.0 << " MB in " << wall * 1000 << " ms, "
+                  << totalBytes / 1048576.0 / wall << " MB/s, " << totalPixels / 1e6 / wall << " Mpixels/s, "
+                  << pool.stolenCount() << " tasks stolen" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+#include "ImageCompare.hpp"
+#include "PPMFormat.hpp"
+#include "RowBands.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// Running totals of the simple measures for part of an image
+struct DifferenceTotals{
+    int maxDifference{0};
+    uint64_t sumDifference{0};
+    uint64_t sumSquaredDifference{0};
+};
+
+// Adds the differences of count values to totals
+static void AddDifferences(const uint8_t* a, const uint8_t* b, size_t count, DifferenceTotals& totals){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i maxDifference = zero;
+    __m128i sumDifference = zero;
+    size_t vectorEnd = count & ~(size_t)15;
+    while(i < vectorEnd){
+        // Each 32 bit lane of squares grows by at most 4*255^2 per step,
+        // so it is emptied into the 64 bit total every 8192 steps.
+        size_t chunkEnd = std::min(vectorEnd, i + 16*8192);
+        __m128i sumSquares = zero;
+        for(; i < chunkEnd; i += 16){
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a+i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b+i));
+            __m128i difference = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            maxDifference = _mm_max_epu8(maxDifference, difference);
+            sumDifference = _mm_add_epi64(sumDifference, _mm_sad_epu8(va, vb));
+            __m128i low = _mm_unpacklo_epi8(difference, zero);
+            __m128i high = _mm_unpackhi_epi8(difference, zero);
+            sumSquares = _mm_add_epi32(sumSquares, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+        }
+        uint32_t squares[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(squares), sumSquares);
+        totals.sumSquaredDifference += (uint64_t)squares[0] + squares[1] + squares[2] + squares[3];
+    }
+    uint8_t maxBytes[16];
+    uint64_t sums[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxBytes), maxDifference);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), sumDifference);
+    totals.maxDifference = std::max<int>(totals.maxDifference, *std::max_element(maxBytes, maxBytes+16));
+    totals.sumDifference += sums[0] + sums[1];
+#endif
+    for(; i < count; ++i){
+        int difference = std::abs((int)a[i] - (int)b[i]);
+        totals.maxDifference = std::max(totals.maxDifference, difference);
+        totals.sumDifference += difference;
+        totals.sumSquaredDifference += difference*difference;
+    }
+}
+
+// Luminance of count RGB pixels, weighted 0.30 R + 0.59 G + 0.11 B
+static void ComputeLuminance(const uint8_t* rgb, size_t count, uint8_t* out){
+    for(size_t i=0; i < count; ++i){
+        out[i] = (uint8_t)((77*rgb[i*3] + 150*rgb[i*3+1] + 29*rgb[i*3+2] + 128) >> 8);
+    }
+}
+
+// Sums over the 4x4 blocks of one row of blocks
+struct BlockSums{
+    std::vector<int32_t> sumA;      // Sum of a
+    std::vector<int32_t> sumB;      // Sum of b
+    std::vector<int32_t> sumSquares;// Sum of a*a + b*b
+    std::vector<int32_t> sumAB;     // Sum of a*b
+    void Resize(int blocks){
+        sumA.resize(blocks);
+        sumB.resize(blocks);
+        sumSquares.resize(blocks);
+        sumAB.resize(blocks);
+    }
+};
+
+#if defined(__SSE2__)
+// Adds neighboring 32 bit lanes: [l0+l1, l2+l3, h0+h1, h2+h3]
+static inline __m128i AddPairs(__m128i low, __m128i high){
+    __m128 l = _mm_castsi128_ps(low);
+    __m128 h = _mm_castsi128_ps(high);
+    __m128i even = _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(2,0,2,0)));
+    __m128i odd = _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(3,1,3,1)));
+    return _mm_add_epi32(even, odd);
+}
+#endif
+
+// Fills sums for the blocks of four rows of luminance (a and b are
+// the first of the rows, which are width bytes apart)
+static void ComputeBlockSums(const uint8_t* a, const uint8_t* b, int width, BlockSums& sums){
+    int blocks = width / 4;
+    int block = 0;
+#if defined(__SSE2__)
+    // Four blocks (16 pixels) at a time
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    for(; block + 4 <= blocks; block += 4){
+        __m128i sumALow = zero, sumAHigh = zero, sumBLow = zero, sumBHigh = zero;
+        __m128i squaresLow = zero, squaresHigh = zero, productLow = zero, productHigh = zero;
+        for(int row=0; row < 4; ++row){
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + row*width + block*4));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + row*width + block*4));
+            __m128i aLow = _mm_unpacklo_epi8(va, zero);
+            __m128i aHigh = _mm_unpackhi_epi8(va, zero);
+            __m128i bLow = _mm_unpacklo_epi8(vb, zero);
+            __m128i bHigh = _mm_unpackhi_epi8(vb, zero);
+            sumALow = _mm_add_epi16(sumALow, aLow);
+            sumAHigh = _mm_add_epi16(sumAHigh, aHigh);
+            sumBLow = _mm_add_epi16(sumBLow, bLow);
+            sumBHigh = _mm_add_epi16(sumBHigh, bHigh);
+            squaresLow = _mm_add_epi32(squaresLow, _mm_add_epi32(_mm_madd_epi16(aLow, aLow), _mm_madd_epi16(bLow, bLow)));
+            squaresHigh = _mm_add_epi32(squaresHigh, _mm_add_epi32(_mm_madd_epi16(aHigh, aHigh), _mm_madd_epi16(bHigh, bHigh)));
+            productLow = _mm_add_epi32(productLow, _mm_madd_epi16(aLow, bLow));
+            productHigh = _mm_add_epi32(productHigh, _mm_madd_epi16(aHigh, bHigh));
+        }
+        // Every lane now holds two neighboring columns, so adding pairs
+        // of lanes gives the four columns of each block
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&sums.sumA[block]),
+                         AddPairs(_mm_madd_epi16(sumALow, ones), _mm_madd_epi16(sumAHigh, ones)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&sums.sumB[block]),
+                         AddPairs(_mm_madd_epi16(sumBLow, ones), _mm_madd_epi16(sumBHigh, ones)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&sums.sumSquares[block]), AddPairs(squaresLow, squaresHigh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&sums.sumAB[block]), AddPairs(productLow, productHigh));
+    }
+#endif
+    for(; block < blocks; ++block){
+        int32_t sumA = 0, sumB = 0, sumSquares = 0, sumAB = 0;
+        for(int row=0; row < 4; ++row){
+            for(int x=block*4; x < block*4+4; ++x){
+                int va = a[row*width + x];
+                int vb = b[row*width + x];
+                sumA += va;
+                sumB += vb;
+                sumSquares += va*va + vb*vb;
+                sumAB += va*vb;
+            }
+        }
+        sums.sumA[block] = sumA;
+        sums.sumB[block] = sumB;
+        sums.sumSquares[block] = sumSquares;
+        sums.sumAB[block] = sumAB;
+    }
+}
+
+// SSIM of a window of count pixels, given the sums of its values
+static double SSIMFromSums(double sumA, double sumB, double sumSquares, double sumAB, double count){
+    const double c1 = (0.01*255)*(0.01*255);
+    const double c2 = (0.03*255)*(0.03*255);
+    double meanA = sumA / count;
+    double meanB = sumB / count;
+    // Sample variances and covariance, as in the paper
+    double varianceSum = 0;
+    double covariance = 0;
+    if(count > 1){
+        varianceSum = (sumSquares - (sumA*sumA + sumB*sumB)/count) / (count-1);
+        covariance = (sumAB - sumA*sumB/count) / (count-1);
+    }
+    return ((2*meanA*meanB + c1) * (2*covariance + c2))
+         / ((meanA*meanA + meanB*meanB + c1) * (varianceSum + c2));
+}
+
+// Mean SSIM of the 8x8 windows (placed every 4 pixels) of two images
+static double ComputeSSIM(const uint8_t* a, const uint8_t* b, int width, int height, unsigned int threadCount){
+    int blocksWide = width / 4;
+    int blocksHigh = height / 4;
+    // Too small for even one window, so treat the image as one window
+    if(blocksWide < 2 || blocksHigh < 2){
+        size_t count = (size_t)width*height;
+        std::vector<uint8_t> lumaA(count), lumaB(count);
+        ComputeLuminance(a, count, lumaA.data());
+        ComputeLuminance(b, count, lumaB.data());
+        double sumA = 0, sumB = 0, sumSquares = 0, sumAB = 0;
+        for(size_t i=0; i < count; ++i){
+            sumA += lumaA[i];
+            sumB += lumaB[i];
+            sumSquares += lumaA[i]*lumaA[i] + lumaB[i]*lumaB[i];
+            sumAB += lumaA[i]*lumaB[i];
+        }
+        return SSIMFromSums(sumA, sumB, sumSquares, sumAB, (double)count);
+    }
+    // Rows of windows are split across threads. A band of windows
+    // needs one more row of blocks than it has rows of windows.
+    int windowRows = blocksHigh - 1;
+    double total = 0;
+    std::mutex totalMutex;
+    ForEachRowBand(windowRows, (size_t)width*3*4, threadCount, [&](int begin, int end){
+        std::vector<uint8_t> lumaA((size_t)width*4), lumaB((size_t)width*4);
+        BlockSums above, below;
+        above.Resize(blocksWide);
+        below.Resize(blocksWide);
+        double bandTotal = 0;
+        for(int blockRow=begin; blockRow <= end; ++blockRow){
+            ComputeLuminance(a + (size_t)blockRow*4*width*3, (size_t)width*4, lumaA.data());
+            ComputeLuminance(b + (size_t)blockRow*4*width*3, (size_t)width*4, lumaB.data());
+            ComputeBlockSums(lumaA.data(), lumaB.data(), width, below);
+            if(blockRow > begin){
+                for(int x=0; x < blocksWide-1; ++x){
+                    bandTotal += SSIMFromSums(
+                        above.sumA[x] + above.sumA[x+1] + below.sumA[x] + below.sumA[x+1],
+                        above.sumB[x] + above.sumB[x+1] + below.sumB[x] + below.sumB[x+1],
+                        above.sumSquares[x] + above.sumSquares[x+1] + below.sumSquares[x] + below.sumSquares[x+1],
+                        above.sumAB[x] + above.sumAB[x+1] + below.sumAB[x] + below.sumAB[x+1],
+                        64.0);
+                }
+            }
+            std::swap(above, below);
+        }
+        std::lock_guard<std::mutex> lock(totalMutex);
+        total += bandTotal;
+    });
+    return total / ((double)windowRows*(blocksWide-1));
+}
+
+void CompareImages(const uint8_t* a, const uint8_t* b, int width, int height,
+                   ImageDifference& result, const CompareSettings& settings){
+    result = ImageDifference();
+    size_t rowBytes = (size_t)width*3;
+    size_t count = rowBytes*height;
+    if(a == nullptr || b == nullptr || count == 0){
+        result.psnr = std::numeric_limits<double>::infinity();
+        return;
+    }
+    DifferenceTotals totals;
+    std::mutex totalsMutex;
+    ForEachRowBand(height, rowBytes, settings.threadCount, [&](int begin, int end){
+        DifferenceTotals bandTotals;
+        AddDifferences(a + begin*rowBytes, b + begin*rowBytes, (end-begin)*rowBytes, bandTotals);
+        std::lock_guard<std::mutex> lock(totalsMutex);
+        totals.maxDifference = std::max(totals.maxDifference, bandTotals.maxDifference);
+        totals.sumDifference += bandTotals.sumDifference;
+        totals.sumSquaredDifference += bandTotals.sumSquaredDifference;
+    });
+    result.maxDifference = totals.maxDifference;
+    result.meanDifference = (double)totals.sumDifference / count;
+    result.meanSquaredError = (double)totals.sumSquaredDifference / count;
+    result.psnr = (totals.sumSquaredDifference == 0) ? std::numeric_limits<double>::infinity()
+                                                     : 10.0*std::log10(255.0*255.0 / result.meanSquaredError);
+    if(settings.computeSSIM){
+        // Equal images are exactly 1, no need to look any closer
+        result.ssim = (totals.maxDifference == 0) ? 1.0 : ComputeSSIM(a, b, width, height, settings.threadCount);
+    }
+}
+
+// Color of every heatmap level, from black through blue, red, and
+// yellow to white
+static uint8_t s_heatmapColors[256][3];
+static std::once_flag s_heatmapBuilt;
+
+static void BuildHeatmap(){
+    const float stops[5][3] = {{0,0,0}, {0,0,255}, {255,0,0}, {255,255,0}, {255,255,255}};
+    for(int i=0; i < 256; ++i){
+        float position = i/255.0f*4;
+        int stop = std::min(3, (int)position);
+        float t = position - stop;
+        for(int c=0; c < 3; ++c){
+            s_heatmapColors[i][c] = (uint8_t)(stops[stop][c] + (stops[stop+1][c]-stops[stop][c])*t + 0.5f);
+        }
+    }
+}
+
+void MakeDifferenceHeatmap(const uint8_t* a, const uint8_t* b, int width, int height,
+                           uint8_t* out, int scale, unsigned int threadCount){
+    std::call_once(s_heatmapBuilt, BuildHeatmap);
+    size_t rowBytes = (size_t)width*3;
+    if(scale <= 0){
+        ImageDifference difference;
+        CompareSettings settings;
+        settings.computeSSIM = false;
+        settings.threadCount = threadCount;
+        CompareImages(a, b, width, height, difference, settings);
+        scale = std::max(1, difference.maxDifference);
+    }
+    ForEachRowBand(height, rowBytes, threadCount, [&](int begin, int end){
+        for(size_t i=begin*(size_t)width; i < end*(size_t)width; ++i){
+            int difference = std::max({std::abs((int)a[i*3] - (int)b[i*3]),
+                                       std::abs((int)a[i*3+1] - (int)b[i*3+1]),
+                                       std::abs((int)a[i*3+2] - (int)b[i*3+2])});
+            int level = std::min(255, difference*255/scale);
+            out[i*3] = s_heatmapColors[level][0];
+            out[i*3+1] = s_heatmapColors[level][1];
+            out[i*3+2] = s_heatmapColors[level][2];
+        }
+    });
+}
+
+bool WriteDifferenceHeatmap(const std::string& filepath, const uint8_t* a, const uint8_t* b,
+                            int width, int height, int scale, unsigned int threadCount){
+    std::vector<uint8_t> heatmap((size_t)width*height*3);
+    MakeDifferenceHeatmap(a, b, width, height, heatmap.data(), scale, threadCount);
+    return WritePPM(filepath, heatmap.data(), width, height, 255, true, threadCount);
+}
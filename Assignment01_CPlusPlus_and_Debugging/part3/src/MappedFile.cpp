@@ -0,0 +1,110 @@
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#if defined(LINUX) || defined(MAC)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+// Constructor
+MappedFile::MappedFile(){
+}
+
+// Destructor
+MappedFile::~MappedFile(){
+    Close();
+}
+
+// Move constructor takes ownership of the other mapping
+MappedFile::MappedFile(MappedFile&& other){
+    *this = std::move(other);
+}
+
+// Move assignment takes ownership of the other mapping
+MappedFile& MappedFile::operator=(MappedFile&& other){
+    if(this != &other){
+        Close();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_mapped = other.m_mapped;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_mapped = false;
+    }
+    return *this;
+}
+
+// Maps an entire file into memory.
+// Returns false if the file could not be opened or is empty.
+bool MappedFile::Open(const std::string& filepath){
+    Close();
+#if defined(LINUX) || defined(MAC)
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size <= 0){
+        close(fd);
+        return false;
+    }
+    // MAP_PRIVATE gives us copy-on-write pages, so callers can
+    // modify pixels in place without touching the file on disk.
+    void* address = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if(address == MAP_FAILED){
+        std::cout << "Unable to map file: " << filepath << std::endl;
+        return false;
+    }
+    // We are about to read the whole file front to back.
+    madvise(address, info.st_size, MADV_SEQUENTIAL);
+    madvise(address, info.st_size, MADV_WILLNEED);
+    m_data = static_cast<uint8_t*>(address);
+    m_size = info.st_size;
+    m_mapped = true;
+#else
+    // No mmap available, so read everything into memory instead.
+    std::ifstream file(filepath.c_str(), std::ios::binary | std::ios::ate);
+    if(!file.is_open()){
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    if(size <= 0){
+        return false;
+    }
+    file.seekg(0, std::ios::beg);
+    m_data = new uint8_t[size];
+    if(!file.read(reinterpret_cast<char*>(m_data), size)){
+        delete[] m_data;
+        m_data = nullptr;
+        return false;
+    }
+    m_size = size;
+    m_mapped = false;
+#endif
+    return true;
+}
+
+// Unmaps or frees the data
+void MappedFile::Close(){
+    if(m_data != nullptr){
+#if defined(LINUX) || defined(MAC)
+        if(m_mapped){
+            munmap(m_data, m_size);
+        }else{
+            delete[] m_data;
+        }
+#else
+        delete[] m_data;
+#endif
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
@@ -0,0 +1,405 @@
+#include "PPMFormat.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// True for the characters the PPM format treats as whitespace
+static inline bool IsHeaderWhitespace(uint8_t c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Moves pos past any whitespace and '#' comments.
+static void SkipWhitespaceAndComments(const uint8_t* data, size_t size, size_t& pos){
+    while(pos < size){
+        uint8_t c = data[pos];
+        if(c == '#'){
+            // A comment runs until the end of the line
+            while(pos < size && data[pos] != '\n' && data[pos] != '\r'){
+                ++pos;
+            }
+        }else if(IsHeaderWhitespace(c)){
+            ++pos;
+        }else{
+            return;
+        }
+    }
+}
+
+// Reads a non-negative decimal integer starting at pos.
+// Returns -1 if there is no number at pos.
+static int ReadHeaderInteger(const uint8_t* data, size_t size, size_t& pos){
+    SkipWhitespaceAndComments(data, size, pos);
+    if(pos >= size || data[pos] < '0' || data[pos] > '9'){
+        return -1;
+    }
+    int value = 0;
+    while(pos < size && data[pos] >= '0' && data[pos] <= '9'){
+        value = value*10 + (data[pos]-'0');
+        // Guard against absurd values overflowing
+        if(value > (1<<24)){
+            return -1;
+        }
+        ++pos;
+    }
+    return value;
+}
+
+// Parses the magic number, dimensions, and maximum color value.
+bool ParsePPMHeaderFields(const uint8_t* data, size_t size, PPMHeader& header){
+    if(data == nullptr || size < 2 || data[0] != 'P' || (data[1] != '3' && data[1] != '6')){
+        std::cout << "PPM magic number not found, only P3 and P6 are supported" << std::endl;
+        return false;
+    }
+    header.binary = (data[1] == '6');
+
+    size_t pos = 2;
+    header.width    = ReadHeaderInteger(data, size, pos);
+    header.height   = ReadHeaderInteger(data, size, pos);
+    header.maxValue = ReadHeaderInteger(data, size, pos);
+    if(header.width <= 0 || header.height <= 0 || header.maxValue <= 0){
+        std::cout << "PPM not parsed correctly, width, height, or range is missing" << std::endl;
+        return false;
+    }
+
+    if(header.binary){
+        // Exactly one whitespace character separates the range from the
+        // binary pixel data. Without it the first pixel byte would be
+        // taken as the separator and every pixel after it shifted.
+        if(pos < size && !IsHeaderWhitespace(data[pos])){
+            std::cout << "P6 header must end with a single whitespace character" << std::endl;
+            return false;
+        }
+        header.dataOffset = pos + 1;
+    }else{
+        header.dataOffset = pos;
+    }
+    // Samples are stored in one byte each. The P3 tokenizer would clamp
+    // larger values to 255 while the header still claimed the larger range.
+    if(header.maxValue > 255){
+        std::cout << "PPM with 16-bit color components is not supported" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Parses the header and makes sure a P6 file holds all of its pixels.
+bool ParsePPMHeader(const uint8_t* data, size_t size, PPMHeader& header){
+    if(!ParsePPMHeaderFields(data, size, header)){
+        return false;
+    }
+    if(header.binary){
+        size_t expected = (size_t)header.width*header.height*3;
+        if(header.dataOffset > size || size - header.dataOffset < expected){
+            std::cout << "P6 file is shorter than its dimensions say" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(__SSE2__)
+// Returns a 16 bit mask with bit i set if p[i] is a digit '0'-'9'.
+// Bytes above 127 compare as negative, so they are never digits.
+static inline unsigned int DigitMask16(const uint8_t* p){
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i atLeastZero = _mm_cmpgt_epi8(bytes, _mm_set1_epi8('0'-1));
+    __m128i atMostNine  = _mm_cmplt_epi8(bytes, _mm_set1_epi8('9'+1));
+    return _mm_movemask_epi8(_mm_and_si128(atLeastZero, atMostNine));
+}
+
+// Returns a 16 bit mask with bit i set if p[i] starts a comment.
+static inline unsigned int CommentMask16(const uint8_t* p){
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('#')));
+}
+#endif
+
+// Converts a run of 'length' digits into a byte, clamping at 255.
+// The common 1-3 digit cases are done without a loop.
+static inline uint8_t DigitsToByte(const uint8_t* p, unsigned int length){
+    switch(length){
+        case 1: return p[0]-'0';
+        case 2: return (p[0]-'0')*10 + (p[1]-'0');
+        case 3: {
+            unsigned int value = (p[0]-'0')*100 + (p[1]-'0')*10 + (p[2]-'0');
+            return value > 255 ? 255 : value;
+        }
+        default: {
+            unsigned int value = 0;
+            for(unsigned int i=0; i < length; ++i){
+                value = value*10 + (p[i]-'0');
+                if(value > 255){
+                    return 255;
+                }
+            }
+            return value;
+        }
+    }
+}
+
+// Single pass tokenizer for P3 pixel values.
+// With SSE2 we classify 16 bytes at a time, so runs of whitespace are
+// skipped a block at a time and the length of a number is found with
+// one bit scan. Anything that straddles the end of a block (or the
+// tail of the buffer) goes through the scalar path below.
+size_t ParseASCIIValues(const uint8_t* begin, const uint8_t* end, uint8_t* out, size_t count){
+    const uint8_t* p = begin;
+    size_t written = 0;
+    while(written < count && p < end){
+#if defined(__SSE2__)
+        if(end - p >= 16){
+            unsigned int digits = DigitMask16(p);
+            unsigned int comments = CommentMask16(p);
+            if(digits == 0 && comments == 0){
+                // Nothing but separators in this block
+                p += 16;
+                continue;
+            }
+            unsigned int skip = digits ? __builtin_ctz(digits) : 16;
+            if(comments & ((1u << skip)-1)){
+                // A comment starts before the next number, let the
+                // scalar path deal with it.
+                p += __builtin_ctz(comments);
+            }else{
+                p += skip;
+                // Number of consecutive digits starting at p.
+                // Bits beyond the block are zero, so the run stops there.
+                unsigned int run = __builtin_ctz(~(digits >> skip));
+                if(skip + run < 16){
+                    out[written++] = DigitsToByte(p, run);
+                    p += run;
+                    continue;
+                }
+                // The number may continue past this block, fall through.
+            }
+        }
+#endif
+        uint8_t c = *p;
+        if(c == '#'){
+            while(p < end && *p != '\n' && *p != '\r'){
+                ++p;
+            }
+        }else if(c >= '0' && c <= '9'){
+            const uint8_t* start = p;
+            while(p < end && *p >= '0' && *p <= '9'){
+                ++p;
+            }
+            out[written++] = DigitsToByte(start, p - start);
+        }else{
+            // Spaces, tabs, newlines, and any stray characters separate values
+            ++p;
+        }
+    }
+    return written;
+}
+
+// Counts the values in [begin,end) without decoding them.
+// A value starts wherever a digit follows a non-digit.
+static size_t CountASCIIValues(const uint8_t* begin, const uint8_t* end){
+    const uint8_t* p = begin;
+    size_t count = 0;
+    // True if the byte before p was a digit
+    bool inNumber = false;
+    while(p < end){
+#if defined(__SSE2__)
+        if(end - p >= 16){
+            unsigned int digits = DigitMask16(p);
+            if(CommentMask16(p) == 0){
+                // A digit is the start of a value if the byte before it is not a digit
+                unsigned int previous = (digits << 1) | (inNumber ? 1u : 0u);
+                count += __builtin_popcount(digits & ~previous & 0xFFFFu);
+                inNumber = (digits >> 15) & 1u;
+                p += 16;
+                continue;
+            }
+        }
+#endif
+        uint8_t c = *p;
+        if(c == '#'){
+            while(p < end && *p != '\n' && *p != '\r'){
+                ++p;
+            }
+            inNumber = false;
+            continue;
+        }
+        bool isDigit = (c >= '0' && c <= '9');
+        if(isDigit && !inNumber){
+            ++count;
+        }
+        inNumber = isDigit;
+        ++p;
+    }
+    return count;
+}
+
+// Splits the payload into line-aligned chunks that are decoded on
+// separate threads. Starting every chunk right after a '\n' means no
+// chunk can begin in the middle of a number or a comment.
+size_t ParseASCIIValuesParallel(const uint8_t* begin, const uint8_t* end, uint8_t* out, size_t count, unsigned int threadCount){
+    // Below this many bytes per chunk, starting threads costs more than it saves.
+    const size_t minimumChunkBytes = 256*1024;
+    if(threadCount == 0){
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t bytes = end - begin;
+    size_t chunkCount = std::min<size_t>(threadCount, bytes / minimumChunkBytes);
+    if(chunkCount <= 1){
+        return ParseASCIIValues(begin, end, out, count);
+    }
+
+    // Chunk i covers [boundaries[i], boundaries[i+1])
+    std::vector<const uint8_t*> boundaries;
+    boundaries.push_back(begin);
+    for(size_t i=1; i < chunkCount; ++i){
+        const uint8_t* split = std::max(begin + (bytes*i)/chunkCount, boundaries.back());
+        while(split < end && *split != '\n'){
+            ++split;
+        }
+        if(split < end){
+            boundaries.push_back(split+1);
+        }
+    }
+    boundaries.push_back(end);
+    chunkCount = boundaries.size()-1;
+
+    // Pass 1: count the values in every chunk
+    std::vector<size_t> offsets(chunkCount+1, 0);
+    std::vector<std::thread> workers;
+    for(size_t i=1; i < chunkCount; ++i){
+        workers.emplace_back([&,i](){
+            offsets[i+1] = CountASCIIValues(boundaries[i], boundaries[i+1]);
+        });
+    }
+    offsets[1] = CountASCIIValues(boundaries[0], boundaries[1]);
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+    workers.clear();
+
+    // Prefix sum turns the counts into the offset each chunk writes at
+    for(size_t i=1; i <= chunkCount; ++i){
+        offsets[i] += offsets[i-1];
+    }
+
+    // Pass 2: decode every chunk into its own slice of the output
+    auto decode = [&](size_t i){
+        if(offsets[i] >= count){
+            return;
+        }
+        size_t limit = std::min(offsets[i+1], count) - offsets[i];
+        ParseASCIIValues(boundaries[i], boundaries[i+1], out + offsets[i], limit);
+    };
+    for(size_t i=1; i < chunkCount; ++i){
+        workers.emplace_back(decode, i);
+    }
+    decode(0);
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+    return std::min(offsets[chunkCount], count);
+}
+
+// Builds the text of a header
+std::string MakePPMHeader(bool binary, int width, int height, int maxValue){
+    std::string header = binary ? "P6\n" : "P3\n";
+    header += std::to_string(width) + " " + std::to_string(height) + "\n";
+    header += std::to_string(maxValue) + "\n";
+    return header;
+}
+
+size_t GetMaxASCIISize(size_t count, size_t valuesPerLine){
+    // "255 " is the longest a value can be
+    return count*4 + (valuesPerLine ? count/valuesPerLine : 0) + 1;
+}
+
+size_t FormatASCIIValues(const uint8_t* values, size_t count, size_t valuesPerLine, char* out){
+    char* p = out;
+    size_t column = 0;
+    for(size_t i=0; i < count; ++i){
+        // Three characters always fit, so the result is never an error
+        p = std::to_chars(p, p+3, values[i]).ptr;
+        *p++ = ' ';
+        if(++column == valuesPerLine){
+            *p++ = '\n';
+            column = 0;
+        }
+    }
+    return p - out;
+}
+
+// Flushes outFile and prints why if anything failed to reach the disk
+static bool CheckWritten(std::ofstream& outFile, const std::string& filepath){
+    outFile.flush();
+    if(!outFile.good()){
+        std::cout << "Unable to write file: " << filepath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WritePPM(const std::string& filepath, const uint8_t* pixels, int width, int height,
+              int maxValue, bool binary, unsigned int threadCount){
+    std::ofstream outFile(filepath.c_str(), std::ios::binary);
+    if(!outFile.is_open()){
+        std::cout << "Unable to open file for writing: " << filepath << std::endl;
+        return false;
+    }
+    std::string header = MakePPMHeader(binary, width, height, maxValue);
+    size_t rowValues = (size_t)width*3;
+    if(binary){
+        outFile.write(header.data(), header.size());
+        outFile.write(reinterpret_cast<const char*>(pixels), rowValues*height);
+        return CheckWritten(outFile, filepath);
+    }
+
+    // Below this many rows per band, starting threads costs more than it saves.
+    const int minimumBandRows = 64;
+    if(threadCount == 0){
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int bands = std::max(1, std::min<int>(threadCount, height / minimumBandRows));
+    size_t maxRowBytes = GetMaxASCIISize(rowValues, rowValues);
+
+    // Every band formats into its own worst case sized region. The header
+    // goes in front so the whole file is one buffer.
+    std::vector<char> text(header.size() + maxRowBytes*height);
+    memcpy(text.data(), header.data(), header.size());
+    std::vector<size_t> bandBytes(bands, 0);
+    auto bandStart = [&](int band){
+        return (int)((int64_t)height*band/bands);
+    };
+    auto format = [&](int band){
+        int firstRow = bandStart(band);
+        int rows = bandStart(band+1) - firstRow;
+        char* out = text.data() + header.size() + maxRowBytes*firstRow;
+        bandBytes[band] = FormatASCIIValues(pixels + rowValues*firstRow, rowValues*rows, rowValues, out);
+    };
+    std::vector<std::thread> workers;
+    for(int band=1; band < bands; ++band){
+        workers.emplace_back(format, band);
+    }
+    format(0);
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+
+    // Close the gaps left between bands. Each band only ever moves
+    // towards the front, so memmove in order is safe.
+    size_t size = header.size() + bandBytes[0];
+    for(int band=1; band < bands; ++band){
+        const char* source = text.data() + header.size() + maxRowBytes*bandStart(band);
+        memmove(text.data() + size, source, bandBytes[band]);
+        size += bandBytes[band];
+    }
+    outFile.write(text.data(), size);
+    return CheckWritten(outFile, filepath);
+}
@@ -0,0 +1,181 @@
+#include "PPMStream.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+PPMReader::PPMReader(size_t textBufferSize) : m_text(std::max<size_t>(textBufferSize, 1)) {
+}
+
+bool PPMReader::open(std::string fileName) {
+    m_file.open(fileName, std::ios::binary);
+    if (!m_file) { std::cerr << "Error: File " << fileName << " cannot be opened" << std::endl; return false; }
+
+    // Headers are tiny, so the first block of the file always holds it
+    uint8_t headerText[4096];
+    m_file.read(reinterpret_cast<char*>(headerText), sizeof(headerText));
+    size_t headerSize = m_file.gcount();
+    if (!ParsePPMHeaderFields(headerText, headerSize, m_header) || m_header.dataOffset > headerSize) {
+        std::cerr << "Error: file " << fileName << " not supported" << std::endl;
+        return false;
+    }
+    // The payload is read from the start again into the text buffer
+    m_file.clear();
+    m_file.seekg(m_header.dataOffset);
+    m_rowsRead = 0;
+    m_textSize = 0;
+    m_endOfFile = false;
+    m_inComment = false;
+    // Every value takes at least 2 bytes of text (a digit and a separator)
+    m_values.resize(m_text.size()/2 + 1);
+    m_valuesBegin = 0;
+    m_valuesEnd = 0;
+    return true;
+}
+
+static inline bool IsSeparator(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Only text up to the last separator is decoded, so no number is ever
+// cut in half; the rest is kept for the next call. A comment that runs
+// past the end of the text is dropped, and m_inComment skips the rest of
+// it on the next call.
+bool PPMReader::fillValues() {
+    // Move values that have not been handed out to the front
+    memmove(m_values.data(), m_values.data() + m_valuesBegin, m_valuesEnd - m_valuesBegin);
+    m_valuesEnd -= m_valuesBegin;
+    m_valuesBegin = 0;
+
+    if (!m_endOfFile && m_textSize < m_text.size()) {
+        m_file.read(reinterpret_cast<char*>(m_text.data() + m_textSize), m_text.size() - m_textSize);
+        m_textSize += m_file.gcount();
+        m_endOfFile = !m_file;
+    }
+    if (m_textSize == 0) { return false; }
+
+    // Finish a comment started by an earlier call
+    size_t start = 0;
+    if (m_inComment) {
+        while (start < m_textSize && m_text[start] != '\n' && m_text[start] != '\r') { ++start; }
+        m_inComment = (start == m_textSize);
+    }
+
+    size_t cut = m_textSize;
+    bool commentAtEnd = false;
+    if (!m_endOfFile) {
+        cut = start;
+        for (size_t i = m_textSize; i > start; --i) {
+            if (IsSeparator(m_text[i-1])) { cut = i; break; }
+        }
+        // A '#' after the last line break starts a comment that is not finished yet
+        size_t lineStart = start;
+        for (size_t i = m_textSize; i > start; --i) {
+            if (m_text[i-1] == '\n' || m_text[i-1] == '\r') { lineStart = i; break; }
+        }
+        const void* hash = memchr(m_text.data() + lineStart, '#', m_textSize - lineStart);
+        if (hash != nullptr) {
+            cut = static_cast<const uint8_t*>(hash) - m_text.data();
+            commentAtEnd = true;
+        }
+    }
+    size_t room = m_values.size() - m_valuesEnd;
+    m_valuesEnd += ParseASCIIValues(m_text.data() + start, m_text.data() + cut, m_values.data() + m_valuesEnd, room);
+
+    if (commentAtEnd) {
+        m_textSize = 0;
+        m_inComment = true;
+        return true;
+    }
+    m_textSize -= cut;
+    memmove(m_text.data(), m_text.data() + cut, m_textSize);
+    if (m_textSize == m_text.size()) {
+        // One number fills the whole buffer, so make room for the rest of it
+        m_text.resize(m_text.size() * 2);
+        m_values.resize(m_text.size()/2 + 1);
+    }
+    return true;
+}
+
+int PPMReader::readRows(uint8_t* out, int maxRows) {
+    int rows = std::min(maxRows, m_header.height - m_rowsRead);
+    if (rows <= 0) { return 0; }
+    size_t rowValues = static_cast<size_t>(m_header.width) * 3;
+    size_t wanted = rowValues * rows;
+
+    if (m_header.binary) {
+        // Start with what was read along with the header
+        size_t fromText = std::min(wanted, m_textSize);
+        memcpy(out, m_text.data(), fromText);
+        m_textSize -= fromText;
+        memmove(m_text.data(), m_text.data() + fromText, m_textSize);
+        m_file.read(reinterpret_cast<char*>(out + fromText), wanted - fromText);
+        size_t got = fromText + m_file.gcount();
+        if (got < wanted) { memset(out + got, 0, wanted - got); std::cerr << "Warning: file ended early" << std::endl; }
+    } else {
+        size_t got = 0;
+        while (got < wanted) {
+            if (m_valuesBegin == m_valuesEnd && !fillValues()) { break; }
+            size_t take = std::min(wanted - got, m_valuesEnd - m_valuesBegin);
+            memcpy(out + got, m_values.data() + m_valuesBegin, take);
+            m_valuesBegin += take;
+            got += take;
+            // No text left and nothing decoded means the file is short
+            if (take == 0 && m_endOfFile && m_textSize == 0) { break; }
+        }
+        if (got < wanted) { memset(out + got, 0, wanted - got); std::cerr << "Warning: file ended early" << std::endl; }
+    }
+    m_rowsRead += rows;
+    return rows;
+}
+
+bool PPMWriter::open(std::string fileName, int width, int height, int maxColorValue, bool binary) {
+    m_file.open(fileName, std::ios::binary);
+    if (!m_file) { std::cerr << "Error: Unable to open file " << fileName << std::endl; return false; }
+    m_width = width;
+    m_height = height;
+    m_binary = binary;
+    m_rowsWritten = 0;
+    std::string header = MakePPMHeader(binary, width, height, maxColorValue);
+    m_file.write(header.data(), header.size());
+    return m_file.good();
+}
+
+bool PPMWriter::writeRows(const uint8_t* rows, int rowCount) {
+    size_t rowValues = static_cast<size_t>(m_width) * 3;
+    if (m_binary) {
+        m_file.write(reinterpret_cast<const char*>(rows), rowValues * rowCount);
+    } else {
+        m_text.resize(GetMaxASCIISize(rowValues * rowCount, rowValues));
+        size_t size = FormatASCIIValues(rows, rowValues * rowCount, rowValues, m_text.data());
+        m_file.write(m_text.data(), size);
+    }
+    m_rowsWritten += rowCount;
+    return m_file.good();
+}
+
+bool PPMWriter::close() {
+    bool complete = (m_rowsWritten == m_height) && m_file.good();
+    m_file.close();
+    if (m_rowsWritten != m_height) { std::cerr << "Warning: wrote " << m_rowsWritten << " of " << m_height << " rows" << std::endl; }
+    return complete;
+}
+
+// The budget is split between the reader's text buffer (and the values
+// decoded from it), one band of pixels, and the writer's text for that band.
+bool transformPPM(std::string inputFileName, std::string outputFileName, bool binary,
+                  size_t memoryBudget, const std::function<void(uint8_t*, size_t)>& operation) {
+    PPMReader reader(memoryBudget / 4);
+    if (!reader.open(inputFileName)) { return false; }
+    PPMWriter writer;
+    if (!writer.open(outputFileName, reader.getWidth(), reader.getHeight(), reader.getMaxColorValue(), binary)) { return false; }
+
+    size_t rowBytes = static_cast<size_t>(reader.getWidth()) * 3;
+    int bandRows = std::max<int>(1, (memoryBudget / 8) / rowBytes);
+    std::vector<uint8_t> band(rowBytes * bandRows);
+    int rows;
+    while ((rows = reader.readRows(band.data(), bandRows)) > 0) {
+        operation(band.data(), rowBytes * rows);
+        if (!writer.writeRows(band.data(), rows)) { return false; }
+    }
+    return writer.close();
+}
@@ -0,0 +1,286 @@
+#include "PixelPipeline.hpp"
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define PIXELPIPELINE_X86
+    #include <immintrin.h>
+#endif
+
+// ====================== Plain C++ versions =======================
+// These define exactly what each operation does. The SIMD versions
+// below give the same results, and also handle the leftover bytes at
+// the end of a tile.
+
+static void scaleScalar(uint8_t* v, size_t count, int factor) {
+    for (size_t i = 0; i < count; i++) { v[i] = static_cast<uint8_t>(std::min(255, (v[i] * factor) >> 8)); }
+}
+
+static void addScalar(uint8_t* v, size_t count, int amount) {
+    for (size_t i = 0; i < count; i++) { v[i] = static_cast<uint8_t>(std::min(255, std::max(0, v[i] + amount))); }
+}
+
+static void invertScalar(uint8_t* v, size_t count) {
+    for (size_t i = 0; i < count; i++) { v[i] = 255 - v[i]; }
+}
+
+// Weights are 0.30, 0.59 and 0.11 in 1/256ths, and add up to 256
+static void grayscaleScalar(uint8_t* v, size_t count) {
+    for (size_t i = 0; i + 2 < count; i += 3) {
+        uint8_t y = static_cast<uint8_t>((77 * v[i] + 150 * v[i+1] + 29 * v[i+2] + 128) >> 8);
+        v[i] = v[i+1] = v[i+2] = y;
+    }
+}
+
+static void thresholdScalar(uint8_t* v, size_t count, int level) {
+    for (size_t i = 0; i < count; i++) { v[i] = (v[i] >= level) ? 255 : 0; }
+}
+
+#if defined(PIXELPIPELINE_X86)
+// ========================= SSE2 versions ==========================
+// SSE2 is part of every x86-64 CPU, so these need no check.
+
+static void scaleSSE2(uint8_t* v, size_t count, int factor) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i f = _mm_set1_epi16(static_cast<short>(factor));
+    const __m128i max = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        // Unpacking with zero in the low byte gives v*256, so the high
+        // half of the product with f is (v*f)>>8.
+        __m128i lo = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, x), f);
+        __m128i hi = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, x), f);
+        // min(x,255) without SSE4.1
+        lo = _mm_sub_epi16(lo, _mm_subs_epu16(lo, max));
+        hi = _mm_sub_epi16(hi, _mm_subs_epu16(hi, max));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i), _mm_packus_epi16(lo, hi));
+    }
+    scaleScalar(v + i, count - i, factor);
+}
+
+static void addSSE2(uint8_t* v, size_t count, int amount) {
+    const __m128i a = _mm_set1_epi8(static_cast<char>(std::min(255, std::abs(amount))));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        x = (amount >= 0) ? _mm_adds_epu8(x, a) : _mm_subs_epu8(x, a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i), x);
+    }
+    addScalar(v + i, count - i, amount);
+}
+
+static void invertSSE2(uint8_t* v, size_t count) {
+    const __m128i ones = _mm_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i), _mm_xor_si128(x, ones));
+    }
+    invertScalar(v + i, count - i);
+}
+
+static void thresholdSSE2(uint8_t* v, size_t count, int level) {
+    const __m128i l = _mm_set1_epi8(static_cast<char>(level));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        // x >= level exactly when max(x,level) == x
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i), _mm_cmpeq_epi8(_mm_max_epu8(x, l), x));
+    }
+    thresholdScalar(v + i, count - i, level);
+}
+
+// ========================= SSSE3 version ==========================
+// Grayscale mixes the three channels of a pixel, so 16 pixels (48 bytes)
+// are split into separate R, G and B vectors with byte shuffles, and the
+// result is shuffled back into R,G,B order.
+
+// Shuffle masks. Byte i of vector k of a 48 byte block is byte 16k+i.
+struct GrayscaleMasks {
+    // gather[k][c] pulls channel c of each pixel out of vector k
+    __m128i gather[3][3];
+    // scatter[k] spreads the 16 gray values back over vector k
+    __m128i scatter[3];
+    GrayscaleMasks() {
+        for (int k = 0; k < 3; k++) {
+            alignas(16) int8_t bytes[16];
+            for (int c = 0; c < 3; c++) {
+                for (int i = 0; i < 16; i++) {
+                    int source = 3 * i + c;
+                    bytes[i] = (source / 16 == k) ? static_cast<int8_t>(source % 16) : -1;
+                }
+                gather[k][c] = _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+            }
+            for (int i = 0; i < 16; i++) { bytes[i] = static_cast<int8_t>((16 * k + i) / 3); }
+            scatter[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+        }
+    }
+};
+
+__attribute__((target("ssse3")))
+static void grayscaleSSSE3(uint8_t* v, size_t count) {
+    static const GrayscaleMasks masks;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wr = _mm_set1_epi16(77), wg = _mm_set1_epi16(150), wb = _mm_set1_epi16(29);
+    const __m128i round = _mm_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 48 <= count; i += 48) {
+        __m128i a[3];
+        for (int k = 0; k < 3; k++) { a[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i + 16 * k)); }
+        __m128i channel[3];
+        for (int c = 0; c < 3; c++) {
+            channel[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a[0], masks.gather[0][c]),
+                                                   _mm_shuffle_epi8(a[1], masks.gather[1][c])),
+                                      _mm_shuffle_epi8(a[2], masks.gather[2][c]));
+        }
+        // The weighted sum is at most 255*256+128, which fits in 16 bits
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(channel[0], zero), wr),
+                                                 _mm_mullo_epi16(_mm_unpacklo_epi8(channel[1], zero), wg)),
+                                   _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(channel[2], zero), wb), round));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(channel[0], zero), wr),
+                                                 _mm_mullo_epi16(_mm_unpackhi_epi8(channel[1], zero), wg)),
+                                   _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(channel[2], zero), wb), round));
+        __m128i gray = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        for (int k = 0; k < 3; k++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i + 16 * k), _mm_shuffle_epi8(gray, masks.scatter[k]));
+        }
+    }
+    grayscaleScalar(v + i, count - i);
+}
+
+// ========================= AVX2 versions ==========================
+// Same as the SSE2 versions, 32 bytes at a time. Unpack and pack both
+// work within each 128 bit half, so the byte order comes out unchanged.
+
+__attribute__((target("avx2")))
+static void scaleAVX2(uint8_t* v, size_t count, int factor) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i f = _mm256_set1_epi16(static_cast<short>(factor));
+    const __m256i max = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        __m256i lo = _mm256_min_epu16(_mm256_mulhi_epu16(_mm256_unpacklo_epi8(zero, x), f), max);
+        __m256i hi = _mm256_min_epu16(_mm256_mulhi_epu16(_mm256_unpackhi_epi8(zero, x), f), max);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), _mm256_packus_epi16(lo, hi));
+    }
+    scaleSSE2(v + i, count - i, factor);
+}
+
+__attribute__((target("avx2")))
+static void addAVX2(uint8_t* v, size_t count, int amount) {
+    const __m256i a = _mm256_set1_epi8(static_cast<char>(std::min(255, std::abs(amount))));
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        x = (amount >= 0) ? _mm256_adds_epu8(x, a) : _mm256_subs_epu8(x, a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), x);
+    }
+    addSSE2(v + i, count - i, amount);
+}
+
+__attribute__((target("avx2")))
+static void invertAVX2(uint8_t* v, size_t count) {
+    const __m256i ones = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), _mm256_xor_si256(x, ones));
+    }
+    invertSSE2(v + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void thresholdAVX2(uint8_t* v, size_t count, int level) {
+    const __m256i l = _mm256_set1_epi8(static_cast<char>(level));
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), _mm256_cmpeq_epi8(_mm256_max_epu8(x, l), x));
+    }
+    thresholdSSE2(v + i, count - i, level);
+}
+
+// Checked once. __builtin_cpu_init is needed in case this runs during
+// static initialization, before the CPU has been identified.
+static bool hasCPUFeature(bool avx2) {
+    static const bool avx2Supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    static const bool ssse3Supported = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+    return avx2 ? avx2Supported : ssse3Supported;
+}
+#endif
+
+PixelPipeline& PixelPipeline::scale(float factor) {
+    int fixed = static_cast<int>(std::lround(factor * 256.0f));
+    m_ops.push_back({OpType::Scale, std::min(65535, std::max(0, fixed))});
+    return *this;
+}
+
+PixelPipeline& PixelPipeline::add(int amount) {
+    m_ops.push_back({OpType::Add, std::min(255, std::max(-255, amount))});
+    return *this;
+}
+
+PixelPipeline& PixelPipeline::invert() {
+    m_ops.push_back({OpType::Invert, 0});
+    return *this;
+}
+
+PixelPipeline& PixelPipeline::grayscale() {
+    m_ops.push_back({OpType::Grayscale, 0});
+    return *this;
+}
+
+PixelPipeline& PixelPipeline::threshold(uint8_t level) {
+    m_ops.push_back({OpType::Threshold, level});
+    return *this;
+}
+
+// Picks the widest version of each operation the CPU supports
+void PixelPipeline::runTile(uint8_t* v, size_t count) const {
+#if defined(PIXELPIPELINE_X86)
+    const bool hasAVX2 = hasCPUFeature(true);
+    const bool hasSSSE3 = hasCPUFeature(false);
+#endif
+    for (const Op& op : m_ops) {
+        switch (op.type) {
+#if defined(PIXELPIPELINE_X86)
+            case OpType::Scale:     hasAVX2 ? scaleAVX2(v, count, op.value) : scaleSSE2(v, count, op.value); break;
+            case OpType::Add:       hasAVX2 ? addAVX2(v, count, op.value) : addSSE2(v, count, op.value); break;
+            case OpType::Invert:    hasAVX2 ? invertAVX2(v, count) : invertSSE2(v, count); break;
+            case OpType::Grayscale: hasSSSE3 ? grayscaleSSSE3(v, count) : grayscaleScalar(v, count); break;
+            case OpType::Threshold: hasAVX2 ? thresholdAVX2(v, count, op.value) : thresholdSSE2(v, count, op.value); break;
+#else
+            case OpType::Scale:     scaleScalar(v, count, op.value); break;
+            case OpType::Add:       addScalar(v, count, op.value); break;
+            case OpType::Invert:    invertScalar(v, count); break;
+            case OpType::Grayscale: grayscaleScalar(v, count); break;
+            case OpType::Threshold: thresholdScalar(v, count, op.value); break;
+#endif
+        }
+    }
+}
+
+void PixelPipeline::run(uint8_t* pixels, size_t pixelCount, unsigned int threadCount) const {
+    if (m_ops.empty() || pixels == nullptr) { return; }
+    // 1024 pixels (3 KB) stay in the L1 cache while every operation runs
+    // over them. It is also a multiple of the 48 bytes grayscale works on.
+    const size_t tilePixels = 1024;
+    auto runBand = [this, pixels, tilePixels](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; p += tilePixels) {
+            runTile(pixels + p * 3, std::min(tilePixels, end - p) * 3);
+        }
+    };
+
+    // Below this many pixels per band, starting threads costs more than it saves.
+    const size_t minimumBandPixels = 256 * 1024;
+    if (threadCount == 0) { threadCount = std::max(1u, std::thread::hardware_concurrency()); }
+    size_t bands = std::min<size_t>(threadCount, pixelCount / minimumBandPixels);
+    if (bands <= 1) { runBand(0, pixelCount); return; }
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < bands; i++) { workers.emplace_back(runBand, pixelCount * i / bands, pixelCount * (i + 1) / bands); }
+    runBand(0, pixelCount / bands);
+    for (std::thread& worker : workers) { worker.join(); }
+}
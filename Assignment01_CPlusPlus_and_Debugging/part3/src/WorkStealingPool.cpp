@@ -0,0 +1,93 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+WorkStealingPool::WorkStealingPool(unsigned int threadCount) {
+    if (threadCount == 0) { threadCount = std::max(1u, std::thread::hardware_concurrency()); }
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread& worker : m_workers) { worker.join(); }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    unsigned int index = m_nextQueue++ % m_queues.size();
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_pending++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    // m_queued is raised under m_stateMutex so a worker that just found
+    // nothing to do can not miss the wake up.
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_queued++;
+    }
+    m_wakeCondition.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(m_stateMutex);
+    m_doneCondition.wait(lock, [this] { return m_pending == 0; });
+}
+
+bool WorkStealingPool::takeTask(unsigned int index, std::function<void()>& task) {
+    // Newest work from our own queue first, it is most likely still in cache
+    {
+        WorkQueue& own = *m_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // Then the oldest work from everyone else, starting with our neighbor
+    for (size_t offset = 1; offset < m_queues.size(); offset++) {
+        WorkQueue& victim = *m_queues[(index + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned int index) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_stateMutex);
+            m_wakeCondition.wait(lock, [this] { return m_stopping || m_queued > 0; });
+            if (m_queued == 0) { return; }
+        }
+        std::function<void()> task;
+        if (!takeTask(index, task)) { continue; }
+        m_queued--;
+        task();
+        {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            m_pending--;
+            if (m_pending != 0) { continue; }
+        }
+        m_doneCondition.notify_all();
+    }
+}
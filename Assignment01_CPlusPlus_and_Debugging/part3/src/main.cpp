@@ -1,5 +1,37 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cmath>
+
 // Include our custom library
 #include "PPM.hpp"
+#include "PPMStream.hpp"
+#include "PPMFormat.hpp"
+#include "PixelPipeline.hpp"
+#include "BatchProcessor.hpp"
+
+// Number of checks that failed, main returns 1 if there were any
+static int s_failures = 0;
+
+void check(bool passed, const std::string& name){
+    std::cout << (passed ? "PASS: " : "FAIL: ") << name << std::endl;
+    if (!passed) { s_failures++; }
+}
+
+// Streams a whole file through a PPMReader holding only textBufferSize
+// bytes of text at once and returns the values it read
+std::vector<uint8_t> streamAll(std::string fileName, size_t textBufferSize){
+    PPMReader reader(textBufferSize);
+    if (!reader.open(fileName)) { return {}; }
+    std::vector<uint8_t> values(static_cast<size_t>(reader.getWidth()) * reader.getHeight() * 3);
+    size_t rowValues = static_cast<size_t>(reader.getWidth()) * 3;
+    int rows = 0;
+    int read;
+    while ((read = reader.readRows(values.data() + rowValues * rows, 3)) > 0) { rows += read; }
+    return values;
+}
 
 void unitTest1(){
     // Darken Test
@@ -22,16 +54,120 @@ void unitTest3(){
     PPM myPPM3("./../../common/textures/big_buck_bunny_blender3d_with_weird_formatting.ppm");
     myPPM3.lighten();
     myPPM3.savePPM("./parse.ppm"); 
+    // Values are stored in a byte each, so a wider range is refused
+    // rather than clamped under a header that still claims it.
+    const char wide[] = "P3\n1 1\n65535\n65535 0 0\n";
+    PPMHeader header;
+    check(!ParsePPMHeader(reinterpret_cast<const uint8_t*>(wide), sizeof(wide) - 1, header), "P3 with a 16-bit range is rejected");
 }
 
+void unitTest4(){
+    // Streaming test
+    // The image is darkened a few rows at a time, never holding more
+    // than 64 KB of it in memory. The result should match darken.ppm.
+    transformPPM("./../../common/textures/big_buck_bunny_blender3d.ppm",
+                 "./darken_stream.ppm", false, 64*1024, PPM::darkenValues);
+}
+
+void unitTest5(){
+    // Pipeline test
+    // Several operations chained together and run in a single pass
+    PPM myPPM5("./../../common/textures/big_buck_bunny_blender3d.ppm");
+    myPPM5.apply(PixelPipeline().grayscale().add(-16).scale(1.25f).invert());
+    myPPM5.savePPM("./pipeline.ppm");
+}
+
+void unitTest6(){
+    // Comparison test
+    // The streamed result from unitTest4 should be identical to the one
+    // made in memory by unitTest1, and small changes should score closer
+    // to the original than the pipeline in unitTest5.
+    PPM darkened("./darken.ppm");
+    PPM streamed("./darken_stream.ppm");
+    ImageDifference difference;
+    bool compared = darkened.compare(streamed, difference);
+    check(compared && difference.maxDifference == 0 && std::isinf(difference.psnr) && difference.ssim == 1.0,
+          "darken and darken_stream are identical");
+
+    PPM original("./../../common/textures/big_buck_bunny_blender3d.ppm");
+    compared = original.compare(original, difference);
+    check(compared && std::isinf(difference.psnr) && difference.ssim == 1.0, "an image compared with itself has infinite PSNR and SSIM 1");
+
+    PPM slight("./../../common/textures/big_buck_bunny_blender3d.ppm");
+    slight.apply(PixelPipeline().add(4));
+    ImageDifference slightDifference;
+    compared = original.compare(slight, slightDifference);
+    check(compared && std::isfinite(slightDifference.psnr) && slightDifference.maxDifference <= 4 && slightDifference.ssim < 1.0,
+          "adding 4 gives a finite PSNR and SSIM below 1");
+    std::cout << "original vs original+4: PSNR " << slightDifference.psnr << " dB, SSIM " << slightDifference.ssim << std::endl;
+
+    PPM piped("./pipeline.ppm");
+    ImageDifference pipedDifference;
+    compared = original.compare(piped, pipedDifference);
+    check(compared && pipedDifference.psnr < slightDifference.psnr && pipedDifference.ssim < slightDifference.ssim,
+          "the pipeline output scores lower than adding 4");
+    std::cout << "original vs pipeline: PSNR " << pipedDifference.psnr << " dB, SSIM " << pipedDifference.ssim << std::endl;
+
+    PPM smaller("./../../common/textures/big_buck_bunny_blender3d.ppm");
+    smaller.resize(256, 256);
+    check(!original.compare(smaller, difference), "images of different sizes are not compared");
+    original.saveDifferenceHeatmap(piped, "./difference.ppm");
+}
+
+void unitTest7(){
+    // Streaming with a tiny buffer
+    // Numbers and comments are split across many reads, and the values
+    // should still match the ones read all at once.
+    {
+        std::ofstream file("./stream_split.ppm", std::ios::binary);
+        file << "P3\n2 2\n255\n"
+             << "# a comment 1 2 3 that is longer than the buffer\n"
+             << "255 128 7 # another comment 9 9 9\n"
+             << "00000000010 20 30\n"
+             << "40 50 60 200 100 255";
+    }
+    const uint8_t expected[12] = {255, 128, 7, 10, 20, 30, 40, 50, 60, 200, 100, 255};
+    std::vector<uint8_t> streamed = streamAll("./stream_split.ppm", 5);
+    check(streamed.size() == 12 && memcmp(streamed.data(), expected, 12) == 0, "5 byte buffer splits comments and numbers");
+
+    PPM weird("./../../common/textures/big_buck_bunny_blender3d_with_weird_formatting.ppm");
+    streamed = streamAll("./../../common/textures/big_buck_bunny_blender3d_with_weird_formatting.ppm", 7);
+    size_t size = static_cast<size_t>(weird.getWidth()) * weird.getHeight() * 3;
+    check(streamed.size() == size && memcmp(streamed.data(), weird.pixelData(), size) == 0, "7 byte buffer matches the PPM loaded at once");
+}
+
+void unitTest8(){
+    // Plain arrays of color values
+    // Counts that are not a multiple of 3 still change every value.
+    uint8_t values[5] = {9, 100, 200, 255, 131};
+    PPM::darkenValues(values, 5);
+    const uint8_t darkened[5] = {4, 50, 100, 127, 65};
+    check(memcmp(values, darkened, 5) == 0, "darkenValues changes all 5 values");
+    PPM::lightenValues(values, 5);
+    const uint8_t lightened[5] = {8, 100, 200, 254, 130};
+    check(memcmp(values, lightened, 5) == 0, "lightenValues changes all 5 values");
+    uint8_t bright[4] = {128, 200, 255, 129};
+    PPM::lightenValues(bright, 4);
+    const uint8_t saturated[4] = {255, 255, 255, 255};
+    check(memcmp(bright, saturated, 4) == 0, "lightenValues saturates at 255");
+}
 
 // Entry point into the program
 int main(int argc, char* argv[]){
 
+    // Any arguments run the batch processor instead of the tests,
+    // e.g. ./prog -p darken,p6 ./../../common/textures
+    if (argc > 1) { return runBatch(argc, argv); }
+
     // Run each unit test one after the other
     unitTest1();
     unitTest2();
     unitTest3();
+    unitTest4();
+    unitTest5();
+    unitTest6();
+    unitTest7();
+    unitTest8();
     
-    return 0;
+    return s_failures ? 1 : 0;
 }
@@ -1,41 +1,40 @@
 #include "PPM.hpp"
+#include "PPMFormat.hpp"
+#include "MappedFile.hpp"
+#include "PixelPipeline.hpp"
 #include <cstdint>
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <sstream>
 #include <algorithm>
 
-PPM::PPM(std::string fileName) {
-    std::ifstream inputFile(fileName);
-    if (!inputFile) { std::cerr << "Error: File " << fileName << " cannot be opened" << std::endl; return; }
+PPM::PPM(std::string fileName, unsigned int threadCount) {
+    // The whole file is memory mapped and parsed straight out of the mapping.
+    MappedFile mappedFile;
+    if (!mappedFile.Open(fileName)) { std::cerr << "Error: File " << fileName << " cannot be opened" << std::endl; return; }
+    PPMHeader header;
+    if (!ParsePPMHeader(mappedFile.GetData(), mappedFile.GetSize(), header)) { std::cerr << "Error: file " << fileName << " not supported" << std::endl; return; }
 
-    const int foundP3 = 1 << 0;
-    const int foundDimensions = 1 << 1;
-    const int foundRange = 1 << 2;
-    int status = 0;
+    m_width = header.width;
+    m_height = header.height;
+    m_maxColorValue = header.maxValue;
+    m_binary = header.binary;
+    const uint8_t* payload = mappedFile.GetData() + header.dataOffset;
+    const uint8_t* end = mappedFile.GetData() + mappedFile.GetSize();
+    size_t valueCount = static_cast<size_t>(m_width) * m_height * 3;
 
-    std::string line;
-    int pixelIndex = 0;
-    
-    while (std::getline(inputFile, line)) {
-        if (line[0] == '#') { continue; }
-        if (!(status & foundP3)) {
-            if (line != "P3") { std::cerr << "Error: P3 not found, file " << fileName << " not supported" << std::endl; return; }
-            status |= foundP3;
-            continue;
-        }
-        std::stringstream ss(line);
-        if (!(status & foundDimensions)) { ss >> m_width >> m_height; m_PixelData.resize(m_width * m_height * 3); status |= foundDimensions; continue; }
-        if (!(status & foundRange)) { ss >> m_maxColorValue; status |= foundRange; continue; }
-
-        int value;
-        while (ss >> value) {
-            if (pixelIndex < m_PixelData.size()) { m_PixelData[pixelIndex++] = static_cast<uint8_t>(value); }
-        }
+    // Binary files are a straight copy
+    if (header.binary) {
+        m_PixelData.assign(payload, payload + valueCount);
+        return;
     }
 
-    inputFile.close();
+    // ASCII files go through the tokenizer, which splits large
+    // payloads into chunks decoded on separate threads.
+    // Any values missing from a short file are left as 0.
+    m_PixelData.resize(valueCount);
+    size_t parsed = ParseASCIIValuesParallel(payload, end, m_PixelData.data(), valueCount, threadCount);
+    if (parsed < valueCount) { std::cerr << "Warning: file " << fileName << " has " << parsed << " of " << valueCount << " values" << std::endl; }
 }
 
 
@@ -46,20 +45,23 @@ PPM::~PPM() {
     
 }
 
-void PPM::savePPM(std::string outputFileName) const {
-    std::ofstream outputFile(outputFileName);
-    if (!outputFile) { std::cerr << "Error: Unable to open file " << outputFileName << std::endl; return; }
-
-    outputFile << "P3" << std::endl;
-    outputFile << m_width << " " << m_height << std::endl;
-    outputFile << m_maxColorValue << std::endl;
+// Rows are formatted into one large buffer (several bands of rows at
+// once on separate threads) and the whole file is written in one call.
+// WritePPM prints why the file could not be opened or written.
+bool PPM::savePPM(std::string outputFileName, bool binary, unsigned int threadCount) const {
+    return WritePPM(outputFileName, m_PixelData.data(), m_width, m_height, m_maxColorValue, binary, threadCount);
+}
 
-    for (int i = 0; i < m_PixelData.size(); ++i) {
-        outputFile << static_cast<int>(m_PixelData[i]) << " ";
-        if ((i + 1) % (m_width * 3) == 0) { outputFile << std::endl; }
-    }
+bool PPM::compare(const PPM& other, ImageDifference& result, const CompareSettings& settings) const {
+    if (m_width != other.m_width || m_height != other.m_height) { std::cerr << "Error: Cannot compare a " << m_width << "x" << m_height << " image with a " << other.m_width << "x" << other.m_height << " image" << std::endl; return false; }
+    CompareImages(m_PixelData.data(), other.m_PixelData.data(), m_width, m_height, result, settings);
+    return true;
+}
 
-    outputFile.close();
+void PPM::saveDifferenceHeatmap(const PPM& other, std::string outputFileName, int scale) const {
+    if (m_width != other.m_width || m_height != other.m_height) { std::cerr << "Error: Cannot compare a " << m_width << "x" << m_height << " image with a " << other.m_width << "x" << other.m_height << " image" << std::endl; return; }
+    // WriteDifferenceHeatmap prints why the file could not be written
+    WriteDifferenceHeatmap(outputFileName, m_PixelData.data(), other.m_PixelData.data(), m_width, m_height, scale);
 }
 
 // Darken halves (integer division by 2) each of the red, green
@@ -67,10 +69,15 @@ void PPM::savePPM(std::string outputFileName) const {
 // in the PPM. Note that no values may be less than
 // 0 in a ppm.
 void PPM::darken() {
-    for (size_t i = 0; i < m_PixelData.size(); i++) {
-        int value = static_cast<int>(m_PixelData[i]) / 2;
-        m_PixelData[i] = static_cast<uint8_t>(value);
-    }
+    darkenValues(m_PixelData.data(), m_PixelData.size());
+}
+
+void PPM::darkenValues(uint8_t* values, size_t count) {
+    // Scaling by 0.5 rounds down, the same as integer division by 2
+    static const PixelPipeline halve = PixelPipeline().scale(0.5f);
+    halve.run(values, count / 3);
+    // The pipeline works on whole pixels, so finish any values left over
+    for (size_t i = count - count % 3; i < count; i++) { values[i] /= 2; }
 }
 
 
@@ -79,10 +86,72 @@ void PPM::darken() {
 // in the PPM. Note that no values may be greater than
 // 255 in a ppm.
 void PPM::lighten() {
-    for (size_t i = 0; i < m_PixelData.size(); i++) {
-        int value = static_cast<int>(m_PixelData[i]) * 2;
-        m_PixelData[i] = static_cast<uint8_t>(std::min(value, 255));
+    lightenValues(m_PixelData.data(), m_PixelData.size());
+}
+
+void PPM::lightenValues(uint8_t* values, size_t count) {
+    // Scaling saturates at 255
+    static const PixelPipeline twice = PixelPipeline().scale(2.0f);
+    twice.run(values, count / 3);
+    // The pipeline works on whole pixels, so finish any values left over
+    for (size_t i = count - count % 3; i < count; i++) { values[i] = static_cast<uint8_t>(std::min(255, values[i] * 2)); }
+}
+
+// Runs every operation of the pipeline over the image in one pass
+void PPM::apply(const PixelPipeline& pipeline, unsigned int threadCount) {
+    pipeline.run(m_PixelData.data(), m_PixelData.size() / 3, threadCount);
+}
+
+// Each new pixel center is mapped back into the old image, and the four
+// old pixels around that point are blended by how close they are.
+void PPM::resize(int width, int height) {
+    if (width <= 0 || height <= 0 || m_width <= 0 || m_height <= 0) { return; }
+    std::vector<uint8_t> resized(static_cast<size_t>(width) * height * 3);
+    float scaleX = static_cast<float>(m_width) / width;
+    float scaleY = static_cast<float>(m_height) / height;
+    for (int y = 0; y < height; y++) {
+        float sourceY = std::max(0.0f, (y + 0.5f) * scaleY - 0.5f);
+        int y0 = std::min(static_cast<int>(sourceY), m_height - 1);
+        int y1 = std::min(y0 + 1, m_height - 1);
+        float fy = sourceY - y0;
+        for (int x = 0; x < width; x++) {
+            float sourceX = std::max(0.0f, (x + 0.5f) * scaleX - 0.5f);
+            int x0 = std::min(static_cast<int>(sourceX), m_width - 1);
+            int x1 = std::min(x0 + 1, m_width - 1);
+            float fx = sourceX - x0;
+            for (int c = 0; c < 3; c++) {
+                float top = m_PixelData[(static_cast<size_t>(y0) * m_width + x0) * 3 + c] * (1 - fx) + m_PixelData[(static_cast<size_t>(y0) * m_width + x1) * 3 + c] * fx;
+                float bottom = m_PixelData[(static_cast<size_t>(y1) * m_width + x0) * 3 + c] * (1 - fx) + m_PixelData[(static_cast<size_t>(y1) * m_width + x1) * 3 + c] * fx;
+                resized[(static_cast<size_t>(y) * width + x) * 3 + c] = static_cast<uint8_t>(top * (1 - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+    m_PixelData.swap(resized);
+    m_width = width;
+    m_height = height;
+}
+
+void PPM::convolve(const float kernel[9]) {
+    if (m_width <= 0 || m_height <= 0) { return; }
+    std::vector<uint8_t> result(m_PixelData.size());
+    float maxValue = static_cast<float>(m_maxColorValue);
+    for (int y = 0; y < m_height; y++) {
+        for (int x = 0; x < m_width; x++) {
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            for (int ky = 0; ky < 3; ky++) {
+                int sourceY = std::min(std::max(y + ky - 1, 0), m_height - 1);
+                for (int kx = 0; kx < 3; kx++) {
+                    int sourceX = std::min(std::max(x + kx - 1, 0), m_width - 1);
+                    const uint8_t* pixel = &m_PixelData[(static_cast<size_t>(sourceY) * m_width + sourceX) * 3];
+                    for (int c = 0; c < 3; c++) { sum[c] += kernel[ky * 3 + kx] * pixel[c]; }
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                result[(static_cast<size_t>(y) * m_width + x) * 3 + c] = static_cast<uint8_t>(std::min(maxValue, std::max(0.0f, sum[c])) + 0.5f);
+            }
+        }
     }
+    m_PixelData.swap(result);
 }
 
 // Sets a pixel to a specific R,G,B value 
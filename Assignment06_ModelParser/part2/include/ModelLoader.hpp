@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
@@ -6,8 +7,17 @@
 class ModelLoader {
 public:
     bool loadOBJ(const std::string& path);
+    // One vertex per distinct corner: position, color, and normal (9 floats)
     const std::vector<float>& getVertexData() const;
+    // Three indices per triangle into the vertex data. The indices are 16
+    // bit (getIndexSize() of 2) when every vertex can be reached with
+    // them, otherwise 32 bit (getIndexSize() of 4).
+    const void* getIndexData() const;
+    size_t getIndexCount() const;
+    size_t getIndexSize() const;
 
 private:
     std::vector<float> vertexData;
+    std::vector<uint16_t> shortIndices;
+    std::vector<uint32_t> indices;
 };
@@ -1,50 +1,24 @@
 #include "ModelLoader.hpp"
-#include <fstream>
-#include <sstream>
+#include "ObjParser.hpp"
+#include "VertexWelder.hpp"
 #include <iostream>
 
 bool ModelLoader::loadOBJ(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cout << "OBJ file " << path << "could not be opened\n";
+    // The file is mapped and scanned in place (see ObjParser.hpp)
+    ObjData data;
+    if (!loadOBJFile(path, data)) {
         return false;
     }
 
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<unsigned int> vertexIndices, normalIndices;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream ss(line);
-        std::string prefix;
-        ss >> prefix;
-
-        if (prefix == "v") {
-            glm::vec3 pos;
-            ss >> pos.x >> pos.y >> pos.z;
-            positions.push_back(pos);
-        } else if (prefix == "vn") {
-            glm::vec3 norm;
-            ss >> norm.x >> norm.y >> norm.z;
-            normals.push_back(norm);
-        } else if (prefix == "f") {
-            unsigned int vIdx[3], nIdx[3];
-            char s;
-            for (int i = 0; i < 3; ++i) {
-                ss >> vIdx[i] >> s >> s >> nIdx[i];
-                vertexIndices.push_back(vIdx[i]);
-                normalIndices.push_back(nIdx[i]);
-            }
-        }
-    }
-
-    for (size_t i = 0; i < vertexIndices.size(); ++i) {
-        unsigned int vi = vertexIndices[i] - 1;
-        unsigned int ni = normalIndices[i] - 1;
+    // Corners shared between triangles become one vertex
+    std::vector<ObjCorner> unique;
+    weldCorners(data.corners, unique, indices);
 
-        glm::vec3 pos = positions[vi];
-        glm::vec3 norm = normals[ni];
+    vertexData.clear();
+    vertexData.reserve(unique.size() * 9);
+    for (const ObjCorner& corner : unique) {
+        glm::vec3 pos = data.positions[corner.position];
+        glm::vec3 norm = corner.normal >= 0 ? data.normals[corner.normal] : glm::vec3(0.0f);
         glm::vec3 color = glm::vec3(0.8f, 0.8f, 0.8f);
 
         vertexData.insert(vertexData.end(), { pos.x, pos.y, pos.z });
@@ -52,9 +26,32 @@ bool ModelLoader::loadOBJ(const std::string& path) {
         vertexData.insert(vertexData.end(), { norm.x, norm.y, norm.z });
     }
 
+    // Half the index memory when every vertex fits in 16 bits
+    shortIndices.clear();
+    if (unique.size() <= 65536) {
+        shortIndices.assign(indices.begin(), indices.end());
+        indices.clear();
+    }
+
+    std::cout << "Welded " << data.corners.size() << " corners into " << unique.size() << " vertices\n";
     return true;
 }
 
 const std::vector<float>& ModelLoader::getVertexData() const {
     return vertexData;
 }
+
+const void* ModelLoader::getIndexData() const {
+    if (!shortIndices.empty()) {
+        return shortIndices.data();
+    }
+    return indices.data();
+}
+
+size_t ModelLoader::getIndexCount() const {
+    return shortIndices.empty() ? indices.size() : shortIndices.size();
+}
+
+size_t ModelLoader::getIndexSize() const {
+    return shortIndices.empty() ? sizeof(uint32_t) : sizeof(uint16_t);
+}
@@ -0,0 +1,47 @@
+#include "VertexWelder.hpp"
+
+// Mixes the three indices of a corner into one well spread value
+static inline uint32_t hashCorner(const ObjCorner& corner) {
+    uint64_t h = static_cast<uint32_t>(corner.position);
+    h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(corner.texCoord);
+    h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(corner.normal);
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return static_cast<uint32_t>(h);
+}
+
+static inline bool sameCorner(const ObjCorner& a, const ObjCorner& b) {
+    return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+}
+
+void weldCorners(const std::vector<ObjCorner>& corners,
+                 std::vector<ObjCorner>& unique,
+                 std::vector<uint32_t>& indices) {
+    unique.clear();
+    indices.clear();
+    indices.reserve(corners.size());
+
+    // There are never more distinct corners than corners. A power of two
+    // at least twice that keeps the table at most half full, so probes
+    // stay short, and lets a mask replace the modulo.
+    size_t capacity = 16;
+    while (capacity < corners.size() * 2) {
+        capacity *= 2;
+    }
+    const size_t mask = capacity - 1;
+    // Each slot holds 1 + an index into unique, or 0 when empty
+    std::vector<uint32_t> table(capacity, 0);
+
+    for (const ObjCorner& corner : corners) {
+        size_t slot = hashCorner(corner) & mask;
+        while (table[slot] != 0 && !sameCorner(unique[table[slot] - 1], corner)) {
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] == 0) {
+            unique.push_back(corner);
+            table[slot] = static_cast<uint32_t>(unique.size());
+        }
+        indices.push_back(table[slot] - 1);
+    }
+}
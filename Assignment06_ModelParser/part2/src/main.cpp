@@ -29,8 +29,10 @@ bool wireframeMode = false;
 bool modelLoaded = false;
 
 GLuint gGraphicsPipelineShaderProgram = 0;
-GLuint vao = 0, vbo = 0;
+GLuint vao = 0, vbo = 0, ebo = 0;
 size_t vertexCount = 0;
+size_t indexCount = 0;
+GLenum indexType = GL_UNSIGNED_INT;
 Camera camera;
 
 // vvvvvvvvvvvvvvvvvvv Error Handling Routines vvvvvvvvvvvvvvv
@@ -235,6 +237,12 @@ void GenerateBufferData(const ModelLoader& model) {
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+    // Triangles index into the welded vertices
+    indexCount = model.getIndexCount();
+    indexType = model.getIndexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * model.getIndexSize(), model.getIndexData(), GL_STATIC_DRAW);
 }
 
 void VertexSpecification(const ModelLoader& model) {
@@ -242,6 +250,7 @@ void VertexSpecification(const ModelLoader& model) {
     glBindVertexArray(vao);
 
     glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
 
     GenerateBufferData(model);
 
@@ -336,7 +345,7 @@ void PreDraw() {
 
 void Draw() {
     glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
     glBindVertexArray(0);
 
     glUseProgram(0);
@@ -357,6 +366,7 @@ void MainLoop() {
 void CleanUp() {
     // Delete our OpenGL Objects
     glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
     glDeleteVertexArrays(1, &vao);
 
     // Delete our Graphics pipeline
@@ -0,0 +1,395 @@
+#include "ObjParser.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+// Spaces and tabs separate the values on a line
+static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+// Returns the first character of the next line
+static inline const char* nextLine(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+// Parses one float, e.g. "-0.613298" or "1e-05". A leading '+' is allowed
+// even though from_chars does not take one. Values that are missing or
+// malformed are read as 0 so one bad number does not stop the load.
+static inline const char* parseFloat(const char* p, const char* end, float& value) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+        ++p;
+    }
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        value = 0.0f;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            ++p;
+        }
+        return p;
+    }
+    return result.ptr;
+}
+
+// Parses an OBJ index. Returns false if there is no number at p.
+static inline bool parseIndex(const char*& p, const char* end, long& value) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    if (p >= end || *p < '0' || *p > '9') {
+        return false;
+    }
+    long result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// OBJ indices count from 1, or back from the last vertex read so far
+// when negative. Returns -1 if the index is 0 or out of range.
+static inline int resolveIndex(long index, size_t count) {
+    long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+    if (index == 0 || resolved < 0 || resolved >= static_cast<long>(count)) {
+        return -1;
+    }
+    return static_cast<int>(resolved);
+}
+
+// Number of each kind of record in a piece of the file. Also used as
+// the offsets a piece writes its records at.
+struct ObjCounts {
+    size_t positions = 0;
+    size_t texCoords = 0;
+    size_t normals = 0;
+    size_t corners = 0;
+    // Material of the faces at the start of a piece (from the last
+    // 'usemtl' before it), -1 if there was none
+    int material = -1;
+};
+
+// Parses one corner of a face: v, v/vt, v//vn or v/vt/vn. Indices are
+// resolved against the number of each kind of vertex read so far.
+// Returns false if the position index is missing or out of range.
+static bool parseCorner(const char*& p, const char* end, const ObjCounts& read, ObjCorner& corner) {
+    long index = 0;
+    corner.texCoord = -1;
+    corner.normal = -1;
+    if (!parseIndex(p, end, index)) {
+        return false;
+    }
+    corner.position = resolveIndex(index, read.positions);
+    if (p < end && *p == '/') {
+        ++p;
+        if (parseIndex(p, end, index)) {
+            corner.texCoord = resolveIndex(index, read.texCoords);
+        }
+        if (p < end && *p == '/') {
+            ++p;
+            if (parseIndex(p, end, index)) {
+                corner.normal = resolveIndex(index, read.normals);
+            }
+        }
+    }
+    return corner.position >= 0;
+}
+
+// True if the line at p starts with keyword followed by a space
+static inline bool isKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+    return p + length < end && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+}
+
+// Returns the rest of the line at p, without the spaces around it
+static std::string_view readName(const char* p, const char* end) {
+    p = skipSpaces(p, end);
+    const char* last = p;
+    while (last < end && *last != '\n' && *last != '\r') {
+        ++last;
+    }
+    while (last > p && (last[-1] == ' ' || last[-1] == '\t')) {
+        --last;
+    }
+    return std::string_view(p, last - p);
+}
+
+// Prints the line starting at p so a bad file can be found
+static void printBadLine(const char* p, const char* end) {
+    const char* lineEnd = nextLine(p, end);
+    std::cerr << "Invalid face in OBJ file: " << std::string(p, lineEnd - p);
+}
+
+// First pass: counts the records in [begin, end) without parsing any
+// numbers. A face of n corners becomes n - 2 triangles. The names of
+// 'usemtl' and 'mtllib' lines are collected in order.
+static void countRecords(const char* begin, const char* end, ObjCounts& counts,
+                         std::vector<std::string_view>& materials,
+                         std::vector<std::string_view>& libraries) {
+    const char* p = begin;
+    while (p < end) {
+        const char* line = skipSpaces(p, end);
+        if (line + 1 < end && line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) {
+            ++counts.positions;
+        } else if (line + 2 < end && line[0] == 'v' && line[1] == 't' && (line[2] == ' ' || line[2] == '\t')) {
+            ++counts.texCoords;
+        } else if (line + 2 < end && line[0] == 'v' && line[1] == 'n' && (line[2] == ' ' || line[2] == '\t')) {
+            ++counts.normals;
+        } else if (line + 1 < end && line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+            size_t count = 0;
+            const char* q = skipSpaces(line + 1, end);
+            while (q < end && *q != '\n' && *q != '\r' && *q != '#') {
+                ++count;
+                while (q < end && *q != ' ' && *q != '\t' && *q != '\n' && *q != '\r') {
+                    ++q;
+                }
+                q = skipSpaces(q, end);
+            }
+            if (count >= 3) {
+                counts.corners += (count - 2) * 3;
+            }
+        } else if (isKeyword(line, end, "usemtl", 6)) {
+            materials.push_back(readName(line + 6, end));
+        } else if (isKeyword(line, end, "mtllib", 6)) {
+            libraries.push_back(readName(line + 6, end));
+        }
+        p = nextLine(line, end);
+    }
+}
+
+// Second pass: parses the records in [begin, end) into the arrays of
+// data, which are already large enough, starting at offsets. Indices are
+// resolved against everything before this piece plus what this piece has
+// read so far, which is exactly what a parse from the start would see.
+static bool parseRecords(const char* begin, const char* end, ObjData& data, ObjCounts offsets,
+                         const std::unordered_map<std::string_view, int>& materialIds) {
+    const char* p = begin;
+    while (p < end) {
+        const char* line = skipSpaces(p, end);
+        if (line + 1 < end && line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) {
+            glm::vec3& position = data.positions[offsets.positions++];
+            const char* q = parseFloat(line + 2, end, position.x);
+            q = parseFloat(q, end, position.y);
+            parseFloat(q, end, position.z);
+        } else if (line + 2 < end && line[0] == 'v' && line[1] == 't' && (line[2] == ' ' || line[2] == '\t')) {
+            glm::vec2& texCoord = data.texCoords[offsets.texCoords++];
+            const char* q = parseFloat(line + 3, end, texCoord.x);
+            parseFloat(q, end, texCoord.y);
+        } else if (line + 2 < end && line[0] == 'v' && line[1] == 'n' && (line[2] == ' ' || line[2] == '\t')) {
+            glm::vec3& normal = data.normals[offsets.normals++];
+            const char* q = parseFloat(line + 3, end, normal.x);
+            q = parseFloat(q, end, normal.y);
+            parseFloat(q, end, normal.z);
+        } else if (line + 1 < end && line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+            // Split the face into a fan around its first corner
+            ObjCorner first = { -1, -1, -1 }, previous = first, corner = first;
+            int count = 0;
+            const char* q = skipSpaces(line + 1, end);
+            while (q < end && *q != '\n' && *q != '\r' && *q != '#') {
+                if (!parseCorner(q, end, offsets, corner)) {
+                    printBadLine(line, end);
+                    return false;
+                }
+                if (count == 0) {
+                    first = corner;
+                } else if (count >= 2) {
+                    data.triangleMaterials[offsets.corners / 3] = offsets.material;
+                    data.corners[offsets.corners++] = first;
+                    data.corners[offsets.corners++] = previous;
+                    data.corners[offsets.corners++] = corner;
+                }
+                previous = corner;
+                ++count;
+                q = skipSpaces(q, end);
+            }
+        } else if (isKeyword(line, end, "usemtl", 6)) {
+            offsets.material = materialIds.at(readName(line + 6, end));
+        }
+        // Everything else (comments, groups, materials) is skipped
+        p = nextLine(line, end);
+    }
+    return true;
+}
+
+// Runs work(0..count-1) with each piece on its own thread. The calling
+// thread takes piece 0 rather than waiting idle.
+template <typename Work>
+static void forEachChunk(size_t count, Work work) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < count; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+bool parseOBJ(const char* begin, const char* end, ObjData& data, unsigned int threadCount) {
+    // Split the text into about one piece per thread, each ending at a
+    // line break. Small files are not worth starting threads for.
+    const size_t minimumChunkSize = 256 * 1024;
+    size_t size = end - begin;
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, size / minimumChunkSize));
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds[0] = begin;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        const char* split = std::max(bounds[i - 1], begin + size * i / chunkCount);
+        bounds[i] = split > begin ? nextLine(split - 1, end) : begin;
+    }
+
+    // Count every piece, then a prefix sum of the counts gives each piece
+    // the place its records go in the arrays
+    std::vector<ObjCounts> offsets(chunkCount);
+    std::vector<std::vector<std::string_view>> materials(chunkCount);
+    std::vector<std::vector<std::string_view>> libraries(chunkCount);
+    forEachChunk(chunkCount, [&](size_t i) {
+        countRecords(bounds[i], bounds[i + 1], offsets[i], materials[i], libraries[i]);
+    });
+    ObjCounts total;
+    total.positions = data.positions.size();
+    total.texCoords = data.texCoords.size();
+    total.normals = data.normals.size();
+    total.corners = data.corners.size();
+    // Materials are numbered in the order they first appear. A piece
+    // starts with the material the previous pieces ended with.
+    // The map keeps views of the names, so the names must not move
+    size_t nameCount = data.materialNames.size();
+    for (const std::vector<std::string_view>& names : materials) {
+        nameCount += names.size();
+    }
+    data.materialNames.reserve(nameCount);
+    std::unordered_map<std::string_view, int> materialIds;
+    for (const std::string& name : data.materialNames) {
+        materialIds.emplace(name, materialIds.size());
+    }
+    total.material = data.triangleMaterials.empty() ? -1 : data.triangleMaterials.back();
+    for (size_t i = 0; i < chunkCount; ++i) {
+        ObjCounts count = offsets[i];
+        offsets[i] = total;
+        total.positions += count.positions;
+        total.texCoords += count.texCoords;
+        total.normals += count.normals;
+        total.corners += count.corners;
+        for (std::string_view name : materials[i]) {
+            auto found = materialIds.emplace(name, materialIds.size());
+            if (found.second) {
+                data.materialNames.emplace_back(name);
+            }
+            total.material = found.first->second;
+        }
+        for (std::string_view name : libraries[i]) {
+            data.materialLibraries.emplace_back(name);
+        }
+    }
+    data.positions.resize(total.positions);
+    data.texCoords.resize(total.texCoords);
+    data.normals.resize(total.normals);
+    data.corners.resize(total.corners);
+    data.triangleMaterials.resize(total.corners / 3);
+
+    // Parse every piece straight into its place
+    std::vector<char> succeeded(chunkCount, 0);
+    forEachChunk(chunkCount, [&](size_t i) {
+        succeeded[i] = parseRecords(bounds[i], bounds[i + 1], data, offsets[i], materialIds);
+    });
+    return std::find(succeeded.begin(), succeeded.end(), 0) == succeeded.end();
+}
+
+bool loadOBJFile(const std::string& path, ObjData& data, unsigned int threadCount) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "OBJ file " << path << " could not be opened\n";
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    const char* begin = reinterpret_cast<const char*>(file.GetData());
+    bool success = parseOBJ(begin, begin + file.GetSize(), data, threadCount);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double megabytes = file.GetSize() / (1024.0 * 1024.0);
+    std::cout << "Parsed " << megabytes << " MB of OBJ data in " << elapsed.count() * 1000.0 << " ms ("
+              << megabytes / elapsed.count() << " MB/s)\n";
+    return success;
+}
+
+// Directory part of path, including the last '/', or empty
+static std::string getDirectory(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Texture maps may have options before the file name (e.g. "-bm 0.5"),
+// so the file name is taken to be the last word on the line
+static std::string readMapPath(const char* p, const char* end, const std::string& directory) {
+    std::string_view rest = readName(p, end);
+    size_t space = rest.find_last_of(" \t");
+    if (space != std::string_view::npos) {
+        rest = rest.substr(space + 1);
+    }
+    return rest.empty() ? std::string() : directory + std::string(rest);
+}
+
+bool loadMTLFile(const std::string& path, std::vector<ObjMaterial>& materials) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "MTL file " << path << " could not be opened\n";
+        return false;
+    }
+    const std::string directory = getDirectory(path);
+    const char* p = reinterpret_cast<const char*>(file.GetData());
+    const char* end = p + file.GetSize();
+    ObjMaterial* material = nullptr;
+    while (p < end) {
+        const char* line = skipSpaces(p, end);
+        if (isKeyword(line, end, "newmtl", 6)) {
+            materials.emplace_back();
+            material = &materials.back();
+            material->name = std::string(readName(line + 6, end));
+        } else if (material == nullptr) {
+            // Nothing belongs to a material before the first 'newmtl'
+        } else if (isKeyword(line, end, "Ka", 2)) {
+            const char* q = parseFloat(line + 2, end, material->ambient.x);
+            q = parseFloat(q, end, material->ambient.y);
+            parseFloat(q, end, material->ambient.z);
+        } else if (isKeyword(line, end, "Kd", 2)) {
+            const char* q = parseFloat(line + 2, end, material->diffuse.x);
+            q = parseFloat(q, end, material->diffuse.y);
+            parseFloat(q, end, material->diffuse.z);
+        } else if (isKeyword(line, end, "Ks", 2)) {
+            const char* q = parseFloat(line + 2, end, material->specular.x);
+            q = parseFloat(q, end, material->specular.y);
+            parseFloat(q, end, material->specular.z);
+        } else if (isKeyword(line, end, "Ns", 2)) {
+            parseFloat(line + 2, end, material->shininess);
+        } else if (isKeyword(line, end, "d", 1)) {
+            parseFloat(line + 1, end, material->opacity);
+        } else if (isKeyword(line, end, "map_Kd", 6)) {
+            material->diffuseMap = readMapPath(line + 6, end, directory);
+        } else if (isKeyword(line, end, "map_Bump", 8) || isKeyword(line, end, "map_bump", 8)) {
+            material->normalMap = readMapPath(line + 8, end, directory);
+        } else if (isKeyword(line, end, "bump", 4)) {
+            material->normalMap = readMapPath(line + 4, end, directory);
+        } else if (isKeyword(line, end, "map_Ks", 6)) {
+            material->specularMap = readMapPath(line + 6, end, directory);
+        }
+        p = nextLine(line, end);
+    }
+    return true;
+}
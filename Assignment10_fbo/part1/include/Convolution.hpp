@@ -0,0 +1,119 @@
+/** @file Convolution.hpp
+ *  @brief Runs convolution kernels over images on the CPU.
+ *
+ *  The framebuffer shader (shaders/fboFrag.glsl) filters the screen with
+ *  a 3x3 kernel on the GPU. The same filters can be run here without a
+ *  GPU, e.g. to process textures in a batch, or to check what the shader
+ *  produced.
+ *
+ *  Results match the shader: weights are applied to every color channel,
+ *  samples that fall off the image wrap around (GL_REPEAT, which is what
+ *  the framebuffer texture uses since it sets no wrap mode), samples
+ *  between pixels are blended like GL_LINEAR, and the sum is clamped to
+ *  0-255 and rounded like an 8 bit framebuffer does.
+ *
+ *  Unlike resampling and mip generation, which filter linear light
+ *  through FloatImage, the kernel is applied to the stored (gamma
+ *  encoded) values. The framebuffer is not sRGB, so that is what the
+ *  shader filters, and filtering linear light would no longer match it.
+ *
+ *  Kernels that are the product of a column and a row (box, Gaussian)
+ *  are detected and run as two 1D passes, which costs 2N instead of N*N
+ *  multiplies per pixel. The image is processed in tiles small enough to
+ *  stay in the cache, with SSE2 when available, and bands of tiles are
+ *  split across threads.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef CONVOLUTION_HPP
+#define CONVOLUTION_HPP
+
+#include "Image.hpp"
+
+#include <vector>
+#include <cstdint>
+
+class ConvolutionKernel{
+public:
+    // Builds a width x height kernel. Both must be odd. Weights are given
+    // row by row with the top row first, in the same order as the kernel
+    // array in the shader. An invalid kernel becomes the 1x1 identity.
+    ConvolutionKernel(int width, int height, const std::vector<float>& weights);
+    // The edge detection kernel from fboFrag.glsl
+    static ConvolutionKernel Laplacian();
+    // Sharpens edges, keeping overall brightness the same
+    static ConvolutionKernel Sharpen();
+    // Average of a (2*radius+1) square
+    static ConvolutionKernel Box(int radius);
+    // Gaussian blur over a (2*radius+1) square, normalized to sum to 1
+    static ConvolutionKernel Gaussian(int radius, float sigma);
+    // Dimensions of the kernel
+    inline int GetWidth() const{
+        return m_width;
+    }
+    inline int GetHeight() const{
+        return m_height;
+    }
+    // Weight at column x, row y (row 0 is the top row)
+    inline float GetWeight(int x, int y) const{
+        return m_weights[y*m_width+x];
+    }
+    // True if the kernel is a column times a row
+    inline bool IsSeparable() const{
+        return m_separable;
+    }
+    // The two factors of a separable kernel.
+    // GetWeight(x,y) == GetColumnWeights()[y] * GetRowWeights()[x]
+    inline const std::vector<float>& GetRowWeights() const{
+        return m_rowWeights;
+    }
+    inline const std::vector<float>& GetColumnWeights() const{
+        return m_columnWeights;
+    }
+private:
+    // Checks whether the kernel is a column times a row, and if it is
+    // fills in m_rowWeights and m_columnWeights
+    void FindSeparableFactors();
+
+    int m_width{1};
+    int m_height{1};
+    std::vector<float> m_weights;
+    bool m_separable{false};
+    std::vector<float> m_rowWeights;
+    std::vector<float> m_columnWeights;
+};
+
+// What a sample that falls off the edge of the image reads
+enum class EdgeMode{
+    Repeat,         // Wraps to the other side, like GL_REPEAT
+    ClampToEdge     // Reads the nearest edge pixel, like GL_CLAMP_TO_EDGE
+};
+
+struct ConvolutionSettings{
+    EdgeMode edgeMode{EdgeMode::Repeat};
+    // Distance in pixels between neighboring taps. A tap that falls
+    // between pixels blends the two nearest ones, like GL_LINEAR sampling.
+    float stepX{1.0f};
+    float stepY{1.0f};
+    // 0 uses one thread per hardware core
+    unsigned int threadCount{0};
+    // Settings that reproduce fboFrag.glsl filtering a width x height
+    // framebuffer. Its taps are 1/300 of the texture apart, which is
+    // width/300 pixels across and height/300 pixels up and down.
+    static ConvolutionSettings MatchShader(int width, int height);
+};
+
+// Convolves a width x height RGB image into out, which must hold
+// width*height*3 bytes and must not overlap pixels. Rows are in OpenGL
+// order (row 0 at the bottom), so the top row of the kernel is applied
+// to the row above, at y+1.
+void Convolve(const uint8_t* pixels, int width, int height, uint8_t* out,
+              const ConvolutionKernel& kernel, const ConvolutionSettings& settings=ConvolutionSettings());
+
+// Convolves the pixels of a loaded image in place. A Tiled image (see
+// PixelLayout.hpp) is read and written in its own layout.
+void Convolve(Image& image, const ConvolutionKernel& kernel,
+              const ConvolutionSettings& settings=ConvolutionSettings());
+
+#endif
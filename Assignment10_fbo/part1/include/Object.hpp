@@ -13,6 +13,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 // Forward declarations
 #include "VertexBufferLayout.hpp"
@@ -34,7 +35,7 @@ public:
     // Object destructor
     ~Object();
     // Load a texture
-    void LoadTexture(std::string fileName);
+    void LoadTexture(std::string fileName, const TextureSettings& settings = TextureSettings());
     // Create a textured quad
     void MakeTexturedQuad(std::string fileName);
     // How to draw the object
@@ -45,10 +46,12 @@ protected: // Classes that inherit from Object are intended to be overridden.
 
     // For now we have one buffer per object.
     VertexBufferLayout m_vertexBufferLayout;
-    // For now we have one diffuse map
-    Texture m_textureDiffuse;
+    // For now we have one diffuse map.
+    // Textures come from the TextureRegistry, so objects using the
+    // same image share one texture.
+    std::shared_ptr<Texture> m_textureDiffuse;
     // Terrains are often 'multitextured' and have multiple textures.
-    Texture m_detailMap; // NOTE: Note yet supported
+    std::shared_ptr<Texture> m_detailMap; // NOTE: Note yet supported
     // Store the objects Geometry
 	Geometry m_geometry;
 };
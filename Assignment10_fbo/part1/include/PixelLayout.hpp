@@ -0,0 +1,80 @@
+/** @file PixelLayout.hpp
+ *  @brief Ways of ordering the pixels of an image in memory.
+ *
+ *  Images are normally stored row by row (Linear). Reading a pixel and
+ *  its neighbors above and below then touches three rows that are a
+ *  whole image width apart, which on a 4096 pixel wide image means three
+ *  different pages of memory for every pixel.
+ *
+ *  The Tiled layout stores the image as 8x8 pixel tiles, each tile's 192
+ *  bytes back to back, with the tiles in row order. Pixels that are close
+ *  together in 2D are then close together in memory, so kernels that read
+ *  a neighborhood of pixels (convolution, normals, bilinear sampling)
+ *  mostly hit cache lines they have already loaded.
+ *
+ *  Convolve() reads and writes a Tiled image in place of converting it,
+ *  copying one tile row (8 pixels) at a time.
+ *
+ *  Tiled images are padded to a whole number of tiles, and OpenGL and the
+ *  PPM writer expect Linear pixels, so convert back before using them.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef PIXEL_LAYOUT_HPP
+#define PIXEL_LAYOUT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+enum class PixelLayout{
+    Linear,     // Row by row
+    Tiled       // 8x8 tiles of pixels, row by row within each tile
+};
+
+// Width and height of a tile in pixels
+static const int s_pixelTileSize = 8;
+
+// Byte offset of pixel (x,y) of an RGB image that is width pixels wide
+inline size_t GetLinearPixelOffset(int x, int y, int width){
+    return ((size_t)y*width + x)*3;
+}
+
+// Unsigned math lets the divisions by the tile size become shifts
+inline size_t GetTiledPixelOffset(int x, int y, int width){
+    size_t tilesAcross = ((size_t)width + s_pixelTileSize - 1)/s_pixelTileSize;
+    size_t tile = ((size_t)y/s_pixelTileSize)*tilesAcross + (size_t)x/s_pixelTileSize;
+    size_t inTile = ((size_t)y%s_pixelTileSize)*s_pixelTileSize + (size_t)x%s_pixelTileSize;
+    return (tile*s_pixelTileSize*s_pixelTileSize + inTile)*3;
+}
+
+// Byte offset of pixel (x,y) in either layout
+inline size_t GetLayoutPixelOffset(PixelLayout layout, int x, int y, int width){
+    return (layout == PixelLayout::Tiled) ? GetTiledPixelOffset(x, y, width)
+                                          : GetLinearPixelOffset(x, y, width);
+}
+
+// How many pixels of row y, starting at x, lie one after another in
+// memory: the rest of the row when Linear, the rest of the tile row when
+// Tiled. Kernels that walk the pixels directly copy runs this long.
+inline int GetPixelRun(PixelLayout layout, int x, int width){
+    int run = width - x;
+    if(layout == PixelLayout::Tiled){
+        run = std::min(run, s_pixelTileSize - x%s_pixelTileSize);
+    }
+    return run;
+}
+
+// Number of bytes a width x height RGB image takes in a layout
+size_t GetPixelDataSize(PixelLayout layout, int width, int height);
+
+// Reorders a Linear RGB image into out, which must hold
+// GetPixelDataSize(PixelLayout::Tiled, width, height) bytes.
+// Padding pixels past the right and bottom edges are set to 0.
+void ConvertLinearToTiled(const uint8_t* pixels, int width, int height, uint8_t* out);
+
+// Reorders a Tiled RGB image into out, which must hold width*height*3 bytes
+void ConvertTiledToLinear(const uint8_t* pixels, int width, int height, uint8_t* out);
+
+#endif
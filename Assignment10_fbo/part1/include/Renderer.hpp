@@ -39,6 +39,11 @@ public:
     void Update();
     // Render the scene
     void Render();
+    // Reads back the scene drawn into the framebuffer and the filtered
+    // screen, runs the kernel from fboFrag.glsl over the scene on the
+    // CPU (see Convolution.hpp), and prints how closely the two agree.
+    // Call after Render() and before the window is swapped.
+    void CompareFilterWithCPU();
     // Sets the root of our renderer to some node to
     // draw an entire scene graph
     void setRoot(std::shared_ptr<SceneNode> startingNode);
@@ -0,0 +1,54 @@
+/** @file Resample.hpp
+ *  @brief Resizes images to any resolution.
+ *
+ *  Each output pixel is a weighted sum of the source pixels around the
+ *  matching point in the source image. The filter decides the weights:
+ *  bilinear looks at the nearest 2x2 pixels, bicubic (Catmull-Rom) at
+ *  4x4 and Lanczos at 6x6, giving progressively sharper results. When
+ *  shrinking, the filter is widened so every source pixel still counts.
+ *  Pixels past the edge of the image repeat the edge pixel.
+ *
+ *  The filter is applied across each row and then down each column. The
+ *  weights for every output column and row are worked out once up front.
+ *  Both passes use SSE2 when available, and bands of output rows are
+ *  split across threads.
+ *
+ *  Resizing to the same size returns the image unchanged with every
+ *  filter. 8 bit color values are filtered as they are stored (in sRGB);
+ *  to filter in linear space, resize a FloatImage instead.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include "FloatImage.hpp"
+
+#include <cstdint>
+
+enum class ResampleFilter{
+    Bilinear,
+    Bicubic,
+    Lanczos3
+};
+
+// Resizes a width x height image with channels interleaved 8 bit values
+// per pixel (e.g. 3 for RGB, 1 for a single channel) to outWidth x
+// outHeight. out receives outWidth*outHeight*channels floats in the same
+// 0-255 range as the source. threadCount of 0 uses one thread per core.
+void Resample(const uint8_t* pixels, int width, int height, int channels,
+              float* out, int outWidth, int outHeight,
+              ResampleFilter filter=ResampleFilter::Bicubic, unsigned int threadCount=0);
+
+// Same as above, rounding and clamping the results to 8 bit values
+void Resample(const uint8_t* pixels, int width, int height, int channels,
+              uint8_t* out, int outWidth, int outHeight,
+              ResampleFilter filter=ResampleFilter::Bicubic, unsigned int threadCount=0);
+
+// Resizes a float image. Color images decoded with FloatImage::DecodeSRGB
+// hold linear values, so this filters in linear space.
+void Resample(const FloatImage& source, FloatImage& out, int outWidth, int outHeight,
+              ResampleFilter filter=ResampleFilter::Bicubic, unsigned int threadCount=0);
+
+#endif
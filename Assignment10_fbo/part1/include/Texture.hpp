@@ -10,18 +10,83 @@
 #define TEXTURE_HPP
 
 #include "Image.hpp"
+#include "MipChain.hpp"
+#include "BlockCompression.hpp"
 
 #include <glad/glad.h>
 #include <string>
+#include <memory>
 
-class Texture{
+// From GL_EXT_texture_compression_s3tc, which glad was not generated with
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// How a texture is sampled. Two textures made from the same image
+// with different settings are different textures on the GPU.
+struct TextureSettings{
+    GLint minFilter{GL_LINEAR_MIPMAP_LINEAR};
+    GLint magFilter{GL_LINEAR};
+    GLint wrapS{GL_CLAMP_TO_EDGE};
+    GLint wrapT{GL_CLAMP_TO_EDGE};
+    bool mipmaps{true};
+    // Block compression to store the texture with on the GPU. Ignored
+    // (and the texture stored uncompressed) if the driver lacks S3TC.
+    BlockFormat compression{BlockFormat::None};
+    // Keep the decoded pixels (and mipmap levels) in memory after they
+    // have been uploaded, e.g. to read them on the CPU with GetImage().
+    // By default they are freed, since the GPU has its own copy.
+    bool keepPixels{false};
+};
+
+class Texture : public std::enable_shared_from_this<Texture>{
 public:
     // Constructor
     Texture();
     // Destructor
     ~Texture();
+    // A texture owns a GPU resource, so it cannot be copied.
+    // Share one with TextureRegistry instead.
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
 	// Loads and sets up an actual texture
-    void LoadTexture(const std::string filepath);
+    void LoadTexture(const std::string filepath, const TextureSettings& settings = TextureSettings());
+    // Makes a texture from pixels already in memory (e.g. an atlas page).
+    // The texture takes ownership of image.
+    void LoadTexture(Image* image, const TextureSettings& settings = TextureSettings());
+    // Loads a texture without blocking. A 1x1 placeholder is bound until
+    // the TextureLoader has decoded the image on a worker thread and
+    // streamed it to the GPU. The texture must be owned by a shared_ptr.
+    void LoadTextureAsync(const std::string filepath, const TextureSettings& settings = TextureSettings());
+    // Called by the TextureLoader on the OpenGL thread once the image has
+    // been decoded. Takes ownership of image, its mipmap levels, and its
+    // compressed blocks (empty if not compressed), and creates the pixel
+    // buffer the pixels are streamed through. Returns false (and keeps
+    // the placeholder) if the image could not be loaded.
+    bool BeginUpload(Image* image, MipChain&& mips, CompressedChain&& compressed);
+    // Streams at most maxBytes of the decoded image and its mipmap levels
+    // to the GPU. Returns the number of bytes uploaded. Once every row of
+    // every level is uploaded the placeholder is swapped for the real texture.
+    size_t UploadRows(size_t maxBytes);
+    // True if the driver can use BC1/BC3 (S3TC) compressed textures.
+    // Must be called on the OpenGL thread.
+    static bool IsCompressionSupported();
+    // True once the real texture (not the placeholder) is bound
+    inline bool IsReady() const{
+        return m_ready;
+    }
+    // Returns the decoded image. Only available after the upload if the
+    // texture was loaded with keepPixels, otherwise nullptr.
+    inline Image* GetImage() const{
+        return m_image;
+    }
+    // Returns the OpenGL id of the texture
+    inline GLuint GetID() const{
+        return m_textureID;
+    }
 	// slot tells us which slot we want to bind to.
     // We can have multiple slots. By default, we
     // will set our slot to 0 if it is not specified.
@@ -29,12 +94,49 @@ public:
     // Be done with our texture
     void Unbind();
 private:
+    // Sets the filters and wrap modes on the bound texture
+    void ApplySettings();
+    // Describes one level of what is being streamed: its size in pixels,
+    // its data, and its rows. A compressed row is a row of 4x4 blocks.
+    struct UploadLevel{
+        int width;
+        int height;
+        const uint8_t* data;
+        size_t rowBytes;
+        int rowCount;
+        int pixelsPerRow;
+    };
+    UploadLevel GetUploadLevel(unsigned int level) const;
+    // Number of levels (full size image included) being streamed
+    unsigned int GetUploadLevelCount() const;
+    // OpenGL format of the compressed blocks
+    GLenum GetCompressedFormat() const;
+    // Called once the upload is done. Frees the CPU copy of the pixels
+    // unless the settings ask to keep them.
+    void FinishUpload();
+    // Compresses m_image if asked to and sends it and its mipmap levels
+    // to the GPU in one go
+    void UploadImage();
     // Store a unique ID for the texture
-    GLuint m_textureID;
+    GLuint m_textureID{0};
 	// Filepath to the image loaded
     std::string m_filepath;
+    // How the texture is sampled
+    TextureSettings m_settings;
+    // True once m_textureID holds the real image
+    bool m_ready{false};
+    // While streaming: the texture being filled in, the pixel buffer
+    // object the rows go through, and which level and row are next.
+    GLuint m_pendingID{0};
+    GLuint m_uploadBuffer{0};
+    unsigned int m_uploadLevel{0};
+    int m_uploadedRows{0};
     // Store whatever image data inside of our texture class.
-    Image* m_image;
+    Image* m_image{nullptr};
+    // Smaller mipmap levels, made on the CPU (or read from the cache)
+    MipChain m_mips;
+    // Every level in compressed form, empty if not compressed
+    CompressedChain m_compressed;
 };
 
 
@@ -0,0 +1,136 @@
+/** @file TextureAtlas.hpp
+ *  @brief Packs many small textures into a few large ones.
+ *
+ *  Every texture an object uses costs a bind when it is drawn. A scene
+ *  made of many small textures spends much of its time switching between
+ *  them. An atlas copies the images side by side into a few large pages,
+ *  and objects have their texture coordinates moved into their image's
+ *  rectangle, so consecutive objects share one texture.
+ *
+ *  Images are placed with a skyline packer: each page remembers the
+ *  height of the top edge of what has been placed so far, and a new
+ *  image goes at the lowest spot (then the leftmost) it fits. Images
+ *  are placed tallest first, which keeps the skyline flat.
+ *
+ *  Around every image is a gutter of copies of its edge pixels. Without
+ *  it, filtering (and every mipmap level, where neighbors are averaged
+ *  together) would bleed the neighboring images in. Images are placed
+ *  on multiples of the gutter size, so at mipmap level k the gutter is
+ *  still gutter>>k texels wide. The pages stop at the last level where
+ *  that is at least one texel, so no level mixes two images.
+ *
+ *  Wrapping (GL_REPEAT) can not work inside an atlas; coordinates are
+ *  clamped to the image as GL_CLAMP_TO_EDGE would.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+
+#include "Image.hpp"
+#include "Texture.hpp"
+#include "Geometry.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+struct AtlasSettings{
+    // Largest width and height of a page. Pages are shrunk to the
+    // smallest power of two that holds what was placed on them.
+    int pageSize{2048};
+    // Pixels of edge copies around every image. Rounded up to a power
+    // of two, and at least 4 so images also start on BC blocks.
+    int gutter{8};
+    // How the pages are sampled and stored
+    TextureSettings textureSettings;
+};
+
+// Where an image ended up
+struct AtlasRegion{
+    // Page the image is on, or -1 if it could not be loaded or placed
+    int page{-1};
+    // Rectangle of the image's own pixels (without the gutter) on the page
+    int x{0};
+    int y{0};
+    int width{0};
+    int height{0};
+    // A texture coordinate of the image becomes offset + coordinate*scale
+    float offsetS{0};
+    float offsetT{0};
+    float scaleS{1};
+    float scaleT{1};
+};
+
+class TextureAtlas{
+public:
+    // Constructor
+    TextureAtlas(const AtlasSettings& settings = AtlasSettings());
+    // Destructor
+    ~TextureAtlas();
+    // The pages are GPU resources shared with objects, so an atlas
+    // cannot be copied.
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+    // Adds an image to be packed and returns its id. Adding the same
+    // file again returns the same id. Must be called before Pack().
+    int Add(const std::string& filepath);
+    // Loads every image and packs them into pages on the CPU.
+    // Returns false if any image could not be loaded or was larger
+    // than a page; the others are still packed.
+    bool Pack();
+    // Packs (if not done yet) and uploads every page as a texture.
+    bool Build();
+    // Returns where the image with the given id was placed
+    const AtlasRegion& GetRegion(int id) const;
+    // Moves the texture coordinates of geometry into the image's
+    // rectangle. Returns false (and leaves geometry alone) if the image
+    // is not in the atlas.
+    bool RemapTextureCoords(Geometry& geometry, int id) const;
+    // Number of pages the images were packed into
+    inline int GetPageCount() const{
+        return m_pages.size();
+    }
+    // Returns the pixels of a page after Pack(), or nullptr once Build()
+    // has handed them to the texture.
+    Image* GetPageImage(int page) const;
+    // Returns the texture of a page after Build()
+    std::shared_ptr<Texture> GetTexture(int page) const;
+private:
+    // A horizontal piece of the top edge of everything placed on a page
+    struct SkylineSegment{
+        int x;
+        int y;
+        int width;
+    };
+
+    struct Page{
+        std::vector<SkylineSegment> skyline;
+        // Size of the area actually used
+        int usedWidth{0};
+        int usedHeight{0};
+        Image* image{nullptr};
+        std::shared_ptr<Texture> texture;
+    };
+
+    // Finds the lowest (then leftmost) spot a width x height rectangle
+    // fits on page. Returns false if there is none.
+    bool FindPosition(const Page& page, int width, int height, int& x, int& y, size_t& segment) const;
+    // Raises the skyline of page over a rectangle placed at segment
+    void Place(Page& page, size_t segment, int x, int y, int width, int height);
+    // Copies source into page at the region, surrounded by its gutter
+    void CopyWithGutter(Image& source, Image& page, const AtlasRegion& region) const;
+
+    AtlasSettings m_settings;
+    // Gutter size after rounding (see AtlasSettings)
+    int m_gutter;
+    std::vector<std::string> m_filepaths;
+    std::unordered_map<std::string, int> m_ids;
+    std::vector<AtlasRegion> m_regions;
+    std::vector<Page> m_pages;
+    bool m_packed{false};
+};
+
+#endif
@@ -0,0 +1,82 @@
+/** @file TextureCache.hpp
+ *  @brief Keeps decoded texture pixels on disk between runs.
+ *
+ *  Decoding a PPM is the slow part of creating a texture. The first time
+ *  a texture is loaded, its decoded and already flipped pixels are written
+ *  to a sidecar file next to the image (e.g. rock.ppm.texcache). On later
+ *  runs that file is memory mapped and handed straight to OpenGL.
+ *
+ *  The mipmap levels made from the image are stored after the pixels, so
+ *  they do not have to be generated again either. They are stored even
+ *  when the first load had no use for them, so every load of an image
+ *  shares one cache file. A texture that is block compressed (see
+ *  BlockCompression.hpp) also keeps its compressed levels there.
+ *
+ *  A cache file is only used if the size of the source image still
+ *  matches what was recorded, and either its modification time or (if
+ *  that changed) the hash of its contents does too. A hit with an
+ *  unchanged time never reads the source image at all.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include "Image.hpp"
+#include "MipChain.hpp"
+#include "BlockCompression.hpp"
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+
+// Identifies the exact version of a source image a cache file was made from
+struct TextureCacheKey{
+    uint64_t sourceSize{0};
+    int64_t sourceModifiedTime{0};
+    uint64_t sourceHash{0};
+};
+
+class TextureCache{
+public:
+    // Fills image from the cache file for filepath if one exists and is
+    // up to date. If mips is not null the cache file must also hold the
+    // mipmap levels, which are copied into mips. If compressed is not
+    // null and the file holds blocks in format, they are copied into
+    // compressed (which is left empty otherwise, without it being a miss).
+    // Returns false on a miss.
+    static bool Load(const std::string& filepath, Image& image, MipChain* mips=nullptr,
+                     CompressedChain* compressed=nullptr, BlockFormat format=BlockFormat::None);
+    // Writes the (flipped) pixels of image, the mipmap levels if mips is
+    // not null, and the blocks if compressed holds every one of those
+    // levels, to the cache file for filepath. Leaving out the levels
+    // means a later load that needs them will miss.
+    static void Store(const std::string& filepath, Image& image, const MipChain* mips=nullptr,
+                      const CompressedChain* compressed=nullptr);
+    // Loads image (and its mipmap levels if mips is not null, and its
+    // blocks in format if compressed is not null) from the cache, or
+    // decodes the .ppm, generates the levels, compresses them, and
+    // stores everything for next time. Returns false (leaving image
+    // empty) if the .ppm can not be read.
+    static bool LoadImage(const std::string& filepath, Image& image, MipChain* mips=nullptr,
+                          CompressedChain* compressed=nullptr, BlockFormat format=BlockFormat::None);
+    // Returns the path of the sidecar file used for filepath
+    static std::string GetCachePath(const std::string& filepath);
+    // Number of lookups that found an up to date cache file
+    static unsigned int GetHits();
+    // Number of lookups that had to decode the source image
+    static unsigned int GetMisses();
+    // Prints the hit and miss counts
+    static void PrintStatistics();
+private:
+    // Computes size, modification time, and content hash of a source image.
+    // Reads the whole image, so it is only done when storing.
+    static bool ComputeKey(const std::string& filepath, TextureCacheKey& key);
+
+    // Textures may be loaded on several threads at once
+    static std::atomic<unsigned int> s_hits;
+    static std::atomic<unsigned int> s_misses;
+};
+
+#endif
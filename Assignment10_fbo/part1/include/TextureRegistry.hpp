@@ -0,0 +1,46 @@
+/** @file TextureRegistry.hpp
+ *  @brief Shares textures between objects that use the same image.
+ *
+ *  Scenes often use the same image on many objects (e.g. every moon is
+ *  'rock.ppm'). Rather than every object decoding and uploading its own
+ *  copy, objects ask the registry for a texture. The first request loads
+ *  it, and every later request for the same file and sampler settings
+ *  gets a handle to that same texture.
+ *
+ *  The registry only holds weak references, so a texture is deleted from
+ *  the GPU as soon as the last object using it goes away.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef TEXTURE_REGISTRY_HPP
+#define TEXTURE_REGISTRY_HPP
+
+#include "Texture.hpp"
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+class TextureRegistry{
+public:
+    // Returns the texture for filepath with the given settings,
+    // loading it only if no one is using it already.
+    // New textures load in the background (see TextureLoader).
+    static std::shared_ptr<Texture> Get(const std::string& filepath, const TextureSettings& settings = TextureSettings());
+    // Number of textures currently alive
+    static unsigned int GetLiveCount();
+    // Prints how many requests were loads and how many were shared
+    static void PrintStatistics();
+private:
+    // Builds the lookup key from the canonical path and the settings
+    static std::string MakeKey(const std::string& filepath, const TextureSettings& settings);
+    // Forgets entries whose texture has already been deleted
+    static void RemoveExpired();
+
+    static std::unordered_map<std::string, std::weak_ptr<Texture>> s_textures;
+    static unsigned int s_loads;
+    static unsigned int s_reuses;
+};
+
+#endif
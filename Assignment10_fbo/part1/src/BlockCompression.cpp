@@ -0,0 +1,346 @@
+#include "BlockCompression.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <algorithm>
+
+size_t GetBlockSize(BlockFormat format){
+    switch(format){
+        case BlockFormat::BC1: return 8;
+        case BlockFormat::BC3: return 16;
+        default: return 0;
+    }
+}
+
+size_t GetCompressedSize(BlockFormat format, int width, int height){
+    return (size_t)((width+3)/4) * ((height+3)/4) * GetBlockSize(format);
+}
+
+// Packs an 8 bit per channel color into 5:6:5 bits, rounding to nearest
+static inline uint16_t PackColor565(int r, int g, int b){
+    return (uint16_t)((((r*31+127)/255) << 11) | (((g*63+127)/255) << 5) | ((b*31+127)/255));
+}
+
+// Expands a 5:6:5 color back to 8 bits per channel the way GPUs do
+static inline void UnpackColor565(uint16_t c, int color[3]){
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// The four colors a BC1 block can pick from
+static void MakePalette(uint16_t c0, uint16_t c1, bool fourColors, int palette[4][3]){
+    UnpackColor565(c0, palette[0]);
+    UnpackColor565(c1, palette[1]);
+    for(int c=0; c < 3; ++c){
+        if(fourColors){
+            palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+        }else{
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+static inline void WriteLittleEndian16(uint8_t* out, uint16_t value){
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+// Compresses the 16 RGB colors of one block into 8 bytes.
+// The endpoints are the extremes of the colors along their principal
+// axis (the direction the colors vary the most in), pulled in slightly
+// so rounding to 5:6:5 does not overshoot.
+static void CompressColorBlock(const int colors[16][3], uint8_t* out){
+    float mean[3] = {0,0,0};
+    for(int i=0; i < 16; ++i){
+        for(int c=0; c < 3; ++c){
+            mean[c] += colors[i][c];
+        }
+    }
+    for(int c=0; c < 3; ++c){
+        mean[c] /= 16.0f;
+    }
+    // Covariance of the colors (symmetric, so 6 values)
+    float cov[6] = {0,0,0,0,0,0};
+    for(int i=0; i < 16; ++i){
+        float r = colors[i][0]-mean[0], g = colors[i][1]-mean[1], b = colors[i][2]-mean[2];
+        cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+        cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+    }
+    // A few rounds of power iteration find the principal axis
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for(int iteration=0; iteration < 4; ++iteration){
+        float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+        float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+        float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+        float length = std::max({std::fabs(x), std::fabs(y), std::fabs(z)});
+        if(length < 1e-6f){
+            break;
+        }
+        axis[0] = x/length; axis[1] = y/length; axis[2] = z/length;
+    }
+    float minimum = std::numeric_limits<float>::max();
+    float maximum = -minimum;
+    for(int i=0; i < 16; ++i){
+        float t = (colors[i][0]-mean[0])*axis[0] + (colors[i][1]-mean[1])*axis[1] + (colors[i][2]-mean[2])*axis[2];
+        minimum = std::min(minimum, t);
+        maximum = std::max(maximum, t);
+    }
+    float axisLength = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+    if(axisLength > 0.0f){
+        minimum /= axisLength;
+        maximum /= axisLength;
+    }
+    float inset = (maximum - minimum) / 16.0f;
+    int endpoint[2][3];
+    for(int c=0; c < 3; ++c){
+        endpoint[0][c] = std::min(255, std::max(0, (int)std::lround(mean[c] + axis[c]*(maximum-inset))));
+        endpoint[1][c] = std::min(255, std::max(0, (int)std::lround(mean[c] + axis[c]*(minimum+inset))));
+    }
+    uint16_t c0 = PackColor565(endpoint[0][0], endpoint[0][1], endpoint[0][2]);
+    uint16_t c1 = PackColor565(endpoint[1][0], endpoint[1][1], endpoint[1][2]);
+    // c0 > c1 selects the four color mode
+    if(c0 < c1){
+        std::swap(c0, c1);
+    }
+    uint32_t indices = 0;
+    if(c0 != c1){
+        int palette[4][3];
+        MakePalette(c0, c1, true, palette);
+        for(int i=0; i < 16; ++i){
+            int best = 0;
+            int bestDistance = std::numeric_limits<int>::max();
+            for(int p=0; p < 4; ++p){
+                int dr = colors[i][0]-palette[p][0], dg = colors[i][1]-palette[p][1], db = colors[i][2]-palette[p][2];
+                int distance = dr*dr + dg*dg + db*db;
+                if(distance < bestDistance){
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2*i);
+        }
+    }
+    WriteLittleEndian16(out, c0);
+    WriteLittleEndian16(out+2, c1);
+    for(int i=0; i < 4; ++i){
+        out[4+i] = (indices >> (8*i)) & 0xFF;
+    }
+}
+
+// Compresses the 16 alpha values of one block into 8 bytes: the largest
+// and smallest alpha, then a 3 bit index per pixel into 8 values
+// spread evenly between them.
+static void CompressAlphaBlock(const int alpha[16], uint8_t* out){
+    int a0 = *std::max_element(alpha, alpha+16);
+    int a1 = *std::min_element(alpha, alpha+16);
+    uint64_t indices = 0;
+    if(a0 != a1){
+        int values[8] = {a0, a1};
+        for(int i=1; i < 7; ++i){
+            values[i+1] = ((7-i)*a0 + i*a1) / 7;
+        }
+        for(int i=0; i < 16; ++i){
+            int best = 0;
+            int bestDistance = 256;
+            for(int v=0; v < 8; ++v){
+                int distance = std::abs(alpha[i]-values[v]);
+                if(distance < bestDistance){
+                    bestDistance = distance;
+                    best = v;
+                }
+            }
+            indices |= (uint64_t)best << (3*i);
+        }
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for(int i=0; i < 6; ++i){
+        out[2+i] = (indices >> (8*i)) & 0xFF;
+    }
+}
+
+void CompressBlocks(const uint8_t* pixels, int width, int height, int channels,
+                    BlockFormat format, uint8_t* out, unsigned int threadCount){
+    int blocksWide = (width+3)/4;
+    int blocksHigh = (height+3)/4;
+    size_t blockSize = GetBlockSize(format);
+    auto compressRows = [=](int begin, int end){
+        int colors[16][3];
+        int alpha[16];
+        for(int by=begin; by < end; ++by){
+            for(int bx=0; bx < blocksWide; ++bx){
+                for(int i=0; i < 16; ++i){
+                    // Blocks hanging off the edge repeat the last row and column
+                    int x = std::min(bx*4 + (i & 3), width-1);
+                    int y = std::min(by*4 + (i >> 2), height-1);
+                    const uint8_t* pixel = pixels + ((size_t)y*width + x)*channels;
+                    colors[i][0] = pixel[0];
+                    colors[i][1] = pixel[1];
+                    colors[i][2] = pixel[2];
+                    alpha[i] = (channels == 4) ? pixel[3] : 255;
+                }
+                uint8_t* block = out + ((size_t)by*blocksWide + bx)*blockSize;
+                if(format == BlockFormat::BC3){
+                    CompressAlphaBlock(alpha, block);
+                    block += 8;
+                }
+                CompressColorBlock(colors, block);
+            }
+        }
+    };
+
+    // Only worth starting threads for a reasonable number of blocks
+    const int minimumBlockRowsPerThread = 16;
+    if(threadCount == 0){
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int bands = std::min<int>(threadCount, blocksHigh / minimumBlockRowsPerThread);
+    if(bands <= 1){
+        compressRows(0, blocksHigh);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for(int i=1; i < bands; ++i){
+        workers.emplace_back(compressRows, blocksHigh*i/bands, blocksHigh*(i+1)/bands);
+    }
+    compressRows(0, blocksHigh/bands);
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+}
+
+void DecompressBlocks(const uint8_t* blocks, int width, int height,
+                      BlockFormat format, uint8_t* out, int channels){
+    int blocksWide = (width+3)/4;
+    int blocksHigh = (height+3)/4;
+    size_t blockSize = GetBlockSize(format);
+    for(int by=0; by < blocksHigh; ++by){
+        for(int bx=0; bx < blocksWide; ++bx){
+            const uint8_t* block = blocks + ((size_t)by*blocksWide + bx)*blockSize;
+            int alpha[16];
+            std::fill(alpha, alpha+16, 255);
+            if(format == BlockFormat::BC3){
+                int a0 = block[0], a1 = block[1];
+                int values[8] = {a0, a1};
+                if(a0 > a1){
+                    for(int i=1; i < 7; ++i){
+                        values[i+1] = ((7-i)*a0 + i*a1) / 7;
+                    }
+                }else{
+                    for(int i=1; i < 5; ++i){
+                        values[i+1] = ((5-i)*a0 + i*a1) / 5;
+                    }
+                    values[6] = 0;
+                    values[7] = 255;
+                }
+                uint64_t indices = 0;
+                for(int i=0; i < 6; ++i){
+                    indices |= (uint64_t)block[2+i] << (8*i);
+                }
+                for(int i=0; i < 16; ++i){
+                    alpha[i] = values[(indices >> (3*i)) & 7];
+                }
+                block += 8;
+            }
+            uint16_t c0 = block[0] | (block[1] << 8);
+            uint16_t c1 = block[2] | (block[3] << 8);
+            uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+            int palette[4][3];
+            // BC3 color blocks always use four colors
+            MakePalette(c0, c1, c0 > c1 || format == BlockFormat::BC3, palette);
+            for(int i=0; i < 16; ++i){
+                int x = bx*4 + (i & 3);
+                int y = by*4 + (i >> 2);
+                if(x >= width || y >= height){
+                    continue;
+                }
+                const int* color = palette[(indices >> (2*i)) & 3];
+                uint8_t* pixel = out + ((size_t)y*width + x)*channels;
+                pixel[0] = color[0];
+                pixel[1] = color[1];
+                pixel[2] = color[2];
+                if(channels == 4){
+                    pixel[3] = alpha[i];
+                }
+            }
+        }
+    }
+}
+
+void CompressedChain::Compress(const uint8_t* pixels, int width, int height, const MipChain* mips,
+                               BlockFormat format, unsigned int threadCount){
+    Clear();
+    if(pixels == nullptr || format == BlockFormat::None){
+        return;
+    }
+    m_format = format;
+    unsigned int mipLevels = (mips != nullptr) ? mips->GetLevelCount() : 0;
+    m_data.resize(LayoutLevels(width, height, mips, 1 + mipLevels));
+    for(unsigned int level=0; level <= mipLevels; ++level){
+        const uint8_t* source = (level == 0) ? pixels : mips->GetLevelData(level);
+        CompressBlocks(source, m_levels[level].width, m_levels[level].height, 3,
+                       format, m_data.data() + m_levels[level].offset, threadCount);
+    }
+}
+
+bool CompressedChain::Assign(const uint8_t* data, size_t size, BlockFormat format, int width, int height,
+                             unsigned int levelCount){
+    Clear();
+    if(data == nullptr || format == BlockFormat::None || levelCount == 0){
+        return false;
+    }
+    m_format = format;
+    size_t needed = LayoutLevels(width, height, nullptr, levelCount);
+    if(size < needed){
+        Clear();
+        return false;
+    }
+    m_data.assign(data, data + needed);
+    return true;
+}
+
+// Level 0 is width x height. The levels below come from mips if given,
+// otherwise they halve the way MipChain does.
+size_t CompressedChain::LayoutLevels(int width, int height, const MipChain* mips, unsigned int levelCount){
+    m_levels.clear();
+    size_t offset = 0;
+    for(unsigned int level=0; level < levelCount; ++level){
+        if(level > 0){
+            width = (mips != nullptr) ? mips->GetWidth(level) : std::max(1, width/2);
+            height = (mips != nullptr) ? mips->GetHeight(level) : std::max(1, height/2);
+        }
+        size_t size = GetCompressedSize(m_format, width, height);
+        m_levels.push_back(Level{width, height, offset, size});
+        offset += size;
+    }
+    return offset;
+}
+
+void CompressedChain::Clear(){
+    m_format = BlockFormat::None;
+    m_levels.clear();
+    // Swapping with an empty vector frees the memory, clear() would not
+    std::vector<uint8_t>().swap(m_data);
+}
+
+int CompressedChain::GetWidth(unsigned int level) const{
+    return m_levels[level].width;
+}
+
+int CompressedChain::GetHeight(unsigned int level) const{
+    return m_levels[level].height;
+}
+
+const uint8_t* CompressedChain::GetLevelData(unsigned int level) const{
+    return m_data.data() + m_levels[level].offset;
+}
+
+size_t CompressedChain::GetLevelSize(unsigned int level) const{
+    return m_levels[level].size;
+}
@@ -0,0 +1,89 @@
+#include "BufferPool.hpp"
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+// Free buffers are only kept while they add up to less than this
+static const size_t s_maxPooledBytes = 64*1024*1024;
+
+// Free buffers by bucket size
+static std::map<size_t, std::vector<uint8_t*>> s_buckets;
+static size_t s_pooledBytes = 0;
+static unsigned int s_reused = 0;
+static unsigned int s_allocated = 0;
+// Images are decoded on the texture loader threads
+static std::mutex s_mutex;
+
+// Sizes from 8 to 16 steps are rounded up to a whole number of steps,
+// where step is a power of two, so 8 sizes cover each doubling and no
+// bucket is more than 1/8 larger than the request
+size_t BufferPool::GetBucketSize(size_t size){
+    if(size <= 64){
+        return 64;
+    }
+    size_t step = 1;
+    while(step*8 <= size){
+        step *= 2;
+    }
+    return ((size + step - 1)/step)*step;
+}
+
+uint8_t* BufferPool::Acquire(size_t size){
+    size_t bucketSize = GetBucketSize(size);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto bucket = s_buckets.find(bucketSize);
+        if(bucket != s_buckets.end() && !bucket->second.empty()){
+            uint8_t* buffer = bucket->second.back();
+            bucket->second.pop_back();
+            s_pooledBytes -= bucketSize;
+            ++s_reused;
+            return buffer;
+        }
+        ++s_allocated;
+    }
+    return new uint8_t[bucketSize];
+}
+
+void BufferPool::Release(uint8_t* buffer, size_t size){
+    if(buffer == nullptr){
+        return;
+    }
+    size_t bucketSize = GetBucketSize(size);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if(s_pooledBytes + bucketSize <= s_maxPooledBytes){
+            s_buckets[bucketSize].push_back(buffer);
+            s_pooledBytes += bucketSize;
+            return;
+        }
+    }
+    delete[] buffer;
+}
+
+void BufferPool::Trim(){
+    std::map<size_t, std::vector<uint8_t*>> buckets;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        buckets.swap(s_buckets);
+        s_pooledBytes = 0;
+    }
+    for(auto& bucket : buckets){
+        for(uint8_t* buffer : bucket.second){
+            delete[] buffer;
+        }
+    }
+}
+
+size_t BufferPool::GetPooledBytes(){
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_pooledBytes;
+}
+
+void BufferPool::PrintStatistics(){
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::cout << "Image buffers: " << s_reused << " reused, " << s_allocated << " allocated, "
+              << s_pooledBytes/(1024.0*1024.0) << " MB pooled" << std::endl;
+}
@@ -0,0 +1,356 @@
+#include "Convolution.hpp"
+#include "RowBands.hpp"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// Output is produced in tiles of this many pixels. The source rows a tile
+// needs (as floats) then fit in the L2 cache even for large kernels.
+static const int s_tileWidth = 256;
+static const int s_tileHeight = 64;
+
+ConvolutionKernel::ConvolutionKernel(int width, int height, const std::vector<float>& weights){
+    if(width < 1 || height < 1 || width%2 == 0 || height%2 == 0 || weights.size() != (size_t)width*height){
+        std::cout << "Convolution kernels must have odd dimensions and width*height weights" << std::endl;
+        m_weights = {1.0f};
+    }else{
+        m_width = width;
+        m_height = height;
+        m_weights = weights;
+    }
+    FindSeparableFactors();
+}
+
+ConvolutionKernel ConvolutionKernel::Laplacian(){
+    return ConvolutionKernel(3, 3, {1.0f,  1.0f, 1.0f,
+                                    1.0f, -8.0f, 1.0f,
+                                    1.0f,  1.0f, 1.0f});
+}
+
+ConvolutionKernel ConvolutionKernel::Sharpen(){
+    return ConvolutionKernel(3, 3, { 0.0f, -1.0f,  0.0f,
+                                    -1.0f,  5.0f, -1.0f,
+                                     0.0f, -1.0f,  0.0f});
+}
+
+ConvolutionKernel ConvolutionKernel::Box(int radius){
+    int size = 2*std::max(0, radius)+1;
+    return ConvolutionKernel(size, size, std::vector<float>((size_t)size*size, 1.0f/(size*size)));
+}
+
+ConvolutionKernel ConvolutionKernel::Gaussian(int radius, float sigma){
+    int size = 2*std::max(0, radius)+1;
+    std::vector<float> line(size);
+    float sum = 0.0f;
+    for(int i=0; i < size; ++i){
+        float d = (float)(i - size/2);
+        line[i] = std::exp(-d*d/(2.0f*sigma*sigma));
+        sum += line[i];
+    }
+    std::vector<float> weights((size_t)size*size);
+    for(int y=0; y < size; ++y){
+        for(int x=0; x < size; ++x){
+            weights[y*size+x] = line[y]*line[x]/(sum*sum);
+        }
+    }
+    return ConvolutionKernel(size, size, weights);
+}
+
+// A separable kernel is a column times a row. If it is, the row holding
+// the largest weight is the row factor (up to scale), and dividing that
+// weight's column by it gives the column factor. The factors are then
+// checked against every weight.
+void ConvolutionKernel::FindSeparableFactors(){
+    m_separable = false;
+    m_rowWeights.clear();
+    m_columnWeights.clear();
+    // 1x1 and 1D kernels gain nothing from two passes
+    if(m_width == 1 || m_height == 1){
+        return;
+    }
+    size_t largest = 0;
+    for(size_t i=1; i < m_weights.size(); ++i){
+        if(std::fabs(m_weights[i]) > std::fabs(m_weights[largest])){
+            largest = i;
+        }
+    }
+    float pivot = m_weights[largest];
+    if(pivot == 0.0f){
+        return;
+    }
+    int pivotX = largest % m_width;
+    int pivotY = largest / m_width;
+    std::vector<float> row(m_weights.begin()+pivotY*m_width, m_weights.begin()+(pivotY+1)*m_width);
+    std::vector<float> column(m_height);
+    for(int y=0; y < m_height; ++y){
+        column[y] = GetWeight(pivotX, y)/pivot;
+    }
+    float tolerance = std::fabs(pivot)*1e-5f;
+    for(int y=0; y < m_height; ++y){
+        for(int x=0; x < m_width; ++x){
+            if(std::fabs(column[y]*row[x] - GetWeight(x, y)) > tolerance){
+                return;
+            }
+        }
+    }
+    m_separable = true;
+    m_rowWeights = row;
+    m_columnWeights = column;
+}
+
+// Maps a coordinate that may be off the image back onto it
+static inline int ApplyEdgeMode(int i, int size, EdgeMode mode){
+    if(mode == EdgeMode::Repeat){
+        i %= size;
+        return (i < 0) ? i+size : i;
+    }
+    return std::min(std::max(i, 0), size-1);
+}
+
+// out[i] += weight*in[i] for count floats
+static void MultiplyAdd(float* out, const float* in, float weight, size_t count){
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 w = _mm_set1_ps(weight);
+    for(; i + 8 <= count; i += 8){
+        __m128 a = _mm_add_ps(_mm_loadu_ps(out+i), _mm_mul_ps(_mm_loadu_ps(in+i), w));
+        __m128 b = _mm_add_ps(_mm_loadu_ps(out+i+4), _mm_mul_ps(_mm_loadu_ps(in+i+4), w));
+        _mm_storeu_ps(out+i, a);
+        _mm_storeu_ps(out+i+4, b);
+    }
+#endif
+    for(; i < count; ++i){
+        out[i] += weight*in[i];
+    }
+}
+
+// Clamps and rounds count sums to bytes, as an 8 bit framebuffer would
+static void StoreBytes(const float* in, uint8_t* out, size_t count){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for(; i + 16 <= count; i += 16){
+        __m128i v[4];
+        for(int j=0; j < 4; ++j){
+            __m128 x = _mm_min_ps(max, _mm_max_ps(zero, _mm_loadu_ps(in+i+4*j)));
+            v[j] = _mm_cvttps_epi32(_mm_add_ps(x, half));
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), packed);
+    }
+#endif
+    for(; i < count; ++i){
+        out[i] = (uint8_t)(std::min(255.0f, std::max(0.0f, in[i])) + 0.5f);
+    }
+}
+
+// Per thread scratch space for one tile
+struct ConvolutionTile{
+    // Every source pixel the tile reads, edges already applied, as floats
+    std::vector<float> source;
+    // Row pass results of a separable kernel
+    std::vector<float> rows;
+    // Sums for one output row
+    std::vector<float> sums;
+    // Source column of each column of source
+    std::vector<int> columns;
+    // One output row as bytes, before it is split into tile rows
+    std::vector<uint8_t> bytes;
+};
+
+// Stores count sums as the pixels of row y starting at column x0. A
+// Linear row is one run in memory; a Tiled one is converted at once and
+// then copied a tile row at a time.
+static void StoreRow(const float* sums, uint8_t* out, PixelLayout layout, int width,
+                     int x0, int y, int count, ConvolutionTile& tile){
+    if(layout == PixelLayout::Linear){
+        StoreBytes(sums, out + GetLinearPixelOffset(x0, y, width), (size_t)count*3);
+        return;
+    }
+    tile.bytes.resize((size_t)count*3);
+    StoreBytes(sums, tile.bytes.data(), (size_t)count*3);
+    for(int x=0; x < count;){
+        int run = std::min(count - x, GetPixelRun(layout, x0 + x, width));
+        memcpy(out + GetLayoutPixelOffset(layout, x0 + x, y, width), &tile.bytes[(size_t)x*3], (size_t)run*3);
+        x += run;
+    }
+}
+
+// A tap distance pixels away lands between two whole pixels. Returns the
+// offset of the nearer one on the negative side, and sets fraction to
+// how much of the other one is blended in, as GL_LINEAR would.
+static inline int SplitTap(float distance, float& fraction){
+    float whole = std::floor(distance);
+    fraction = distance - whole;
+    return (int)whole;
+}
+
+// Convolves the output pixels [x0,x1) x [y0,y1). pixels and out are
+// both ordered by layout.
+static void ConvolveTile(const uint8_t* pixels, int width, int height, PixelLayout layout, uint8_t* out,
+                         const ConvolutionKernel& kernel, const ConvolutionSettings& settings,
+                         int x0, int x1, int y0, int y1, ConvolutionTile& tile){
+    const int radiusX = kernel.GetWidth()/2;
+    const int radiusY = kernel.GetHeight()/2;
+    const float stepX = settings.stepX;
+    const float stepY = settings.stepY;
+    // How many whole pixels the furthest taps reach past the tile
+    const int reachX = (int)std::ceil(radiusX*stepX);
+    const int reachY = (int)std::ceil(radiusY*stepY);
+    const int tileWidth = x1 - x0;
+    const int tileHeight = y1 - y0;
+    const int sourceWidth = tileWidth + 2*reachX;
+    const int sourceHeight = tileHeight + 2*reachY + 1;
+    const size_t sourceStride = (size_t)sourceWidth*3 + 3;
+    const size_t outStride = (size_t)tileWidth*3;
+
+    // Gather the source pixels, wrapping or clamping at the edges. One
+    // extra column and row hold the second pixel of the furthest taps.
+    tile.source.resize(sourceStride*sourceHeight);
+    tile.columns.resize(sourceWidth+1);
+    for(int c=0; c <= sourceWidth; ++c){
+        tile.columns[c] = ApplyEdgeMode(x0 - reachX + c, width, settings.edgeMode);
+    }
+    for(int r=0; r < sourceHeight; ++r){
+        const int sourceY = ApplyEdgeMode(y0 - reachY + r, height, settings.edgeMode);
+        float* row = &tile.source[r*sourceStride];
+        int c = 0;
+        while(c <= sourceWidth){
+            // Columns that did not need to wrap are one run in memory,
+            // up to the end of the row (or of the tile row when Tiled)
+            const int longest = GetPixelRun(layout, tile.columns[c], width);
+            int run = 1;
+            while(c + run <= sourceWidth && run < longest && tile.columns[c+run] == tile.columns[c]+run){
+                ++run;
+            }
+            const uint8_t* pixel = pixels + GetLayoutPixelOffset(layout, tile.columns[c], sourceY, width);
+            for(int i=0; i < run*3; ++i){
+                row[c*3+i] = pixel[i];
+            }
+            c += run;
+        }
+    }
+
+    // Column k of the kernel reads (k - radiusX)*stepX pixels across.
+    // The top row of the kernel reads the row above (y+1), which is
+    // further along in memory, so row k reads (radiusY - k)*stepY up.
+    tile.sums.resize(outStride);
+    if(kernel.IsSeparable()){
+        const std::vector<float>& rowWeights = kernel.GetRowWeights();
+        const std::vector<float>& columnWeights = kernel.GetColumnWeights();
+        tile.rows.assign(outStride*sourceHeight, 0.0f);
+        for(int r=0; r < sourceHeight; ++r){
+            for(int k=0; k < kernel.GetWidth(); ++k){
+                float fraction;
+                int column = reachX + SplitTap((k - radiusX)*stepX, fraction);
+                const float* source = &tile.source[r*sourceStride + (size_t)column*3];
+                MultiplyAdd(&tile.rows[r*outStride], source, rowWeights[k]*(1.0f - fraction), outStride);
+                if(fraction > 0.0f){
+                    MultiplyAdd(&tile.rows[r*outStride], source + 3, rowWeights[k]*fraction, outStride);
+                }
+            }
+        }
+        for(int y=0; y < tileHeight; ++y){
+            std::fill(tile.sums.begin(), tile.sums.end(), 0.0f);
+            for(int k=0; k < kernel.GetHeight(); ++k){
+                float fraction;
+                int row = y + reachY + SplitTap((radiusY - k)*stepY, fraction);
+                MultiplyAdd(tile.sums.data(), &tile.rows[row*outStride], columnWeights[k]*(1.0f - fraction), outStride);
+                if(fraction > 0.0f){
+                    MultiplyAdd(tile.sums.data(), &tile.rows[(row+1)*outStride], columnWeights[k]*fraction, outStride);
+                }
+            }
+            StoreRow(tile.sums.data(), out, layout, width, x0, y0+y, tileWidth, tile);
+        }
+        return;
+    }
+    for(int y=0; y < tileHeight; ++y){
+        std::fill(tile.sums.begin(), tile.sums.end(), 0.0f);
+        for(int ky=0; ky < kernel.GetHeight(); ++ky){
+            float fractionY;
+            int row = y + reachY + SplitTap((radiusY - ky)*stepY, fractionY);
+            for(int kx=0; kx < kernel.GetWidth(); ++kx){
+                float weight = kernel.GetWeight(kx, ky);
+                if(weight == 0.0f){
+                    continue;
+                }
+                float fractionX;
+                int column = reachX + SplitTap((kx - radiusX)*stepX, fractionX);
+                // Up to four pixels around the tap, blended bilinearly
+                for(int dy=0; dy < 2; ++dy){
+                    float weightY = dy ? fractionY : 1.0f - fractionY;
+                    if(weightY == 0.0f){
+                        continue;
+                    }
+                    const float* source = &tile.source[(row+dy)*sourceStride + (size_t)column*3];
+                    MultiplyAdd(tile.sums.data(), source, weight*weightY*(1.0f - fractionX), outStride);
+                    if(fractionX > 0.0f){
+                        MultiplyAdd(tile.sums.data(), source + 3, weight*weightY*fractionX, outStride);
+                    }
+                }
+            }
+        }
+        StoreRow(tile.sums.data(), out, layout, width, x0, y0+y, tileWidth, tile);
+    }
+}
+
+ConvolutionSettings ConvolutionSettings::MatchShader(int width, int height){
+    ConvolutionSettings settings;
+    settings.edgeMode = EdgeMode::Repeat;
+    settings.stepX = width/300.0f;
+    settings.stepY = height/300.0f;
+    return settings;
+}
+
+// Convolves an image stored in either layout into out, in the same layout
+static void ConvolvePixels(const uint8_t* pixels, int width, int height, PixelLayout layout, uint8_t* out,
+                           const ConvolutionKernel& kernel, const ConvolutionSettings& settings){
+    if(pixels == nullptr || out == nullptr || width <= 0 || height <= 0){
+        return;
+    }
+    ConvolutionSettings checked = settings;
+    // A negative (or NaN) step falls back to neighboring pixels
+    checked.stepX = (settings.stepX >= 0.0f) ? settings.stepX : 1.0f;
+    checked.stepY = (settings.stepY >= 0.0f) ? settings.stepY : 1.0f;
+
+    // Each thread takes a band of tile rows. The tiles are a whole number
+    // of Tiled layout tiles high, so no two threads write the same one.
+    int tileRows = (height + s_tileHeight - 1)/s_tileHeight;
+    ForEachRowBand(tileRows, (size_t)width*3*s_tileHeight, settings.threadCount, [&](int begin, int end){
+        ConvolutionTile tile;
+        for(int t=begin; t < end; ++t){
+            int y0 = t*s_tileHeight;
+            int y1 = std::min(height, y0 + s_tileHeight);
+            for(int x0=0; x0 < width; x0 += s_tileWidth){
+                ConvolveTile(pixels, width, height, layout, out, kernel, checked, x0, std::min(width, x0 + s_tileWidth), y0, y1, tile);
+            }
+        }
+    });
+}
+
+void Convolve(const uint8_t* pixels, int width, int height, uint8_t* out,
+              const ConvolutionKernel& kernel, const ConvolutionSettings& settings){
+    ConvolvePixels(pixels, width, height, PixelLayout::Linear, out, kernel, settings);
+}
+
+void Convolve(Image& image, const ConvolutionKernel& kernel, const ConvolutionSettings& settings){
+    uint8_t* pixels = image.GetPixelDataPtr();
+    if(pixels == nullptr){
+        return;
+    }
+    // A Tiled image is read and written a tile row at a time, so it is
+    // never converted. Padding past the edges is left as 0.
+    PixelLayout layout = image.GetLayout();
+    size_t size = GetPixelDataSize(layout, image.GetWidth(), image.GetHeight());
+    std::vector<uint8_t> result(size);
+    ConvolvePixels(pixels, image.GetWidth(), image.GetHeight(), layout, result.data(), kernel, settings);
+    memcpy(pixels, result.data(), size);
+}
@@ -0,0 +1,118 @@
+#include "MipChain.hpp"
+#include "FloatImage.hpp"
+#include "RowBands.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// Averages two rows of linear values, 4 at a time with SSE2
+static void AverageRows(const float* a, const float* b, float* out, size_t count){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 half = _mm_set1_ps(0.5f);
+    for(; i + 4 <= count; i += 4){
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+        _mm_storeu_ps(out+i, _mm_mul_ps(sum, half));
+    }
+#endif
+    for(; i < count; ++i){
+        out[i] = (a[i] + b[i])*0.5f;
+    }
+}
+
+void MipChain::LayoutLevels(int width, int height){
+    m_levels.clear();
+    size_t offset = 0;
+    while(width > 1 || height > 1){
+        width = std::max(1, width/2);
+        height = std::max(1, height/2);
+        m_levels.push_back(Level{width, height, offset});
+        offset += (size_t)width*height*3;
+    }
+    m_data.resize(offset);
+}
+
+size_t MipChain::ComputeDataSize(int width, int height){
+    size_t size = 0;
+    while(width > 1 || height > 1){
+        width = std::max(1, width/2);
+        height = std::max(1, height/2);
+        size += (size_t)width*height*3;
+    }
+    return size;
+}
+
+// Each level is made from the linear values of the level above, so
+// rounding only happens once per level when converting back to sRGB.
+void MipChain::Generate(const uint8_t* pixels, int width, int height, unsigned int threadCount){
+    LayoutLevels(width, height);
+    if(pixels == nullptr || m_levels.empty()){
+        return;
+    }
+
+    // Linear copy of the full size image
+    FloatImage source;
+    source.DecodeSRGB(pixels, width, height, 3, threadCount);
+
+    FloatImage destination;
+    for(const Level& level : m_levels){
+        destination.Allocate(level.width, level.height, 3);
+        uint8_t* encoded = m_data.data() + level.offset;
+        ForEachRowBand(level.height, (size_t)source.GetWidth()*3*sizeof(float)*2, threadCount, [&](int begin, int end){
+            std::vector<float> rowAverage((size_t)source.GetWidth()*3);
+            for(int y=begin; y < end; ++y){
+                // Odd sizes repeat the last row or column
+                int y0 = std::min(2*y, source.GetHeight()-1);
+                int y1 = std::min(2*y+1, source.GetHeight()-1);
+                AverageRows(source.GetRow(y0), source.GetRow(y1), rowAverage.data(), rowAverage.size());
+                float* out = destination.GetRow(y);
+                for(int x=0; x < level.width; ++x){
+                    int x0 = std::min(2*x, source.GetWidth()-1)*3;
+                    int x1 = std::min(2*x+1, source.GetWidth()-1)*3;
+                    for(int c=0; c < 3; ++c){
+                        out[x*3+c] = (rowAverage[x0+c] + rowAverage[x1+c])*0.5f;
+                    }
+                }
+                LinearToSRGB(out, encoded + (size_t)y*level.width*3, (size_t)level.width*3);
+            }
+        });
+        std::swap(source, destination);
+    }
+}
+
+bool MipChain::Assign(const uint8_t* data, size_t size, int width, int height){
+    if(data == nullptr || size != ComputeDataSize(width, height)){
+        Clear();
+        return false;
+    }
+    LayoutLevels(width, height);
+    memcpy(m_data.data(), data, size);
+    return true;
+}
+
+void MipChain::Clear(){
+    m_levels.clear();
+    // Swapping with an empty vector frees the memory, clear() would not
+    std::vector<uint8_t>().swap(m_data);
+}
+
+int MipChain::GetWidth(unsigned int level) const{
+    return m_levels[level-1].width;
+}
+
+int MipChain::GetHeight(unsigned int level) const{
+    return m_levels[level-1].height;
+}
+
+const uint8_t* MipChain::GetLevelData(unsigned int level) const{
+    return m_data.data() + m_levels[level-1].offset;
+}
+
+size_t MipChain::GetLevelSize(unsigned int level) const{
+    return (size_t)m_levels[level-1].width*m_levels[level-1].height*3;
+}
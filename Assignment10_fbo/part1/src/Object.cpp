@@ -1,6 +1,7 @@
 #include "Object.hpp"
 #include "Camera.hpp"
 #include "Error.hpp"
+#include "TextureRegistry.hpp"
 
 
 Object::Object(){
@@ -13,9 +14,9 @@ Object::~Object(){
 // TODO: In the future it may be good to 
 // think about loading a 'default' texture
 // if the user forgets to do this action!
-void Object::LoadTexture(std::string fileName){
-        // Load our actual textures
-        m_textureDiffuse.LoadTexture(fileName);
+void Object::LoadTexture(std::string fileName, const TextureSettings& settings){
+        // Load our actual textures, or share one that is already loaded
+        m_textureDiffuse = TextureRegistry::Get(fileName, settings);
 }
 
 // Initialization of object as a 'quad'
@@ -52,7 +53,7 @@ void Object::MakeTexturedQuad(std::string fileName){
 
         // Load our actual texture
         // We are using the input parameter as our texture to load
-        m_textureDiffuse.LoadTexture(fileName.c_str());
+        m_textureDiffuse = TextureRegistry::Get(fileName);
 }
 
 // Bind everything we need in our object
@@ -62,9 +63,11 @@ void Object::Bind(){
         // Make sure we are updating the correct 'buffers'
         m_vertexBufferLayout.Bind();
         // Diffuse map is 0 by default, but it is good to set it explicitly
-        m_textureDiffuse.Bind(0);
+        if(m_textureDiffuse != nullptr){
+            m_textureDiffuse->Bind(0);
+        }
         // Detail map
-//        m_detailMap.Bind(1); // NOTE: Not yet supported
+//        m_detailMap->Bind(1); // NOTE: Not yet supported
 }
 
 // Render our geometry
@@ -1,4 +1,8 @@
 #include "Renderer.hpp"
+#include "Convolution.hpp"
+#include "ImageCompare.hpp"
+
+#include <iostream>
 
 
 // Sets the height and width of our renderer
@@ -124,6 +128,27 @@ void Renderer::Render(){
     m_framebuffers[0]->m_fboShader->Unbind();
 }
 
+// Both reads come back bottom row first, which is the row order
+// Convolve expects
+void Renderer::CompareFilterWithCPU(){
+    size_t size = (size_t)m_screenWidth*m_screenHeight*3;
+    std::vector<uint8_t> scene(size);
+    std::vector<uint8_t> screen(size);
+    std::vector<uint8_t> filtered(size);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, m_framebuffers[0]->m_colorBuffer_id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, scene.data());
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, m_screenWidth, m_screenHeight, GL_RGB, GL_UNSIGNED_BYTE, screen.data());
+
+    Convolve(scene.data(), m_screenWidth, m_screenHeight, filtered.data(), ConvolutionKernel::Laplacian(),
+             ConvolutionSettings::MatchShader(m_screenWidth, m_screenHeight));
+    ImageDifference difference;
+    CompareImages(screen.data(), filtered.data(), m_screenWidth, m_screenHeight, difference);
+    std::cout << "Framebuffer filter, GPU vs CPU: PSNR " << difference.psnr << " dB, SSIM " << difference.ssim
+              << ", max difference " << difference.maxDifference << std::endl;
+}
+
 // Determines what the root is of the renderer, so the
 // scene can be drawn.
 void Renderer::setRoot(std::shared_ptr<SceneNode> startingNode){
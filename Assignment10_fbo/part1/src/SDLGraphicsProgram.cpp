@@ -1,6 +1,7 @@
 #include "SDLGraphicsProgram.hpp"
 #include "Camera.hpp"
 #include "Terrain.hpp"
+#include "TextureLoader.hpp"
 // Include the 'Renderer.hpp' which deteremines what
 // the graphics API is going to be for OpenGL
 #include "Renderer.hpp"
@@ -115,6 +116,9 @@ void SDLGraphicsProgram::SetLoopCallback(std::function<void(void)> callback){
 
     // Get a pointer to the keyboard state
     const Uint8* keyboardState = SDL_GetKeyboardState(NULL);
+    // Set when 'c' is pressed, so the next frame checks the framebuffer
+    // filter against the CPU
+    bool compareFilter = false;
 
 
     // While application is running
@@ -140,6 +144,9 @@ void SDLGraphicsProgram::SetLoopCallback(std::function<void(void)> callback){
                 int mouseY = e.motion.y;
                 renderer->GetCamera(0)->MouseLook(mouseX, mouseY);
             }
+            if(e.type==SDL_KEYDOWN && e.key.keysym.sym==SDLK_c){
+                compareFilter = true;
+            }
         } // End SDL_PollEvent loop.
 
         // Move left or right
@@ -165,8 +172,14 @@ void SDLGraphicsProgram::SetLoopCallback(std::function<void(void)> callback){
 		
         // Update our scene through our renderer
         renderer->Update();
+        // Stream any textures that finished loading to the GPU
+        TextureLoader::Update();
         // Render our scene using our selected renderer
         renderer->Render();
+        if(compareFilter){
+            renderer->CompareFilterWithCPU();
+            compareFilter = false;
+        }
         // Delay to slow things down just a bit!
         SDL_Delay(25);  // TODO: You can change this or implement a frame
                         // independent movement method if you like.
@@ -0,0 +1,266 @@
+#include "TextureAtlas.hpp"
+#include "TextureCache.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+
+// Rounds value up to a multiple of alignment (a power of two)
+static int AlignUp(int value, int alignment){
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Smallest power of two that is at least value
+static int NextPowerOfTwo(int value){
+    int result = 1;
+    while(result < value){
+        result *= 2;
+    }
+    return result;
+}
+
+// Constructor
+TextureAtlas::TextureAtlas(const AtlasSettings& settings) : m_settings(settings){
+    m_gutter = NextPowerOfTwo(std::max(settings.gutter, 4));
+}
+
+// Destructor
+TextureAtlas::~TextureAtlas(){
+    for(Page& page : m_pages){
+        delete page.image;
+    }
+}
+
+int TextureAtlas::Add(const std::string& filepath){
+    auto found = m_ids.find(filepath);
+    if(found != m_ids.end()){
+        return found->second;
+    }
+    int id = m_filepaths.size();
+    m_filepaths.push_back(filepath);
+    m_ids[filepath] = id;
+    return id;
+}
+
+// Finds the lowest spot along the skyline. A rectangle starting at a
+// segment rests on the highest segment underneath it.
+bool TextureAtlas::FindPosition(const Page& page, int width, int height, int& x, int& y, size_t& segment) const{
+    bool found = false;
+    for(size_t i=0; i < page.skyline.size(); ++i){
+        int left = page.skyline[i].x;
+        if(left + width > m_settings.pageSize){
+            break;
+        }
+        int top = 0;
+        for(size_t j=i; j < page.skyline.size() && page.skyline[j].x < left + width; ++j){
+            top = std::max(top, page.skyline[j].y);
+        }
+        if(top + height > m_settings.pageSize){
+            continue;
+        }
+        if(!found || top < y){
+            found = true;
+            x = left;
+            y = top;
+            segment = i;
+        }
+    }
+    return found;
+}
+
+// The segments under the rectangle are replaced by one at its top edge,
+// and the last of them is cut short if it sticks out past the right.
+void TextureAtlas::Place(Page& page, size_t segment, int x, int y, int width, int height){
+    std::vector<SkylineSegment>& skyline = page.skyline;
+    skyline.insert(skyline.begin() + segment, SkylineSegment{x, y + height, width});
+    size_t next = segment + 1;
+    while(next < skyline.size() && skyline[next].x < x + width){
+        int right = skyline[next].x + skyline[next].width;
+        if(right <= x + width){
+            skyline.erase(skyline.begin() + next);
+        }else{
+            skyline[next].width = right - (x + width);
+            skyline[next].x = x + width;
+            break;
+        }
+    }
+    // Neighbors at the same height become one segment
+    for(size_t i=0; i + 1 < skyline.size();){
+        if(skyline[i].y == skyline[i+1].y){
+            skyline[i].width += skyline[i+1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }else{
+            ++i;
+        }
+    }
+    page.usedWidth = std::max(page.usedWidth, x + width);
+    page.usedHeight = std::max(page.usedHeight, y + height);
+}
+
+// Every pixel of the padded rectangle takes the nearest pixel of source,
+// so the gutter repeats the edges and corners of the image.
+void TextureAtlas::CopyWithGutter(Image& source, Image& page, const AtlasRegion& region) const{
+    const int width = region.width;
+    const int height = region.height;
+    const int paddedWidth = AlignUp(width + 2*m_gutter, m_gutter);
+    const int paddedHeight = AlignUp(height + 2*m_gutter, m_gutter);
+    const int left = region.x - m_gutter;
+    const int bottom = region.y - m_gutter;
+    const uint8_t* sourcePixels = source.GetPixelDataPtr();
+    uint8_t* pagePixels = page.GetPixelDataPtr();
+    const size_t pageRowBytes = (size_t)page.GetWidth()*3;
+    for(int row=0; row < paddedHeight; ++row){
+        int sourceRow = std::min(std::max(row - m_gutter, 0), height - 1);
+        const uint8_t* in = sourcePixels + (size_t)sourceRow*width*3;
+        uint8_t* out = pagePixels + (size_t)(bottom + row)*pageRowBytes + (size_t)left*3;
+        for(int column=0; column < m_gutter; ++column){
+            memcpy(out + column*3, in, 3);
+        }
+        memcpy(out + m_gutter*3, in, (size_t)width*3);
+        for(int column=m_gutter + width; column < paddedWidth; ++column){
+            memcpy(out + column*3, in + (size_t)(width - 1)*3, 3);
+        }
+    }
+}
+
+bool TextureAtlas::Pack(){
+    bool success = true;
+    // Load every image. They are flipped like any other texture, so the
+    // rows can be copied into the pages as they are.
+    std::vector<Image*> images(m_filepaths.size(), nullptr);
+    m_regions.assign(m_filepaths.size(), AtlasRegion());
+    for(size_t i=0; i < m_filepaths.size(); ++i){
+        images[i] = new Image(m_filepaths[i]);
+        TextureCache::LoadImage(m_filepaths[i], *images[i]);
+        if(images[i]->GetPixelDataPtr() == nullptr || images[i]->GetWidth() <= 0 || images[i]->GetHeight() <= 0){
+            std::cout << "Unable to add image to atlas: " << m_filepaths[i] << std::endl;
+            delete images[i];
+            images[i] = nullptr;
+            success = false;
+        }
+    }
+
+    // Tallest first, then widest
+    std::vector<size_t> order(m_filepaths.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b){
+        int heightA = images[a] ? images[a]->GetHeight() : 0;
+        int heightB = images[b] ? images[b]->GetHeight() : 0;
+        if(heightA != heightB){
+            return heightA > heightB;
+        }
+        int widthA = images[a] ? images[a]->GetWidth() : 0;
+        int widthB = images[b] ? images[b]->GetWidth() : 0;
+        return widthA > widthB;
+    });
+
+    for(size_t id : order){
+        if(images[id] == nullptr){
+            continue;
+        }
+        AtlasRegion& region = m_regions[id];
+        region.width = images[id]->GetWidth();
+        region.height = images[id]->GetHeight();
+        // Padded sizes are multiples of the gutter, so every placement
+        // (which is always at the corner of an earlier one) is too.
+        int paddedWidth = AlignUp(region.width + 2*m_gutter, m_gutter);
+        int paddedHeight = AlignUp(region.height + 2*m_gutter, m_gutter);
+        if(paddedWidth > m_settings.pageSize || paddedHeight > m_settings.pageSize){
+            std::cout << "Image is larger than an atlas page: " << m_filepaths[id] << std::endl;
+            success = false;
+            continue;
+        }
+        int x = 0;
+        int y = 0;
+        size_t segment = 0;
+        size_t pageIndex = 0;
+        while(pageIndex < m_pages.size() &&
+              !FindPosition(m_pages[pageIndex], paddedWidth, paddedHeight, x, y, segment)){
+            ++pageIndex;
+        }
+        if(pageIndex == m_pages.size()){
+            Page page;
+            page.skyline.push_back(SkylineSegment{0, 0, m_settings.pageSize});
+            m_pages.push_back(page);
+            FindPosition(m_pages[pageIndex], paddedWidth, paddedHeight, x, y, segment);
+        }
+        Place(m_pages[pageIndex], segment, x, y, paddedWidth, paddedHeight);
+        region.page = pageIndex;
+        region.x = x + m_gutter;
+        region.y = y + m_gutter;
+    }
+
+    // Shrink every page to what it needs, and copy the images in
+    for(Page& page : m_pages){
+        page.image = new Image("atlas");
+        page.image->Create(NextPowerOfTwo(page.usedWidth), NextPowerOfTwo(page.usedHeight));
+    }
+    for(size_t id=0; id < m_regions.size(); ++id){
+        AtlasRegion& region = m_regions[id];
+        if(region.page < 0){
+            delete images[id];
+            continue;
+        }
+        Image& page = *m_pages[region.page].image;
+        CopyWithGutter(*images[id], page, region);
+        region.offsetS = (float)region.x/page.GetWidth();
+        region.offsetT = (float)region.y/page.GetHeight();
+        region.scaleS = (float)region.width/page.GetWidth();
+        region.scaleT = (float)region.height/page.GetHeight();
+        delete images[id];
+    }
+
+    std::cout << "Packed " << m_filepaths.size() << " images into "
+              << m_pages.size() << " atlas pages" << std::endl;
+    m_packed = true;
+    return success;
+}
+
+bool TextureAtlas::Build(){
+    bool success = true;
+    if(!m_packed){
+        success = Pack();
+    }
+    // Last mipmap level whose gutter is still a whole texel wide
+    int maxLevel = 0;
+    while((m_gutter >> (maxLevel + 1)) >= 1){
+        ++maxLevel;
+    }
+    for(Page& page : m_pages){
+        if(page.texture != nullptr){
+            continue;
+        }
+        page.texture = std::make_shared<Texture>();
+        page.texture->LoadTexture(page.image, m_settings.textureSettings);
+        // The texture owns the pixels now
+        page.image = nullptr;
+        if(m_settings.textureSettings.mipmaps){
+            page.texture->Bind(0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+            page.texture->Unbind();
+        }
+    }
+    return success;
+}
+
+const AtlasRegion& TextureAtlas::GetRegion(int id) const{
+    return m_regions.at(id);
+}
+
+bool TextureAtlas::RemapTextureCoords(Geometry& geometry, int id) const{
+    if(id < 0 || id >= (int)m_regions.size() || m_regions[id].page < 0){
+        return false;
+    }
+    const AtlasRegion& region = m_regions[id];
+    geometry.RemapTextureCoords(region.offsetS, region.offsetT, region.scaleS, region.scaleT);
+    return true;
+}
+
+Image* TextureAtlas::GetPageImage(int page) const{
+    return m_pages.at(page).image;
+}
+
+std::shared_ptr<Texture> TextureAtlas::GetTexture(int page) const{
+    return m_pages.at(page).texture;
+}
@@ -0,0 +1,259 @@
+#include "TextureCache.hpp"
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <utility>
+#include <thread>
+#include <functional>
+
+// Layout of the start of every cache file.
+// The pixel data follows at dataOffset, and the compressed blocks (if
+// any) at blockOffset.
+struct TextureCacheFileHeader{
+    char magic[8];          // Always "TEXCACHE"
+    uint32_t version;       // Bumped whenever the layout changes
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;     // Number of levels after the full size image
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    uint64_t sourceHash;
+    uint64_t dataOffset;
+    uint64_t dataSize;      // Full size image and every mipmap level
+    uint32_t blockFormat;   // BlockFormat of the blocks, None if there are none
+    uint32_t blockLevels;   // Levels compressed, the full size image included
+    uint64_t blockOffset;
+    uint64_t blockSize;     // Every compressed level, back to back
+};
+
+static const char s_cacheMagic[8] = {'T','E','X','C','A','C','H','E'};
+static const uint32_t s_cacheVersion = 3;
+
+std::atomic<unsigned int> TextureCache::s_hits{0};
+std::atomic<unsigned int> TextureCache::s_misses{0};
+// Numbers the temporary files, so no two writers ever share one
+static std::atomic<unsigned int> s_temporaryFiles{0};
+
+// Quick 64 bit hash of a block of memory.
+// Consumes 8 bytes at a time, so hashing a few MB is well under
+// the cost of reading the file in the first place.
+static uint64_t HashBytes(const uint8_t* data, size_t size){
+    const uint64_t prime = 0x100000001B3ull;
+    uint64_t hash = 0xCBF29CE484222325ull ^ size;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        uint64_t word;
+        memcpy(&word, data+i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for(; i < size; ++i){
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+// The cache file sits right next to the image it came from
+std::string TextureCache::GetCachePath(const std::string& filepath){
+    return filepath + ".texcache";
+}
+
+// Size and modification time of a source image, which are cheap to read
+static bool GetSourceStat(const std::string& filepath, uint64_t& size, int64_t& modifiedTime){
+    std::error_code error;
+    size = std::filesystem::file_size(filepath, error);
+    if(error){
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(filepath, error);
+    if(error){
+        return false;
+    }
+    modifiedTime = time.time_since_epoch().count();
+    return true;
+}
+
+// Hash of the whole source image. Returns false if it can not be read.
+static bool HashSource(const std::string& filepath, uint64_t& hash){
+    MappedFile source;
+    if(!source.Open(filepath)){
+        return false;
+    }
+    hash = HashBytes(source.GetData(), source.GetSize());
+    return true;
+}
+
+// Computes the key that a cache file must match to be used
+bool TextureCache::ComputeKey(const std::string& filepath, TextureCacheKey& key){
+    return GetSourceStat(filepath, key.sourceSize, key.sourceModifiedTime)
+        && HashSource(filepath, key.sourceHash);
+}
+
+// Tries to load image from its cache file.
+bool TextureCache::Load(const std::string& filepath, Image& image, MipChain* mips,
+                        CompressedChain* compressed, BlockFormat format){
+    if(compressed != nullptr){
+        compressed->Clear();
+    }
+    MappedFile cacheFile;
+    TextureCacheKey key;
+    if(cacheFile.Open(GetCachePath(filepath)) && GetSourceStat(filepath, key.sourceSize, key.sourceModifiedTime)
+       && cacheFile.GetSize() >= sizeof(TextureCacheFileHeader)){
+        TextureCacheFileHeader header;
+        memcpy(&header, cacheFile.GetData(), sizeof(header));
+        uint64_t imageSize = (uint64_t)header.width*header.height*3;
+        uint64_t mipSize = header.mipLevels ? MipChain::ComputeDataSize(header.width, header.height) : 0;
+        bool valid = memcmp(header.magic, s_cacheMagic, sizeof(s_cacheMagic)) == 0
+                  && header.version == s_cacheVersion
+                  && header.sourceSize == key.sourceSize
+                  && header.dataSize == imageSize + mipSize
+                  && header.dataOffset + header.dataSize <= cacheFile.GetSize()
+                  && (mips == nullptr || header.mipLevels > 0 || imageSize == 3);
+        // An unchanged size and time mean an unchanged source, so a hit
+        // costs no more than mapping the cache file. Only when the time
+        // differs (e.g. the file was copied or touched) is the source
+        // read and hashed to see whether its contents really changed.
+        if(valid && header.sourceModifiedTime != key.sourceModifiedTime){
+            valid = HashSource(filepath, key.sourceHash) && header.sourceHash == key.sourceHash;
+        }
+        if(valid && mips != nullptr){
+            mips->Assign(cacheFile.GetData() + header.dataOffset + imageSize, mipSize, header.width, header.height);
+        }
+        // The blocks are only used if they are in the format asked for.
+        // Without mipmaps only the full size level is taken.
+        bool hasBlocks = valid && compressed != nullptr && format != BlockFormat::None
+                      && header.blockFormat == static_cast<uint32_t>(format)
+                      && header.blockLevels == 1 + header.mipLevels
+                      && header.blockOffset + header.blockSize <= cacheFile.GetSize();
+        if(hasBlocks){
+            unsigned int levels = (mips != nullptr) ? header.blockLevels : 1;
+            compressed->Assign(cacheFile.GetData() + header.blockOffset, header.blockSize, format,
+                               header.width, header.height, levels);
+        }
+        if(valid){
+            ++s_hits;
+            std::cout << "Texture cache hit: " << filepath << " (hits: " << s_hits << ", misses: " << s_misses << ")" << std::endl;
+            image.LoadMappedPixels(std::move(cacheFile), header.dataOffset, header.width, header.height);
+            return true;
+        }
+    }
+    ++s_misses;
+    std::cout << "Texture cache miss: " << filepath << " (hits: " << s_hits << ", misses: " << s_misses << ")" << std::endl;
+    return false;
+}
+
+// Writes the pixels of image to the cache file for filepath.
+// The file is written under a temporary name and then renamed, so a
+// crash part way through never leaves a half written cache behind.
+void TextureCache::Store(const std::string& filepath, Image& image, const MipChain* mips,
+                         const CompressedChain* compressed){
+    TextureCacheKey key;
+    if(image.GetPixelDataPtr()==nullptr || !ComputeKey(filepath, key)){
+        return;
+    }
+    TextureCacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_cacheMagic, sizeof(s_cacheMagic));
+    header.version = s_cacheVersion;
+    header.width = image.GetWidth();
+    header.height = image.GetHeight();
+    header.sourceSize = key.sourceSize;
+    header.sourceModifiedTime = key.sourceModifiedTime;
+    header.sourceHash = key.sourceHash;
+    header.mipLevels = (mips != nullptr) ? mips->GetLevelCount() : 0;
+    header.dataOffset = sizeof(header);
+    uint64_t imageSize = (uint64_t)header.width*header.height*3;
+    header.dataSize = imageSize + (header.mipLevels ? mips->GetDataSize() : 0);
+    // Blocks are only worth keeping if they cover every level stored
+    if(compressed != nullptr && compressed->GetLevelCount() == 1 + header.mipLevels){
+        header.blockFormat = static_cast<uint32_t>(compressed->GetFormat());
+        header.blockLevels = compressed->GetLevelCount();
+        header.blockOffset = header.dataOffset + header.dataSize;
+        header.blockSize = compressed->GetDataSize();
+    }
+
+    // Several threads may store the same image at once (e.g. a worker and
+    // the main thread), so each writes its own temporary file and the
+    // last rename wins with a complete file.
+    std::string cachePath = GetCachePath(filepath);
+    std::string temporaryPath = cachePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+                              + "." + std::to_string(++s_temporaryFiles) + ".tmp";
+    std::ofstream outFile(temporaryPath.c_str(), std::ios::binary);
+    if(!outFile.is_open()){
+        std::cout << "Unable to write texture cache: " << cachePath << std::endl;
+        return;
+    }
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outFile.write(reinterpret_cast<const char*>(image.GetPixelDataPtr()), imageSize);
+    if(header.mipLevels){
+        outFile.write(reinterpret_cast<const char*>(mips->GetDataPtr()), mips->GetDataSize());
+    }
+    if(header.blockSize){
+        outFile.write(reinterpret_cast<const char*>(compressed->GetDataPtr()), header.blockSize);
+    }
+    outFile.close();
+    // Windows will not rename over an existing file
+    std::remove(cachePath.c_str());
+    if(!outFile || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0){
+        std::cout << "Unable to write texture cache: " << cachePath << std::endl;
+        std::remove(temporaryPath.c_str());
+    }
+}
+
+bool TextureCache::LoadImage(const std::string& filepath, Image& image, MipChain* mips,
+                             CompressedChain* compressed, BlockFormat format){
+    bool wantBlocks = (compressed != nullptr && format != BlockFormat::None);
+    if(Load(filepath, image, mips, compressed, format)){
+        if(!wantBlocks || compressed->GetLevelCount() > 0){
+            return true;
+        }
+        // The pixels were cached but not in this format. Compress them
+        // now, and if we have every level, store the blocks for next time.
+        compressed->Compress(image.GetPixelDataPtr(), image.GetWidth(), image.GetHeight(), mips, format);
+        if(mips != nullptr){
+            Store(filepath, image, mips, compressed);
+        }
+        return true;
+    }
+    if(!image.LoadPPM(true)){
+        return false;
+    }
+    // The levels are stored even if this caller has no use for them (e.g.
+    // a heightmap), so the one cache file serves every later load. Had
+    // they been left out, the next texture load of the image would miss
+    // and write the file all over again.
+    MipChain storedMips;
+    MipChain* levels = (mips != nullptr) ? mips : &storedMips;
+    levels->Generate(image.GetPixelDataPtr(), image.GetWidth(), image.GetHeight());
+    CompressedChain storedBlocks;
+    if(wantBlocks){
+        storedBlocks.Compress(image.GetPixelDataPtr(), image.GetWidth(), image.GetHeight(), levels, format);
+    }
+    Store(filepath, image, levels, wantBlocks ? &storedBlocks : nullptr);
+    if(wantBlocks){
+        // Without mipmaps the caller only wants the full size level
+        if(mips != nullptr){
+            *compressed = std::move(storedBlocks);
+        }else{
+            compressed->Assign(storedBlocks.GetDataPtr(), storedBlocks.GetDataSize(), format,
+                               image.GetWidth(), image.GetHeight(), 1);
+        }
+    }
+    return true;
+}
+
+unsigned int TextureCache::GetHits(){
+    return s_hits;
+}
+
+unsigned int TextureCache::GetMisses(){
+    return s_misses;
+}
+
+void TextureCache::PrintStatistics(){
+    std::cout << "Texture cache hits: " << s_hits << ", misses: " << s_misses << std::endl;
+}
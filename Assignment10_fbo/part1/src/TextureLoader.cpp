@@ -0,0 +1,205 @@
+#include "TextureLoader.hpp"
+#include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "BufferPool.hpp"
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+// A texture waiting to be decoded or uploaded
+struct TextureJob{
+    std::weak_ptr<Texture> texture;
+    std::string filepath;
+    bool mipmaps{false};
+    BlockFormat compression{BlockFormat::None};
+    Image* image{nullptr};
+    MipChain mips;
+    CompressedChain compressed;
+};
+
+// The worker threads and the queues they share with the OpenGL thread.
+// This lives for the whole program and its destructor stops the workers,
+// so no thread is left running when the program exits.
+class TextureWorkerPool{
+public:
+    TextureWorkerPool(){
+        unsigned int cores = std::thread::hardware_concurrency();
+        // Leave a core for the render thread
+        unsigned int count = std::max(1u, std::min(4u, cores > 1 ? cores-1 : 1u));
+        for(unsigned int i=0; i < count; ++i){
+            m_workers.emplace_back(&TextureWorkerPool::Work, this);
+        }
+    }
+
+    ~TextureWorkerPool(){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for(std::thread& worker : m_workers){
+            worker.join();
+        }
+        for(TextureJob& job : m_decoded){
+            delete job.image;
+        }
+    }
+
+    void Submit(TextureJob job){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_waiting.push_back(std::move(job));
+            ++m_outstanding;
+        }
+        m_wake.notify_one();
+    }
+
+    // Moves every decoded job into jobs. Returns true if that leaves
+    // nothing to do: no job waiting, being decoded, or in jobs. Taking the
+    // jobs and counting what is left happen under one lock, so a job is
+    // never between the two when streaming is judged to be finished.
+    bool TakeDecoded(std::deque<TextureJob>& jobs){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_outstanding -= m_decoded.size();
+        while(!m_decoded.empty()){
+            jobs.push_back(std::move(m_decoded.front()));
+            m_decoded.pop_front();
+        }
+        return m_outstanding == 0 && jobs.empty();
+    }
+
+    // Number of jobs submitted but not yet handed to the OpenGL thread
+    unsigned int GetOutstanding(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_outstanding;
+    }
+
+private:
+    void Work(){
+        while(true){
+            TextureJob job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this](){ return m_stopping || !m_waiting.empty(); });
+                if(m_stopping){
+                    return;
+                }
+                job = std::move(m_waiting.front());
+                m_waiting.pop_front();
+            }
+            // No one wants this texture anymore, so skip the decode.
+            // An image that fails to load is still handed back, empty, so
+            // the OpenGL thread can report it and keep the placeholder.
+            if(!job.texture.expired()){
+                job.image = new Image(job.filepath);
+                // The blocks come from the cache too, once they were made
+                TextureCache::LoadImage(job.filepath, *job.image, job.mipmaps ? &job.mips : nullptr,
+                                        &job.compressed, job.compression);
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_decoded.push_back(std::move(job));
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<TextureJob> m_waiting;
+    std::deque<TextureJob> m_decoded;
+    unsigned int m_outstanding{0};
+    bool m_stopping{false};
+};
+
+// The pool is only created the first time a texture is loaded
+static TextureWorkerPool& GetPool(){
+    static TextureWorkerPool pool;
+    return pool;
+}
+
+// Everything below is only touched on the OpenGL thread
+static std::deque<TextureJob> s_uploads;
+static unsigned int s_texturesStreamed = 0;
+static size_t s_bytesStreamed = 0;
+static double s_longestUploadMs = 0.0;
+static double s_longestFrameMs = 0.0;
+static bool s_streaming = false;
+static std::chrono::steady_clock::time_point s_lastUpdate;
+
+void TextureLoader::Submit(std::weak_ptr<Texture> texture, const std::string& filepath, bool mipmaps, BlockFormat compression){
+    TextureJob job;
+    job.texture = texture;
+    job.filepath = filepath;
+    job.mipmaps = mipmaps;
+    job.compression = compression;
+    GetPool().Submit(std::move(job));
+}
+
+void TextureLoader::Update(size_t byteBudget){
+    auto start = std::chrono::steady_clock::now();
+    if(GetPool().TakeDecoded(s_uploads)){
+        if(s_streaming){
+            s_streaming = false;
+            PrintStatistics();
+            // Nothing is loading, so the spare image buffers can go
+            BufferPool::PrintStatistics();
+            BufferPool::Trim();
+        }
+        s_lastUpdate = start;
+        return;
+    }
+    // Time since the last call is the length of the previous frame
+    if(s_streaming){
+        double frameMs = std::chrono::duration<double, std::milli>(start - s_lastUpdate).count();
+        s_longestFrameMs = std::max(s_longestFrameMs, frameMs);
+    }
+    s_streaming = true;
+
+    size_t budget = byteBudget;
+    while(budget > 0 && !s_uploads.empty()){
+        TextureJob& job = s_uploads.front();
+        std::shared_ptr<Texture> texture = job.texture.lock();
+        if(texture == nullptr){
+            // Deleted while it was loading
+            delete job.image;
+            s_uploads.pop_front();
+            continue;
+        }
+        if(job.image != nullptr){
+            // The texture now owns the image
+            Image* image = job.image;
+            job.image = nullptr;
+            if(!texture->BeginUpload(image, std::move(job.mips), std::move(job.compressed))){
+                s_uploads.pop_front();
+                continue;
+            }
+        }
+        size_t uploaded = texture->UploadRows(budget);
+        s_bytesStreamed += uploaded;
+        budget -= std::min(budget, uploaded);
+        if(texture->IsReady()){
+            ++s_texturesStreamed;
+            s_uploads.pop_front();
+        }
+    }
+
+    s_lastUpdate = std::chrono::steady_clock::now();
+    double uploadMs = std::chrono::duration<double, std::milli>(s_lastUpdate - start).count();
+    s_longestUploadMs = std::max(s_longestUploadMs, uploadMs);
+}
+
+bool TextureLoader::IsBusy(){
+    return !s_uploads.empty() || GetPool().GetOutstanding() > 0;
+}
+
+void TextureLoader::PrintStatistics(){
+    std::cout << "Texture streaming: " << s_texturesStreamed << " textures, "
+              << s_bytesStreamed/(1024.0*1024.0) << " MB uploaded, longest upload "
+              << s_longestUploadMs << " ms, longest frame while streaming "
+              << s_longestFrameMs << " ms" << std::endl;
+}
@@ -4,6 +4,11 @@
 
 // Functionality that we created
 #include "SDLGraphicsProgram.hpp"
+#include "Convolution.hpp"
+#include "Image.hpp"
+
+#include <iostream>
+#include <string>
 
 
 // The main application loop
@@ -15,10 +20,43 @@ void preloop(){
 
 }
 
+// Runs the kernel from shaders/fboFrag.glsl over every image named on
+// the command line on the CPU, without opening a window, e.g.
+// ./prog --filter ./assets/textures/colormap.ppm ./assets/textures/detailmap.ppm
+// writes colormap_filtered.ppm and detailmap_filtered.ppm next to them.
+// PPM rows are stored top row first, the opposite of OpenGL, which only
+// matters for kernels that are not symmetric top to bottom.
+int filterImages(int argc, char** argv){
+    int failed = 0;
+    for(int i=2; i < argc; ++i){
+        std::string input = argv[i];
+        Image image(input);
+        if(!image.LoadPPM(false)){
+            ++failed;
+            continue;
+        }
+        Convolve(image, ConvolutionKernel::Laplacian(),
+                 ConvolutionSettings::MatchShader(image.GetWidth(), image.GetHeight()));
+        size_t extension = input.rfind(".ppm");
+        std::string output = input.substr(0, extension) + "_filtered.ppm";
+        if(!image.SavePPM(output, true)){
+            ++failed;
+            continue;
+        }
+        std::cout << "Filtered " << input << " into " << output << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
+
 // The setup
 
 int main(int argc, char** argv){
 
+	// Filter images on the CPU instead of opening a window
+	if(argc > 1 && std::string(argv[1]) == "--filter"){
+		return filterImages(argc, argv);
+	}
+
 	// Create an instance of an object for a SDLGraphicsProgram
 	SDLGraphicsProgram mySDLGraphicsProgram(1280,720);
 	// Run our program forever
@@ -0,0 +1,542 @@
+/** @file ImageBenchmark.cpp
+ *  @brief Times every way we have of reading and writing a PPM.
+ *
+ *  Every .ppm in common/textures is run through:
+ *
+ *      Image::LoadPPM          with and without flipping the rows
+ *      PPM::PPM                the loader from assignment 1
+ *      PPM::savePPM            as P3 and as P6
+ *      Texture::LoadTexture    with and without an up to date .texcache,
+ *                              if an OpenGL context can be created
+ *
+ *  Loaders are timed twice: once with the file already in the page
+ *  cache (warm), and once after asking the OS to drop it (cold), so the
+ *  numbers show both the parsing cost and the cost of the disk.
+ *  Dropping a file uses posix_fadvise, which is only available on Linux;
+ *  elsewhere the cold runs are skipped.
+ *
+ *  Each case is run a few times and the fastest run is reported, along
+ *  with MB/s (of the .ppm file), pixels/s, and the peak resident memory
+ *  while the case ran. Results are written as JSON (results.json by
+ *  default) and a short table is printed at the end.
+ *
+ *  Run from the bench directory so the default paths resolve:
+ *
+ *      python3 build.py && ./bench
+ *
+ *  With no display, SDL can still create a context with
+ *  SDL_VIDEODRIVER=offscreen (or run under xvfb-run); otherwise the
+ *  texture cases are reported as skipped.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // This works for Mac
+    #include <SDL.h>
+#endif
+
+#include <glad/glad.h>
+
+#include "Image.hpp"
+#include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "BufferPool.hpp"
+#include "MappedFile.hpp"
+#include "PPMFormat.hpp"
+#include "PPM.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(LINUX) || defined(MAC)
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Command line options
+struct BenchmarkSettings{
+    std::string textureDirectory{"./../../../common/textures"};
+    std::string outputPath{"results.json"};
+    unsigned int iterations{3};
+    bool useGL{true};
+    bool cold{true};
+};
+
+// A .ppm that will be timed
+struct BenchmarkAsset{
+    std::string path;
+    std::string name;
+    uint64_t bytes{0};
+    int width{0};
+    int height{0};
+    bool binary{false};
+};
+
+// The timing of one operation on one asset
+struct BenchmarkResult{
+    std::string operation;
+    std::string asset;
+    std::string cache;          // "warm" or "cold"
+    uint64_t bytes{0};
+    uint64_t pixels{0};
+    double bestSeconds{0};
+    double meanSeconds{0};
+    double residentAtStart{1};  // Fraction of the file in the page cache
+    uint64_t peakRSS{0};        // Bytes
+    std::string skipped;        // Why the case did not run, if it did not
+};
+
+// One operation to time. run does the work for a single asset;
+// readsSource is false for operations whose speed does not depend
+// on the page cache (they are only timed warm).
+struct BenchmarkCase{
+    std::string operation;
+    bool readsSource;
+    std::function<void(const BenchmarkAsset&)> run;
+    std::function<std::string()> skipReason;
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Reads one byte of every page. A P6 loaded without a flip is only
+// mapped, not read, so without this its load time would not include
+// getting the pixels off the disk at all.
+static uint64_t TouchPages(const uint8_t* data, size_t size){
+    uint64_t sum = 0;
+    for(size_t i = 0; i < size; i += 4096){
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Asks the OS to drop filepath from the page cache.
+// Returns false if that is not supported here.
+static bool EvictFromPageCache(const std::string& filepath){
+#if defined(LINUX)
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+    // Only clean pages are dropped, so flush anything we wrote first
+    fdatasync(fd);
+    int result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return result == 0;
+#else
+    (void)filepath;
+    return false;
+#endif
+}
+
+// Fraction (0 to 1) of filepath that is in the page cache right now,
+// or -1 if we can not tell. Used to check the cold runs really were cold.
+static double GetResidentFraction(const std::string& filepath){
+#if defined(LINUX) || defined(MAC)
+    // Mapped by hand, since MappedFile asks the OS to read ahead
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0){
+        return -1;
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    void* address = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(address == MAP_FAILED){
+        return -1;
+    }
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t pages = (static_cast<size_t>(size) + pageSize - 1) / pageSize;
+#if defined(MAC)
+    std::vector<char> residency(pages);
+#else
+    std::vector<unsigned char> residency(pages);
+#endif
+    int result = mincore(address, size, residency.data());
+    munmap(address, size);
+    if(result != 0){
+        return -1;
+    }
+    size_t resident = std::count_if(residency.begin(), residency.end(), [](unsigned char page){ return (page & 1) != 0; });
+    return static_cast<double>(resident) / pages;
+#else
+    (void)filepath;
+    return -1;
+#endif
+}
+
+// Starts measuring the peak resident memory over again (Linux only).
+// Memory parked in the BufferPool is let go first so one case does not
+// count the buffers left behind by the last.
+static void ResetPeakRSS(){
+    BufferPool::Trim();
+#if defined(LINUX)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+// Peak resident memory in bytes since the last ResetPeakRSS() (Linux),
+// or since the program started (Mac). 0 if unknown.
+static uint64_t GetPeakRSS(){
+#if defined(LINUX)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)){
+        if(line.compare(0, 6, "VmHWM:") == 0){
+            return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+    }
+    return 0;
+#elif defined(MAC)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return 0;
+#endif
+}
+
+// Finds every .ppm we can parse the header of, sorted by name
+static std::vector<BenchmarkAsset> FindAssets(const std::string& directory){
+    std::vector<BenchmarkAsset> assets;
+    std::error_code error;
+    for(const fs::directory_entry& entry : fs::directory_iterator(directory, error)){
+        if(!entry.is_regular_file() || entry.path().extension() != ".ppm"){
+            continue;
+        }
+        BenchmarkAsset asset;
+        asset.path = entry.path().string();
+        asset.name = entry.path().filename().string();
+        MappedFile file;
+        PPMHeader header;
+        if(!file.Open(asset.path) || !ParsePPMHeader(file.GetData(), file.GetSize(), header)){
+            std::cerr << "Skipping " << asset.path << std::endl;
+            continue;
+        }
+        asset.bytes = file.GetSize();
+        asset.width = header.width;
+        asset.height = header.height;
+        asset.binary = header.binary;
+        assets.push_back(asset);
+    }
+    std::sort(assets.begin(), assets.end(), [](const BenchmarkAsset& a, const BenchmarkAsset& b){ return a.name < b.name; });
+    return assets;
+}
+
+// Creates a hidden window and OpenGL context for the texture cases.
+// Returns an empty string on success, or why it failed.
+static std::string CreateGLContext(SDL_Window*& window, SDL_GLContext& context){
+    if(SDL_Init(SDL_INIT_VIDEO) < 0){
+        return std::string("SDL could not initialize: ") + SDL_GetError();
+    }
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    window = SDL_CreateWindow("bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 64, 64,
+                              SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    if(window == nullptr){
+        return std::string("Window could not be created: ") + SDL_GetError();
+    }
+    context = SDL_GL_CreateContext(window);
+    if(context == nullptr){
+        return std::string("OpenGL context could not be created: ") + SDL_GetError();
+    }
+    if(!gladLoadGLLoader(SDL_GL_GetProcAddress)){
+        return "Failed to initialize GLAD";
+    }
+    return "";
+}
+
+// Runs one case on one asset, warm or cold
+static BenchmarkResult RunCase(const BenchmarkCase& benchmarkCase, const BenchmarkAsset& asset,
+                               bool cold, const BenchmarkSettings& settings){
+    BenchmarkResult result;
+    result.operation = benchmarkCase.operation;
+    result.asset = asset.name;
+    result.cache = cold ? "cold" : "warm";
+    result.bytes = asset.bytes;
+    result.pixels = static_cast<uint64_t>(asset.width) * asset.height;
+    result.skipped = benchmarkCase.skipReason ? benchmarkCase.skipReason() : "";
+    if(!result.skipped.empty()){
+        return result;
+    }
+    // The first (untimed) run warms the page cache, the allocator, and
+    // for textures writes the .texcache file.
+    benchmarkCase.run(asset);
+    double total = 0;
+    result.bestSeconds = 1e30;
+    ResetPeakRSS();
+    for(unsigned int i = 0; i < settings.iterations; ++i){
+        if(cold){
+            EvictFromPageCache(asset.path);
+            EvictFromPageCache(TextureCache::GetCachePath(asset.path));
+        }
+        if(i == 0){
+            result.residentAtStart = GetResidentFraction(asset.path);
+        }
+        auto start = std::chrono::steady_clock::now();
+        benchmarkCase.run(asset);
+        double seconds = SecondsSince(start);
+        total += seconds;
+        result.bestSeconds = std::min(result.bestSeconds, seconds);
+    }
+    result.meanSeconds = total / settings.iterations;
+    result.peakRSS = GetPeakRSS();
+    return result;
+}
+
+// Escapes the characters JSON does not allow inside a string
+static std::string JSONString(const std::string& text){
+    std::string escaped = "\"";
+    for(char c : text){
+        if(c == '"' || c == '\\'){
+            escaped += '\\';
+            escaped += c;
+        }else if(static_cast<unsigned char>(c) < 0x20){
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }else{
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+static void WriteJSON(std::ostream& out, const BenchmarkSettings& settings, bool coldSupported,
+                      const std::string& glStatus, const std::vector<BenchmarkResult>& results){
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"iterations\": " << settings.iterations << ",\n";
+    out << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"coldCacheSupported\": " << (coldSupported ? "true" : "false") << ",\n";
+    out << "  \"glContext\": " << (glStatus.empty() ? "true" : "false") << ",\n";
+    if(!glStatus.empty()){
+        out << "  \"glContextError\": " << JSONString(glStatus) << ",\n";
+    }
+    out << "  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); ++i){
+        const BenchmarkResult& result = results[i];
+        out << "    {\"operation\": " << JSONString(result.operation)
+            << ", \"asset\": " << JSONString(result.asset)
+            << ", \"cache\": " << JSONString(result.cache)
+            << ", \"bytes\": " << result.bytes
+            << ", \"pixels\": " << result.pixels;
+        if(!result.skipped.empty()){
+            out << ", \"skipped\": " << JSONString(result.skipped);
+        }else{
+            out << ", \"bestMs\": " << result.bestSeconds * 1000
+                << ", \"meanMs\": " << result.meanSeconds * 1000
+                << ", \"MBPerSecond\": " << result.bytes / 1048576.0 / result.bestSeconds
+                << ", \"pixelsPerSecond\": " << result.pixels / result.bestSeconds
+                << ", \"residentAtStart\": " << result.residentAtStart
+                << ", \"peakRSSBytes\": " << result.peakRSS;
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+    // Totals over every asset, for a quick before and after comparison
+    std::map<std::string, BenchmarkResult> totals;
+    for(const BenchmarkResult& result : results){
+        if(!result.skipped.empty()){
+            continue;
+        }
+        BenchmarkResult& total = totals[result.operation + "|" + result.cache];
+        total.operation = result.operation;
+        total.cache = result.cache;
+        total.bytes += result.bytes;
+        total.pixels += result.pixels;
+        total.bestSeconds += result.bestSeconds;
+        total.peakRSS = std::max(total.peakRSS, result.peakRSS);
+    }
+    out << "  \"totals\": [\n";
+    size_t written = 0;
+    for(const auto& entry : totals){
+        const BenchmarkResult& total = entry.second;
+        out << "    {\"operation\": " << JSONString(total.operation)
+            << ", \"cache\": " << JSONString(total.cache)
+            << ", \"bytes\": " << total.bytes
+            << ", \"totalMs\": " << total.bestSeconds * 1000
+            << ", \"MBPerSecond\": " << total.bytes / 1048576.0 / total.bestSeconds
+            << ", \"pixelsPerSecond\": " << total.pixels / total.bestSeconds
+            << ", \"peakRSSBytes\": " << total.peakRSS
+            << "}" << (++written < totals.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+    out << "  \"processPeakRSSBytes\": " << GetPeakRSS() << "\n";
+    out << "}\n";
+}
+
+// Prints the totals as a table
+static void PrintSummary(const std::vector<BenchmarkResult>& results){
+    std::map<std::string, std::pair<uint64_t, double>> totals;
+    std::vector<std::string> order;
+    for(const BenchmarkResult& result : results){
+        std::string key = result.operation + " (" + result.cache + ")";
+        if(!result.skipped.empty()){
+            continue;
+        }
+        if(totals.find(key) == totals.end()){
+            order.push_back(key);
+        }
+        totals[key].first += result.bytes;
+        totals[key].second += result.bestSeconds;
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    for(const std::string& key : order){
+        std::cout << std::left << std::setw(48) << key << std::right
+                  << std::setw(10) << totals[key].second * 1000 << " ms"
+                  << std::setw(10) << totals[key].first / 1048576.0 / totals[key].second << " MB/s" << std::endl;
+    }
+}
+
+static void PrintUsage(){
+    std::cout << "Usage: ./bench [--textures directory] [--output results.json]" << std::endl;
+    std::cout << "               [--iterations count] [--no-gl] [--no-cold]" << std::endl;
+}
+
+static bool ParseArguments(int argc, char* argv[], BenchmarkSettings& settings){
+    for(int i = 1; i < argc; ++i){
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(argument == "--textures" && hasValue){
+            settings.textureDirectory = argv[++i];
+        }else if(argument == "--output" && hasValue){
+            settings.outputPath = argv[++i];
+        }else if(argument == "--iterations" && hasValue){
+            settings.iterations = std::max(1, std::atoi(argv[++i]));
+        }else if(argument == "--no-gl"){
+            settings.useGL = false;
+        }else if(argument == "--no-cold"){
+            settings.cold = false;
+        }else{
+            PrintUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    BenchmarkSettings settings;
+    if(!ParseArguments(argc, argv, settings)){
+        return 1;
+    }
+    std::vector<BenchmarkAsset> assets = FindAssets(settings.textureDirectory);
+    if(assets.empty()){
+        std::cout << "No .ppm files found in " << settings.textureDirectory << std::endl;
+        return 1;
+    }
+
+    SDL_Window* window = nullptr;
+    SDL_GLContext context = nullptr;
+    std::string glStatus = settings.useGL ? CreateGLContext(window, context) : "disabled with --no-gl";
+    if(!glStatus.empty()){
+        std::cout << "Texture cases skipped: " << glStatus << std::endl;
+    }
+
+    // Saved files go to a scratch file that is removed at the end
+    std::string scratchPath = (fs::temp_directory_path() / "image_benchmark.ppm").string();
+    // .texcache files we create are removed again at the end, so the
+    // benchmark leaves the textures directory the way it found it.
+    std::vector<std::string> createdCacheFiles;
+    for(const BenchmarkAsset& asset : assets){
+        if(!fs::exists(TextureCache::GetCachePath(asset.path))){
+            createdCacheFiles.push_back(TextureCache::GetCachePath(asset.path));
+        }
+    }
+    // Loaded PPMs are kept here while their file is saved
+    std::map<std::string, std::unique_ptr<PPM>> loaded;
+    auto getLoaded = [&loaded](const BenchmarkAsset& asset) -> PPM& {
+        if(loaded.find(asset.path) == loaded.end()){
+            loaded.clear();
+            loaded[asset.path].reset(new PPM(asset.path));
+        }
+        return *loaded[asset.path];
+    };
+    auto glSkip = [&glStatus](){ return glStatus; };
+    auto loadImage = [](const BenchmarkAsset& asset, bool flip){
+        Image image(asset.path);
+        image.LoadPPM(flip);
+        if(image.GetPixelDataPtr() != nullptr){
+            TouchPages(image.GetPixelDataPtr(), static_cast<size_t>(image.GetWidth()) * image.GetHeight() * 3);
+        }
+    };
+    auto loadTexture = [](const BenchmarkAsset& asset, bool cached){
+        if(!cached){
+            std::remove(TextureCache::GetCachePath(asset.path).c_str());
+        }
+        std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+        texture->LoadTexture(asset.path);
+        // Wait for the driver to really have the pixels
+        glFinish();
+    };
+
+    std::vector<BenchmarkCase> cases = {
+        {"Image::LoadPPM (flip)", true, [&](const BenchmarkAsset& asset){ loadImage(asset, true); }, nullptr},
+        {"Image::LoadPPM (no flip)", true, [&](const BenchmarkAsset& asset){ loadImage(asset, false); }, nullptr},
+        {"PPM::PPM", true, [](const BenchmarkAsset& asset){ PPM ppm(asset.path); }, nullptr},
+        {"PPM::savePPM (P3)", false, [&](const BenchmarkAsset& asset){ getLoaded(asset).savePPM(scratchPath, false); }, nullptr},
+        {"PPM::savePPM (P6)", false, [&](const BenchmarkAsset& asset){ getLoaded(asset).savePPM(scratchPath, true); }, nullptr},
+        {"Texture::LoadTexture (no .texcache)", true, [&](const BenchmarkAsset& asset){ loadTexture(asset, false); }, glSkip},
+        {"Texture::LoadTexture (.texcache)", true, [&](const BenchmarkAsset& asset){ loadTexture(asset, true); }, glSkip},
+    };
+
+    bool coldSupported = settings.cold && EvictFromPageCache(assets[0].path);
+    std::vector<BenchmarkResult> results;
+    for(const BenchmarkCase& benchmarkCase : cases){
+        for(int cold = 0; cold <= 1; ++cold){
+            if(cold && (!coldSupported || !benchmarkCase.readsSource)){
+                continue;
+            }
+            for(const BenchmarkAsset& asset : assets){
+                std::cerr << benchmarkCase.operation << (cold ? " cold: " : " warm: ") << asset.name << std::endl;
+                results.push_back(RunCase(benchmarkCase, asset, cold != 0, settings));
+            }
+        }
+    }
+    loaded.clear();
+    std::remove(scratchPath.c_str());
+    for(const std::string& cachePath : createdCacheFiles){
+        std::remove(cachePath.c_str());
+    }
+
+    std::ofstream outFile(settings.outputPath.c_str());
+    if(!outFile.is_open()){
+        std::cout << "Unable to write " << settings.outputPath << std::endl;
+        return 1;
+    }
+    WriteJSON(outFile, settings, coldSupported, glStatus, results);
+    PrintSummary(results);
+    std::cout << "Results written to " << settings.outputPath << std::endl;
+
+    if(context != nullptr){
+        SDL_GL_DeleteContext(context);
+    }
+    if(window != nullptr){
+        SDL_DestroyWindow(window);
+    }
+    SDL_Quit();
+    return 0;
+}
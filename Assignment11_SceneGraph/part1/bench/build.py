@@ -0,0 +1,59 @@
+# Run with: python3 build.py
+# Then run from this directory with: ./bench
+# (or ./bench --help for the options)
+import os
+import glob
+import platform
+
+# (1)==================== COMMON CONFIGURATION OPTIONS ======================= #
+# Unlike the main program we optimize, since we want to time the real thing.
+COMPILER="g++ -O2 -g -std=c++17"   # The compiler we want to use 
+                                    #(You may try g++ if you have trouble)
+# Every source file of the project except its main(), plus the PPM
+# class from assignment 1 so both loaders can be timed side by side.
+PPM_DIR="./../../../Assignment01_CPlusPlus_and_Debugging/part3"
+SOURCE=" ".join(sorted(f for f in glob.glob("./../src/*.cpp") if os.path.basename(f)!="main.cpp"))
+SOURCE+=" "+PPM_DIR+"/src/ppm.cpp "+PPM_DIR+"/src/PixelPipeline.cpp ./*.cpp"
+EXECUTABLE="bench"       # Name of the final executable
+# ======================= COMMON CONFIGURATION OPTIONS ======================= #
+
+# (2)=================== Platform specific configuration ===================== #
+# For each platform we need to set the following items
+ARGUMENTS=""            # Arguments needed for our program (Add others as you see fit)
+INCLUDE_DIR=""          # Which directories do we want to include.
+LIBRARIES=""            # What libraries do we want to include
+
+# Note: ./../include/ comes first, since both projects have their own
+#       (identical) copies of PPMFormat.hpp and MappedFile.hpp.
+if platform.system()=="Linux":
+    ARGUMENTS="-D LINUX" # -D is a #define sent to preprocessor
+    INCLUDE_DIR="-I ./../include/ -I "+PPM_DIR+"/include/ -I ./../../../common/thirdparty/glm/"
+    LIBRARIES="-lSDL2 -ldl -pthread"
+elif platform.system()=="Darwin":
+    ARGUMENTS="-D MAC" # -D is a #define sent to the preprocessor.
+    INCLUDE_DIR="-I ./../include/ -I "+PPM_DIR+"/include/ -I/Library/Frameworks/SDL2.framework/Headers -I./../../../common/thirdparty/old/glm"
+    LIBRARIES="-F/Library/Frameworks -framework SDL2"
+elif platform.system()=="Windows":
+    ARGUMENTS="-D MINGW -static-libgcc -static-libstdc++" 
+    INCLUDE_DIR="-I./../include/ -I"+PPM_DIR+"/include/ -I./../../../common/thirdparty/old/glm/"
+    EXECUTABLE="bench.exe"
+    LIBRARIES="-lmingw32 -lSDL2main -lSDL2"
+# (2)=================== Platform specific configuration ===================== #
+
+# (3)====================== Building the Executable ========================== #
+# Build a string of our compile commands that we run in the terminal
+compileString=COMPILER+" "+ARGUMENTS+" "+SOURCE+" -o "+EXECUTABLE+" "+" "+INCLUDE_DIR+" "+LIBRARIES
+# Print out the compile string
+# This is the command you can type
+print("============v (Command running on terminal) v===========================")
+print("Compilng on: "+platform.system())
+print(compileString)
+print("========================================================================")
+# Run our command 
+# Here I am using an exit_code so you can
+# also compile & run in one step as
+# python3 build.py && ./bench
+# If compilation fails, ./bench will not run.
+exit_code = os.system(compileString)
+exit(0 if exit_code==0 else 1)
+# ========================= Building the Executable ========================== #
@@ -0,0 +1,98 @@
+/** @file BlockCompression.hpp
+ *  @brief Compresses RGB(A) pixels into BC1 or BC3 (S3TC) blocks.
+ *
+ *  Both formats split the image into 4x4 blocks of pixels. Each block
+ *  stores two colors and a 2 bit index per pixel that picks one of four
+ *  colors blended from those two. BC1 uses 8 bytes per block (6:1 over
+ *  RGB), BC3 adds 8 more bytes of alpha per block.
+ *  See https://www.khronos.org/opengl/wiki/S3_Texture_Compression
+ *
+ *  Everything here runs on the CPU only, so images can be compressed
+ *  ahead of time (the TextureCache keeps the blocks between runs) and a
+ *  round trip can be checked without a GPU by comparing the expanded
+ *  blocks with the original using CompareImages.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef BLOCK_COMPRESSION_HPP
+#define BLOCK_COMPRESSION_HPP
+
+#include "MipChain.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class BlockFormat{
+    None,
+    BC1,    // RGB, 8 bytes per 4x4 block
+    BC3     // RGBA, 16 bytes per 4x4 block
+};
+
+// Bytes taken by one 4x4 block
+size_t GetBlockSize(BlockFormat format);
+// Bytes taken by a width x height image once compressed
+size_t GetCompressedSize(BlockFormat format, int width, int height);
+
+// Compresses a width x height image with channels (3 or 4) bytes per
+// pixel into out, which must hold GetCompressedSize bytes. Images with
+// sizes that are not a multiple of 4 repeat their last row and column.
+// Rows of blocks are split across threads; threadCount of 0 uses one
+// thread per hardware core.
+void CompressBlocks(const uint8_t* pixels, int width, int height, int channels,
+                    BlockFormat format, uint8_t* out, unsigned int threadCount=0);
+
+// Expands blocks back into width x height pixels with channels (3 or 4)
+// bytes per pixel.
+void DecompressBlocks(const uint8_t* blocks, int width, int height,
+                      BlockFormat format, uint8_t* out, int channels);
+
+// An image and all of its mipmap levels in compressed form
+class CompressedChain{
+public:
+    // Compresses the RGB image and every level of mips
+    void Compress(const uint8_t* pixels, int width, int height, const MipChain* mips,
+                  BlockFormat format, unsigned int threadCount=0);
+    // Uses levels that were compressed before (e.g. read from a cache).
+    // data holds levelCount levels of a width x height image back to back,
+    // each half the size of the one before, like a MipChain. Returns false
+    // (and holds nothing) if size is too small for them.
+    bool Assign(const uint8_t* data, size_t size, BlockFormat format, int width, int height,
+                unsigned int levelCount);
+    // Forgets all levels
+    void Clear();
+    inline BlockFormat GetFormat() const{
+        return m_format;
+    }
+    // Number of levels including the full size image (level 0)
+    inline unsigned int GetLevelCount() const{
+        return m_levels.size();
+    }
+    int GetWidth(unsigned int level) const;
+    int GetHeight(unsigned int level) const;
+    const uint8_t* GetLevelData(unsigned int level) const;
+    size_t GetLevelSize(unsigned int level) const;
+    // All levels back to back
+    inline const uint8_t* GetDataPtr() const{
+        return m_data.data();
+    }
+    inline size_t GetDataSize() const{
+        return m_data.size();
+    }
+private:
+    // Fills in m_levels and returns the bytes they take
+    size_t LayoutLevels(int width, int height, const MipChain* mips, unsigned int levelCount);
+
+    struct Level{
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+    BlockFormat m_format{BlockFormat::None};
+    std::vector<Level> m_levels;
+    std::vector<uint8_t> m_data;
+};
+
+#endif
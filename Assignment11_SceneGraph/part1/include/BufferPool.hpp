@@ -0,0 +1,40 @@
+/** @file BufferPool.hpp
+ *  @brief Reuses the large buffers images decode their pixels into.
+ *
+ *  Every image that is decoded (rather than mapped straight from a file)
+ *  needs a buffer of several MB. Allocating and freeing one per load
+ *  makes the allocator return the memory to the system and fault it back
+ *  in page by page on the next load. Freed buffers are instead kept in
+ *  buckets by size, and the next request for a similar size takes one.
+ *
+ *  Bucket sizes go up in steps of an eighth of a power of two, so a
+ *  buffer is at most 12.5% larger than asked for. At most 64 MB of free
+ *  buffers are kept; Trim() frees them all, e.g. once loading is done.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+class BufferPool{
+public:
+    // Returns a buffer of at least size bytes. Safe to call from any thread.
+    static uint8_t* Acquire(size_t size);
+    // Gives back a buffer returned by Acquire(size)
+    static void Release(uint8_t* buffer, size_t size);
+    // Frees every buffer in the pool
+    static void Trim();
+    // Bytes of free buffers held in the pool
+    static size_t GetPooledBytes();
+    // Prints how many requests were served from the pool
+    static void PrintStatistics();
+private:
+    // Size of the bucket that serves a request of size bytes
+    static size_t GetBucketSize(size_t size);
+};
+
+#endif
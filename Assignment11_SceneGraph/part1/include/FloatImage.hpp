@@ -0,0 +1,89 @@
+/** @file FloatImage.hpp
+ *  @brief Images with floating point (or half float) color values.
+ *
+ *  Image holds 8 bit sRGB values, which are fine for display but not for
+ *  math: sRGB is not linear, so averaging or blending the stored values
+ *  gives colors that are too dark, and 8 bits lose precision every time
+ *  a result is rounded. A FloatImage holds linear values from 0 to 1 as
+ *  32 bit floats, so filters can work on them directly and round only
+ *  once when converting back to sRGB.
+ *
+ *  Decoding sRGB uses a 256 entry table. Encoding uses a fit made of
+ *  square roots (SSE2 has a vector square root), which matches the exact
+ *  sRGB curve to within one 8 bit step. Half floats (the 16 bit format
+ *  GPUs use for HDR textures) use the F16C instructions when the CPU has
+ *  them.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef FLOAT_IMAGE_HPP
+#define FLOAT_IMAGE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class FloatImage{
+public:
+    // Constructor for an empty image
+    FloatImage();
+    // Constructor for a width x height image with every value 0
+    FloatImage(int width, int height, int channels=3);
+    // Resizes the image. The values are not cleared.
+    void Allocate(int width, int height, int channels=3);
+    // Fills the image with the linear values of 8 bit sRGB pixels.
+    // threadCount of 0 uses one thread per hardware core.
+    void DecodeSRGB(const uint8_t* pixels, int width, int height, int channels=3, unsigned int threadCount=0);
+    // Writes the values as 8 bit sRGB pixels into out, which must hold
+    // width*height*channels bytes. Values are clamped to 0-1 first.
+    void EncodeSRGB(uint8_t* out, unsigned int threadCount=0) const;
+    // Fills the image from half floats
+    void LoadHalf(const uint16_t* values, int width, int height, int channels=3);
+    // Writes the values as half floats into out
+    void StoreHalf(uint16_t* out) const;
+    // Dimensions of the image
+    inline int GetWidth() const{
+        return m_width;
+    }
+    inline int GetHeight() const{
+        return m_height;
+    }
+    // Number of interleaved values per pixel
+    inline int GetChannels() const{
+        return m_channels;
+    }
+    // Number of values (width*height*channels)
+    inline size_t GetValueCount() const{
+        return m_data.size();
+    }
+    // Retrieve raw array of values, row by row
+    inline float* GetDataPtr(){
+        return m_data.data();
+    }
+    inline const float* GetDataPtr() const{
+        return m_data.data();
+    }
+    // Returns the values of row y
+    inline float* GetRow(int y){
+        return m_data.data() + (size_t)y*m_width*m_channels;
+    }
+    inline const float* GetRow(int y) const{
+        return m_data.data() + (size_t)y*m_width*m_channels;
+    }
+private:
+    int m_width{0};
+    int m_height{0};
+    int m_channels{0};
+    std::vector<float> m_data;
+};
+
+// Converts count 8 bit sRGB values to linear values from 0 to 1
+void SRGBToLinear(const uint8_t* in, float* out, size_t count);
+// Converts count linear values to 8 bit sRGB, clamping to 0-1 first
+void LinearToSRGB(const float* in, uint8_t* out, size_t count);
+// Converts between floats and half floats, rounding to nearest even
+void FloatToHalf(const float* in, uint16_t* out, size_t count);
+void HalfToFloat(const uint16_t* in, float* out, size_t count);
+
+#endif
@@ -28,6 +28,11 @@ public:
 	float* GetBufferDataPtr();
 	// Add a new vertex 
 	void AddVertex(float x, float y, float z, float s, float t);
+	// Moves every texture coordinate into a rectangle of the texture
+	// (e.g. one image of an atlas). Coordinates are clamped to 0-1 first,
+	// as GL_CLAMP_TO_EDGE would, and then become offset + coordinate*scale.
+	// Works before or after Gen().
+	void RemapTextureCoords(float offsetS, float offsetT, float scaleS, float scaleT);
 	// Allows for adding one index at a time manually if 
 	// you know which vertices are needed to make a triangle.
 	void AddIndex(unsigned int i);
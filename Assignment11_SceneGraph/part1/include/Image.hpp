@@ -12,14 +12,34 @@
 #include <string>
 #include <cstdint>
 
+#include "MappedFile.hpp"
+#include "PixelLayout.hpp"
+#include "ImageCompare.hpp"
+
 class Image {
 public:
     // Constructor for creating an image
     Image (std::string filepath);
     // Destructor
     ~Image();
-    // Loads a PPM from memory.
-    void LoadPPM(bool flip);
+    // Loads a PPM (either P3 or P6) from memory.
+    // Returns false (and prints why) if the file can not be read, in
+    // which case the image is left empty.
+    bool LoadPPM(bool flip);
+    // Saves the pixels to a PPM, as P6 if binary is true, otherwise P3.
+    bool SavePPM(std::string filepath, bool binary);
+    // Measures how different our pixels are from other's (see ImageCompare.hpp).
+    // Returns false (and prints why) if the images are not the same size.
+    bool Compare(Image& other, ImageDifference& result, const CompareSettings& settings=CompareSettings());
+    // Writes a heatmap of where our pixels differ from other's as a P6.
+    // scale of 0 makes the largest difference white.
+    bool SaveDifferenceHeatmap(Image& other, std::string filepath, int scale=0);
+    // Uses pixels that live inside an already mapped file (e.g. a cache file)
+    // rather than loading a PPM. The image takes ownership of the mapping.
+    void LoadMappedPixels(MappedFile&& file, size_t dataOffset, int width, int height);
+    // Replaces any pixels with width x height black pixels, e.g. to draw
+    // into rather than load from a file.
+    void Create(int width, int height);
     // Return the width
     inline int GetWidth(){
         return m_width;
@@ -36,25 +56,55 @@ public:
     void SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b);
     // Display the pixels
     void PrintPixels();
-    // Retrieve raw array of pixel data
+    // Retrieve raw array of pixel data, ordered by the current layout
     uint8_t* GetPixelDataPtr();
+    // Reorders the pixels in memory (see PixelLayout.hpp). The accessors
+    // below work the same in every layout. Loading always gives Linear.
+    void SetLayout(PixelLayout layout);
+    // Returns how the pixels are ordered in memory
+    inline PixelLayout GetLayout(){
+        return m_layout;
+    }
+    // Returns the index of the red component of a pixel in the pixel data
+    inline size_t GetPixelOffset(int x, int y){
+        return (m_layout == PixelLayout::Tiled) ? GetTiledPixelOffset(x, y, m_width)
+                                                : GetLinearPixelOffset(x, y, m_width);
+    }
     // Returns the red component of a pixel
     inline unsigned int GetPixelR(int x, int y){
-        return m_pixelData[(x*3)+m_height*(y*3)];
+        return m_pixelData[GetPixelOffset(x, y)];
     }
     // Returns the green component of a pixel
     inline unsigned int GetPixelG(int x, int y){
-        return m_pixelData[(x*3)+m_height*(y*3)+1];
+        return m_pixelData[GetPixelOffset(x, y)+1];
     }
     // Returns the blue component of a pixel
     inline unsigned int GetPixelB(int x, int y){
-        return m_pixelData[(x*3)+m_height*(y*3)+2];
+        return m_pixelData[GetPixelOffset(x, y)+2];
     }
 private:
+    // Decodes the P3 (ASCII) pixel values that follow the header
+    void LoadAsciiPPM(size_t dataOffset);
+    // Points m_pixelData at the binary payload of a P6 file
+    void LoadBinaryPPM(size_t dataOffset, bool flip);
+    // Rotates the image 180 degrees in place
+    void FlipPixels();
+    // Frees (or unmaps) any pixel data we are holding
+    void ReleasePixelData();
+
     // Filepath to the image loaded
     std::string m_filepath;
     // Raw pixel data
-    uint8_t* m_pixelData;
+    uint8_t* m_pixelData{nullptr};
+    // True if m_pixelData came from the BufferPool and must be given back.
+    // False if it points into m_file (a P6 loaded without a copy).
+    bool m_ownsPixelData{false};
+    // Size m_pixelData was acquired with
+    size_t m_pixelDataSize{0};
+    // Order of the pixels in m_pixelData
+    PixelLayout m_layout{PixelLayout::Linear};
+    // Memory mapping of the file on disk
+    MappedFile m_file;
     // Size and format of image
     int m_width{0}; // Width of the image
     int m_height{0}; // Height of the image
@@ -0,0 +1,73 @@
+/** @file ImageCompare.hpp
+ *  @brief Measures how different two images are.
+ *
+ *  Meant for golden image tests: render a frame (or process a texture),
+ *  compare it against a known good copy, and fail if it drifted too far.
+ *  The usual measures are all computed in one call:
+ *
+ *      max / mean absolute difference   per color value, 0 to 255
+ *      PSNR                             in dB, infinite for equal images
+ *      SSIM                             structural similarity, 1 for equal
+ *                                       images, computed on the luminance
+ *
+ *  SSIM follows Wang et al. 2004 but with 8x8 windows placed every 4
+ *  pixels (the same shortcut x264 and ffmpeg take) instead of a Gaussian
+ *  window at every pixel. The sums of 4x4 blocks are found once and every
+ *  window adds up four of them.
+ *
+ *  The differences and the block sums use SSE2 when available, and large
+ *  images are split into bands of rows on separate threads.
+ *
+ *  A heatmap of where the images differ can also be made: black where
+ *  they match, going through blue, red, and yellow to white at the
+ *  largest difference.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef IMAGE_COMPARE_HPP
+#define IMAGE_COMPARE_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Everything CompareImages measures
+struct ImageDifference{
+    // Largest absolute difference of any one color value
+    int maxDifference{0};
+    // Average absolute difference over every color value
+    double meanDifference{0};
+    // Average squared difference over every color value
+    double meanSquaredError{0};
+    // 10*log10(255^2 / meanSquaredError), infinity if the images are equal
+    double psnr{0};
+    // Mean structural similarity of the luminance, 1 if the images are equal
+    double ssim{1};
+};
+
+struct CompareSettings{
+    // SSIM costs about as much as everything else put together, so it
+    // can be skipped when only the simple measures are needed
+    bool computeSSIM{true};
+    // 0 uses one thread per hardware core
+    unsigned int threadCount{0};
+};
+
+// Compares two width x height RGB images.
+void CompareImages(const uint8_t* a, const uint8_t* b, int width, int height,
+                   ImageDifference& result, const CompareSettings& settings=CompareSettings());
+
+// Fills out (width*height*3 bytes) with a heatmap of the largest
+// difference of the three color values at each pixel. A difference of
+// scale or more is drawn white; scale of 0 uses the largest difference
+// found, so even tiny differences show up.
+void MakeDifferenceHeatmap(const uint8_t* a, const uint8_t* b, int width, int height,
+                           uint8_t* out, int scale=0, unsigned int threadCount=0);
+
+// Makes the heatmap above and writes it to a (binary) PPM file.
+// Returns false (and prints why) if the file can not be written.
+bool WriteDifferenceHeatmap(const std::string& filepath, const uint8_t* a, const uint8_t* b,
+                            int width, int height, int scale=0, unsigned int threadCount=0);
+
+#endif
@@ -0,0 +1,126 @@
+/** @file Mesh.hpp
+ *  @brief Triangle meshes loaded from OBJ files, kept in a binary cache.
+ *
+ *  Parsing the text of an OBJ is the slow part of loading a model. The
+ *  first time a model is loaded, the parsed and welded mesh is written
+ *  to a sidecar file next to it (e.g. bunny.obj.mesh) that holds:
+ *
+ *      the vertex layout (stride, and location/size/offset per attribute)
+ *      interleaved vertex data, in the layout of
+ *          VertexBufferLayout::CreateNormalBufferLayout
+ *      the index buffer
+ *      submeshes: ranges of indices drawn with one material, sorted so
+ *          each material's triangles are contiguous
+ *      the material library (MTL file) the OBJ names
+ *      the bounding box
+ *
+ *  On later runs that file is memory mapped and its vertex and index
+ *  data handed straight to OpenGL, so loading costs about as much as
+ *  reading the file.
+ *
+ *  A cache file is only used if its version and vertex layout match
+ *  this code, the size and modification time of the OBJ match what was
+ *  recorded, and the checksum of the whole file, header included, is right.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include "MappedFile.hpp"
+
+#include "glm/vec3.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Range of indices that are drawn with one material
+struct Submesh{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    // Name from 'usemtl', empty if the faces had none
+    char material[64];
+};
+
+class Mesh{
+public:
+    // Number of floats per vertex: x,y,z, nx,ny,nz, s,t, tangent, bitangent
+    static const unsigned int s_stride = 14;
+
+    // Constructor
+    Mesh();
+    // Destructor
+    ~Mesh();
+    // Loads the mesh for an OBJ file from its cache file, or parses the
+    // OBJ and writes the cache file for next time.
+    // Returns false if neither works.
+    bool LoadOBJ(const std::string& filepath);
+    // Frees (or unmaps) the vertex and index data, e.g. once it has been
+    // uploaded. The submeshes and bounds are kept.
+    void ReleaseData();
+    // Returns the interleaved vertex data
+    inline float* GetVertexData() const{
+        return m_vertexData;
+    }
+    // Returns the number of floats of vertex data
+    inline unsigned int GetVertexDataSize() const{
+        return m_vertexCount*s_stride;
+    }
+    inline unsigned int GetVertexCount() const{
+        return m_vertexCount;
+    }
+    // Returns three indices per triangle
+    inline unsigned int* GetIndexData() const{
+        return m_indexData;
+    }
+    inline unsigned int GetIndexCount() const{
+        return m_indexCount;
+    }
+    // One submesh per material, in the order the materials first
+    // appear (faces without a material first)
+    inline const std::vector<Submesh>& GetSubmeshes() const{
+        return m_submeshes;
+    }
+    // Path of the MTL file the OBJ uses, or empty if it names none
+    inline const std::string& GetMaterialLibrary() const{
+        return m_materialLibrary;
+    }
+    // Corners of the box around every vertex
+    inline const glm::vec3& GetBoundsMin() const{
+        return m_boundsMin;
+    }
+    inline const glm::vec3& GetBoundsMax() const{
+        return m_boundsMax;
+    }
+    // Returns the path of the sidecar file used for filepath
+    static std::string GetCachePath(const std::string& filepath);
+
+private:
+    // Maps the cache file for filepath. Returns false on a miss.
+    bool LoadCache(const std::string& filepath);
+    // Writes our data to the cache file for filepath
+    void StoreCache(const std::string& filepath);
+    // Parses the OBJ, welds the corners, and fills in the vertices
+    bool Build(const std::string& filepath);
+
+    // Data mapped from a cache file
+    MappedFile m_file;
+    // Data built from the OBJ when there was no cache file
+    std::vector<float> m_vertices;
+    std::vector<unsigned int> m_indices;
+    // Point into one of the two above
+    float* m_vertexData{nullptr};
+    unsigned int* m_indexData{nullptr};
+    unsigned int m_vertexCount{0};
+    unsigned int m_indexCount{0};
+    std::vector<Submesh> m_submeshes;
+    // As written in the OBJ (relative to it), and relative to us
+    std::string m_materialLibraryName;
+    std::string m_materialLibrary;
+    glm::vec3 m_boundsMin{0.0f};
+    glm::vec3 m_boundsMax{0.0f};
+};
+
+#endif
@@ -0,0 +1,67 @@
+/** @file MipChain.hpp
+ *  @brief Builds the smaller mipmap levels of a texture on the CPU.
+ *
+ *  Every level is half the size of the one above it, down to 1x1. Each
+ *  pixel is the average of a 2x2 box of pixels in the level above.
+ *  Texture colors are stored in sRGB, where averaging the stored values
+ *  directly makes small levels too dark, so the averaging is done on
+ *  linear values and the result converted back to sRGB.
+ *
+ *  Generating the levels ourselves (instead of glGenerateMipmap) gives
+ *  the same result on every driver, and the levels can be kept in the
+ *  texture cache so later runs do not generate them at all.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef MIP_CHAIN_HPP
+#define MIP_CHAIN_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class MipChain{
+public:
+    // Builds every level below an RGB image of width x height.
+    // threadCount of 0 uses one thread per hardware core.
+    void Generate(const uint8_t* pixels, int width, int height, unsigned int threadCount=0);
+    // Uses levels that were generated before (e.g. read from a cache).
+    // data holds every level below a width x height image, back to back.
+    // Returns false if size does not match the dimensions.
+    bool Assign(const uint8_t* data, size_t size, int width, int height);
+    // Forgets all levels
+    void Clear();
+    // Number of levels below the full size image
+    inline unsigned int GetLevelCount() const{
+        return m_levels.size();
+    }
+    // Dimensions and pixels of a level. Level 1 is the half size image,
+    // matching the level numbers OpenGL uses.
+    int GetWidth(unsigned int level) const;
+    int GetHeight(unsigned int level) const;
+    const uint8_t* GetLevelData(unsigned int level) const;
+    size_t GetLevelSize(unsigned int level) const;
+    // All levels back to back
+    inline const uint8_t* GetDataPtr() const{
+        return m_data.data();
+    }
+    inline size_t GetDataSize() const{
+        return m_data.size();
+    }
+    // Total size in bytes of every level below a width x height image
+    static size_t ComputeDataSize(int width, int height);
+private:
+    // Fills in m_levels for a width x height image
+    void LayoutLevels(int width, int height);
+
+    struct Level{
+        int width;
+        int height;
+        size_t offset;
+    };
+    std::vector<Level> m_levels;
+    std::vector<uint8_t> m_data;
+};
+
+#endif
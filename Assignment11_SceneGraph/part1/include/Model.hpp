@@ -0,0 +1,67 @@
+/** @file Model.hpp
+ *  @brief An object whose triangles come from an OBJ file.
+ *
+ *  The mesh is loaded through Mesh, so after the first run the vertex
+ *  and index data are mapped from the .mesh cache file and uploaded
+ *  without being parsed again.
+ *
+ *  Models with materials (an MTL file) are drawn with one draw call per
+ *  material. Each material's diffuse map comes from the TextureRegistry,
+ *  so a map used by several materials or models is loaded once, and the
+ *  draws are ordered by texture so a shared map is only bound once.
+ *  Materials without a diffuse map (or whose map is missing) use the
+ *  model's own texture; a missing map or unknown material is reported
+ *  once per model.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef MODEL_HPP
+#define MODEL_HPP
+
+#include "Object.hpp"
+#include "Mesh.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+class Model : public Object{
+public:
+    // Loads the model in the OBJ file at filepath
+    // Textures of its materials are loaded with settings
+    Model(const std::string& filepath, const TextureSettings& settings = TextureSettings());
+    // Destructor
+    ~Model();
+    // Draws every triangle of the model, one draw per material
+    void Render() override;
+    // Corners of the box around the model
+    inline const glm::vec3& GetBoundsMin() const{
+        return m_mesh.GetBoundsMin();
+    }
+    inline const glm::vec3& GetBoundsMax() const{
+        return m_mesh.GetBoundsMax();
+    }
+    // Number of draw calls a Render() makes
+    inline unsigned int GetDrawCount() const{
+        return m_draws.size();
+    }
+private:
+    // Loads the MTL file of the mesh and makes one draw per submesh
+    void LoadMaterials(const TextureSettings& settings);
+
+    // A range of indices drawn with one texture
+    struct Draw{
+        unsigned int indexOffset;
+        unsigned int indexCount;
+        // nullptr means the model's own texture
+        std::shared_ptr<Texture> texture;
+    };
+
+    Mesh m_mesh;
+    std::vector<Draw> m_draws;
+    // Number of indices uploaded
+    unsigned int m_indexCount{0};
+};
+
+#endif
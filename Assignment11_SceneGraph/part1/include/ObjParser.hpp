@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// One corner of a triangle. Indices are 0-based (already resolved from
+// the 1-based or negative OBJ indices), and -1 when the corner has none.
+struct ObjCorner {
+    int position;
+    int texCoord;
+    int normal;
+};
+
+// Everything we use from an OBJ file. Faces with more than three corners
+// are split into a fan of triangles, so corners holds three per triangle.
+struct ObjData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;
+    // Material of every triangle, an index into materialNames, or -1 for
+    // triangles before the first 'usemtl'
+    std::vector<int> triangleMaterials;
+    // Names from 'usemtl', in the order they first appear
+    std::vector<std::string> materialNames;
+    // Files named by 'mtllib', as written in the OBJ
+    std::vector<std::string> materialLibraries;
+};
+
+// A material from an MTL file
+struct ObjMaterial {
+    std::string name;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+    float shininess = 0.0f;
+    float opacity = 1.0f;
+    // Paths of the texture maps (map_Kd, map_Bump, map_Ks), relative to
+    // the working directory, or empty if the material has none
+    std::string diffuseMap;
+    std::string normalMap;
+    std::string specularMap;
+};
+
+// Parses the OBJ text in [begin, end). The text is scanned in place with
+// pointers, so nothing is allocated per line. Returns false (and prints
+// the line) if a face refers to a vertex that does not exist.
+//
+// Large files are split into pieces at line breaks and parsed in two
+// passes, each piece on its own thread: the first counts the records of
+// every piece, a prefix sum of the counts gives every piece its offset
+// into the arrays, and the second parses every piece straight into place.
+// threadCount of 0 uses one thread per hardware core.
+bool parseOBJ(const char* begin, const char* end, ObjData& data, unsigned int threadCount = 0);
+
+// Memory maps the file at path and parses it with parseOBJ.
+bool loadOBJFile(const std::string& path, ObjData& data, unsigned int threadCount = 0);
+
+// Reads every material of the MTL file at path and adds it to materials.
+// Map paths in the file are relative to the file itself.
+bool loadMTLFile(const std::string& path, std::vector<ObjMaterial>& materials);
@@ -13,12 +13,14 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 #include "Shader.hpp"
 #include "VertexBufferLayout.hpp"
 #include "Texture.hpp"
 #include "Transform.hpp"
 #include "Geometry.hpp"
+#include "TextureAtlas.hpp"
 
 #include "glm/vec3.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -32,23 +34,41 @@ public:
     // Object Constructor
     Object();
     // Object destructor
-    ~Object();
+    virtual ~Object();
     // Load a texture
-    void LoadTexture(std::string fileName);
+    void LoadTexture(std::string fileName, const TextureSettings& settings = TextureSettings());
     // Create a textured quad
     void MakeTexturedQuad(std::string fileName);
+    // Uses image id of a built atlas as the texture. The texture
+    // coordinates are moved into the image's rectangle, so this must be
+    // called once, after the geometry was made. Returns false (and changes
+    // nothing) if the image is not in the atlas.
+    bool UseAtlas(const TextureAtlas& atlas, int id);
     // How to draw the object
     virtual void Render();
+    // Called at the start of every frame. Objects drawn one after another
+    // with the same texture only bind it once per frame.
+    static void BeginFrame();
+    // Number of times a texture was bound since the last BeginFrame()
+    static unsigned int GetTextureBindCount();
 protected: // Classes that inherit from Object are intended to be overridden.
 
 	// Helper method for when we are ready to draw or update our object
 	void Bind();
+    // Binds texture to slot 0, unless it is already bound this frame
+    void BindTexture(const std::shared_ptr<Texture>& texture);
     // For now we have one buffer per object.
     VertexBufferLayout m_vertexBufferLayout;
-    // For now we have one diffuse map and one normal map per object
-    Texture m_textureDiffuse;
+    // For now we have one diffuse map and one normal map per object.
+    // Textures come from the TextureRegistry, so objects using the
+    // same image share one texture.
+    std::shared_ptr<Texture> m_textureDiffuse;
     // Store the objects Geometry
 	Geometry m_geometry;
+private:
+    // OpenGL id of the texture the last object bound this frame
+    static GLuint s_boundTexture;
+    static unsigned int s_textureBinds;
 };
 
 
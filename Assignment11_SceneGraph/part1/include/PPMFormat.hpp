@@ -0,0 +1,76 @@
+/** @file PPMFormat.hpp
+ *  @brief Helpers for reading and writing the PPM header.
+ *
+ *  Both the ASCII (P3) and binary (P6) flavors of PPM share the same
+ *  header: a magic number, the width and height, and the maximum color
+ *  value, with '#' comments allowed anywhere in between.
+ *  See http://netpbm.sourceforge.net/doc/ppm.html
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef PPM_FORMAT_HPP
+#define PPM_FORMAT_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Everything we learn from the header of a PPM
+struct PPMHeader{
+    // True for P6 (binary), false for P3 (ASCII)
+    bool binary{false};
+    // Dimensions of the image in pixels
+    int width{0};
+    int height{0};
+    // Largest value a color component may take
+    int maxValue{0};
+    // Byte offset from the start of the file to the first pixel value
+    size_t dataOffset{0};
+};
+
+// Parses the header at the front of a PPM file held in memory.
+// Returns false (and prints why) if the header is not a valid P3 or P6
+// header, or if its range needs two bytes per color component.
+bool ParsePPMHeader(const uint8_t* data, size_t size, PPMHeader& header);
+
+// Same as ParsePPMHeader, but data only needs to hold the header, so the
+// payload is not checked. Used when reading a file a piece at a time.
+bool ParsePPMHeaderFields(const uint8_t* data, size_t size, PPMHeader& header);
+
+// Parses the whitespace separated decimal values of a P3 payload.
+// Reads from [begin,end) and writes at most count values into out.
+// '#' comments are skipped and values above 255 are clamped to 255.
+// Nothing is allocated; the scan is a single pass over the buffer.
+// Returns how many values were written.
+size_t ParseASCIIValues(const uint8_t* begin, const uint8_t* end, uint8_t* out, size_t count);
+
+// Same as ParseASCIIValues, but large payloads are split into chunks at
+// line breaks and decoded on several threads. Each chunk first counts its
+// values, a prefix sum of the counts gives every chunk its output offset,
+// and then the chunks are decoded in parallel. Small payloads (or
+// threadCount of 1) are decoded on the calling thread.
+// threadCount of 0 uses one thread per hardware core.
+size_t ParseASCIIValuesParallel(const uint8_t* begin, const uint8_t* end, uint8_t* out, size_t count, unsigned int threadCount=0);
+
+// Builds the text of a header, e.g. "P6\n512 512\n255\n"
+std::string MakePPMHeader(bool binary, int width, int height, int maxValue);
+
+// Largest number of bytes FormatASCIIValues can write for count values
+size_t GetMaxASCIISize(size_t count, size_t valuesPerLine);
+
+// Formats count values as decimal text for a P3 payload. Every value is
+// followed by a space, and a newline follows every valuesPerLine values.
+// out must hold at least GetMaxASCIISize(count, valuesPerLine) bytes.
+// Returns the number of bytes written.
+size_t FormatASCIIValues(const uint8_t* values, size_t count, size_t valuesPerLine, char* out);
+
+// Writes a complete PPM file. P6 writes the pixels as they are. P3 rows
+// are formatted into one buffer (bands of rows on separate threads) and
+// written with a single call. threadCount of 0 uses one thread per
+// hardware core. Returns false (and prints why) if the file can not be
+// written.
+bool WritePPM(const std::string& filepath, const uint8_t* pixels, int width, int height,
+              int maxValue, bool binary, unsigned int threadCount=0);
+
+#endif
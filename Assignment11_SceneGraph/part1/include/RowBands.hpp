@@ -0,0 +1,45 @@
+/** @file RowBands.hpp
+ *  @brief Splits work over the rows of an image across threads.
+ *
+ *  The image code (resampling, mip generation, sRGB conversion, image
+ *  comparison, convolution) all works a band of rows at a time. Starting
+ *  a thread costs about as much as processing half a megabyte, so bands
+ *  are only split off when every thread gets at least that much.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef ROW_BANDS_HPP
+#define ROW_BANDS_HPP
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstddef>
+
+// Runs work(begin,end) over the rows [0,rows), split across threads
+// when there are enough bytes to make the threads worthwhile. rowBytes
+// is roughly how much memory the work touches per row. threadCount of
+// 0 uses one thread per hardware core.
+template<typename Work>
+inline void ForEachRowBand(int rows, size_t rowBytes, unsigned int threadCount, Work work){
+    const size_t minimumBandBytes = 512*1024;
+    if(threadCount == 0){
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t bands = std::min<size_t>({(size_t)threadCount, (size_t)rows, (rows*rowBytes)/minimumBandBytes});
+    if(bands <= 1){
+        work(0, rows);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for(size_t i=1; i < bands; ++i){
+        workers.emplace_back(work, (int)(rows*i/bands), (int)(rows*(i+1)/bands));
+    }
+    work(0, (int)(rows/bands));
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+}
+
+#endif
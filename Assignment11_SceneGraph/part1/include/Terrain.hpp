@@ -14,6 +14,7 @@
 #include "Shader.hpp"
 #include "Image.hpp"
 #include "Object.hpp"
+#include "Resample.hpp"
 
 #include <vector>
 #include <string>
@@ -21,7 +22,10 @@
 class Terrain : public Object {
 public:
     // Takes in a Terrain and a filename for the heightmap.
-    Terrain (unsigned int xSegs, unsigned int zSegs, std::string fileName);
+    // The heightmap is resized to xSegs x zSegs with filter, so any number
+    // of segments works with any size of image.
+    Terrain (unsigned int xSegs, unsigned int zSegs, std::string fileName,
+             ResampleFilter filter=ResampleFilter::Bicubic);
     // Destructor
     ~Terrain ();
     // override the initialization routine.
@@ -36,7 +40,7 @@ private:
     unsigned int m_zSegments;
 
     // Store the height in a multidimensional array
-    int* m_heightData;
+    float* m_heightData;
 
     // Textures for the terrain
     // Terrains are often 'multitextured' and have multiple textures.
@@ -0,0 +1,49 @@
+/** @file TextureLoader.hpp
+ *  @brief Decodes textures on worker threads and streams them to the GPU.
+ *
+ *  Decoding a large PPM can take long enough to freeze the window, so
+ *  Texture::LoadTextureAsync hands the work to a small pool of worker
+ *  threads. OpenGL may only be called from the thread that owns the
+ *  context, so uploading is done by Update(), which the main loop calls
+ *  once per frame. Each Update() uploads at most a fixed number of bytes,
+ *  which keeps the cost of streaming in any one frame bounded.
+ *
+ *  The time between calls to Update() is recorded while textures are
+ *  streaming, so the longest frame (and the longest upload) can be
+ *  printed once everything is loaded.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef TEXTURE_LOADER_HPP
+#define TEXTURE_LOADER_HPP
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+#include "BlockCompression.hpp"
+
+class Texture;
+
+class TextureLoader{
+public:
+    // Queues filepath to be decoded on a worker thread for texture, along
+    // with its mipmap levels if mipmaps is true. The worker also compresses
+    // every level unless compression is BlockFormat::None.
+    // Only a weak reference is kept, so a texture that is deleted
+    // before it finishes loading is simply skipped.
+    static void Submit(std::weak_ptr<Texture> texture, const std::string& filepath, bool mipmaps, BlockFormat compression);
+    // Uploads decoded textures, at most byteBudget bytes per call.
+    // Must be called on the OpenGL thread, once per frame.
+    static void Update(size_t byteBudget = s_defaultByteBudget);
+    // True while any texture is waiting to be decoded or uploaded
+    static bool IsBusy();
+    // Prints how much was streamed and the worst frame times seen
+    static void PrintStatistics();
+
+    // Bytes uploaded per frame unless told otherwise (1 MB)
+    static const size_t s_defaultByteBudget = 1024*1024;
+};
+
+#endif
@@ -49,6 +49,10 @@ public:
     // bitangent b_x,b_y,b_z
     void CreateNormalBufferLayout(unsigned int vcount,unsigned int icount, float* vdata, unsigned int* idata );
 
+    // Replaces the vertex data of a layout that has already been created.
+    // vcount must not be more than the layout was created with.
+    void UpdateVertexData(unsigned int vcount, float* vdata);
+
 private:
     // Vertex Array Object
     GLuint m_VAOId;
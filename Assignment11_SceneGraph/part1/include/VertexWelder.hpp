@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ObjParser.hpp"
+
+// Every triangle corner of an OBJ names a (position, uv, normal) triple.
+// Neighboring triangles name the same triples, so expanding every corner
+// into its own vertex repeats each vertex about six times. Welding keeps
+// one copy of each distinct triple and describes the triangles with
+// indices into those copies instead.
+//
+// The triples are found with an open addressing hash table (linear
+// probing) sized from the number of corners up front, so it never grows.
+//
+// unique receives one corner per distinct triple, in the order they first
+// appear, and indices one index into unique per corner.
+void weldCorners(const std::vector<ObjCorner>& corners,
+                 std::vector<ObjCorner>& unique,
+                 std::vector<uint32_t>& indices);
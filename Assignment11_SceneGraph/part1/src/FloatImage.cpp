@@ -0,0 +1,241 @@
+#include "FloatImage.hpp"
+#include "RowBands.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <algorithm>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+    #define FLOAT_IMAGE_F16C
+    #include <immintrin.h>
+#endif
+
+// Linear value of every 8 bit sRGB value.
+// See https://en.wikipedia.org/wiki/SRGB for the transfer function.
+static float s_toLinear[256];
+static std::once_flag s_tableBuilt;
+
+static void BuildTable(){
+    for(int i=0; i < 256; ++i){
+        double c = i/255.0;
+        s_toLinear[i] = (float)((c <= 0.04045) ? c/12.92 : std::pow((c+0.055)/1.055, 2.4));
+    }
+}
+
+void SRGBToLinear(const uint8_t* in, float* out, size_t count){
+    std::call_once(s_tableBuilt, BuildTable);
+    for(size_t i=0; i < count; ++i){
+        out[i] = s_toLinear[in[i]];
+    }
+}
+
+// Above the linear toe, sRGB is 1.055*x^(1/2.4) - 0.055. x^(1/2.4) is
+// close to a mix of x^(1/2), x^(1/4) and x^(1/8), which are just repeated
+// square roots, so the curve is approximated by a weighted sum of those.
+// The largest error is less than one 8 bit step.
+static inline float EncodeValue(float x){
+    x = std::min(1.0f, std::max(0.0f, x));
+    if(x <= 0.0031308f){
+        return x*12.92f;
+    }
+    float s1 = std::sqrt(x);
+    float s2 = std::sqrt(s1);
+    float s3 = std::sqrt(s2);
+    return 0.662002687f*s1 + 0.684122060f*s2 - 0.323583601f*s3 - 0.0225411470f*x;
+}
+
+void LinearToSRGB(const float* in, uint8_t* out, size_t count){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 toe = _mm_set1_ps(0.0031308f);
+    const __m128 toeSlope = _mm_set1_ps(12.92f);
+    const __m128 c1 = _mm_set1_ps(0.662002687f);
+    const __m128 c2 = _mm_set1_ps(0.684122060f);
+    const __m128 c3 = _mm_set1_ps(-0.323583601f);
+    const __m128 c4 = _mm_set1_ps(-0.0225411470f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for(; i + 16 <= count; i += 16){
+        __m128i encoded[4];
+        for(int j=0; j < 4; ++j){
+            __m128 x = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(in+i+4*j)));
+            __m128 s1 = _mm_sqrt_ps(x);
+            __m128 s2 = _mm_sqrt_ps(s1);
+            __m128 s3 = _mm_sqrt_ps(s2);
+            __m128 curve = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c1, s1), _mm_mul_ps(c2, s2)),
+                                      _mm_add_ps(_mm_mul_ps(c3, s3), _mm_mul_ps(c4, x)));
+            // Pick the linear toe where x is small
+            __m128 isToe = _mm_cmple_ps(x, toe);
+            __m128 result = _mm_or_ps(_mm_and_ps(isToe, _mm_mul_ps(x, toeSlope)), _mm_andnot_ps(isToe, curve));
+            result = _mm_min_ps(one, _mm_max_ps(zero, result));
+            encoded[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(result, scale), half));
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(encoded[0], encoded[1]), _mm_packs_epi32(encoded[2], encoded[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), packed);
+    }
+#endif
+    for(; i < count; ++i){
+        float result = std::min(1.0f, std::max(0.0f, EncodeValue(in[i])));
+        out[i] = (uint8_t)(result*255.0f + 0.5f);
+    }
+}
+
+// Rounds a float to the nearest half float. Works on the bit patterns;
+// see https://gist.github.com/rygorous/2156668 for how.
+static uint16_t FloatToHalfValue(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+    uint16_t result;
+    if(bits >= (127u + 16u) << 23){
+        // Too large for a half, or infinity or NaN
+        result = (bits > 0x7F800000u) ? 0x7E00 : 0x7C00;
+    }else if(bits < 113u << 23){
+        // Too small for a normal half. Adding 0.5 lines the bits up so
+        // the float hardware does the rounding.
+        const uint32_t magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        float magic;
+        float small;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        memcpy(&small, &bits, sizeof(small));
+        small += magic;
+        memcpy(&bits, &small, sizeof(bits));
+        result = (uint16_t)(bits - magicBits);
+    }else{
+        uint32_t odd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xFFF + odd;
+        result = (uint16_t)(bits >> 13);
+    }
+    return result | (uint16_t)(sign >> 16);
+}
+
+static float HalfToFloatValue(uint16_t value){
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    if(exponent == 0){
+        // Zero or too small to be normal: mantissa * 2^-24
+        float result = mantissa*(1.0f/16777216.0f);
+        return sign ? -result : result;
+    }
+    uint32_t bits = (exponent == 31) ? (sign | 0x7F800000u | (mantissa << 13))
+                                     : (sign | ((exponent + 112) << 23) | (mantissa << 13));
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+#if defined(FLOAT_IMAGE_F16C)
+__attribute__((target("f16c")))
+static void FloatToHalfF16C(const float* in, uint16_t* out, size_t count){
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in+i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), halves);
+    }
+    for(; i < count; ++i){
+        out[i] = FloatToHalfValue(in[i]);
+    }
+}
+
+__attribute__((target("f16c")))
+static void HalfToFloatF16C(const uint16_t* in, float* out, size_t count){
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+i));
+        _mm256_storeu_ps(out+i, _mm256_cvtph_ps(halves));
+    }
+    for(; i < count; ++i){
+        out[i] = HalfToFloatValue(in[i]);
+    }
+}
+
+// Checked once. __builtin_cpu_init is needed in case this runs during
+// static initialization.
+static bool HasF16C(){
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("f16c"));
+    return supported;
+}
+#endif
+
+void FloatToHalf(const float* in, uint16_t* out, size_t count){
+#if defined(FLOAT_IMAGE_F16C)
+    if(HasF16C()){
+        FloatToHalfF16C(in, out, count);
+        return;
+    }
+#endif
+    for(size_t i=0; i < count; ++i){
+        out[i] = FloatToHalfValue(in[i]);
+    }
+}
+
+void HalfToFloat(const uint16_t* in, float* out, size_t count){
+#if defined(FLOAT_IMAGE_F16C)
+    if(HasF16C()){
+        HalfToFloatF16C(in, out, count);
+        return;
+    }
+#endif
+    for(size_t i=0; i < count; ++i){
+        out[i] = HalfToFloatValue(in[i]);
+    }
+}
+
+// Constructor
+FloatImage::FloatImage(){
+}
+
+// Constructor
+FloatImage::FloatImage(int width, int height, int channels){
+    Allocate(width, height, channels);
+    std::fill(m_data.begin(), m_data.end(), 0.0f);
+}
+
+void FloatImage::Allocate(int width, int height, int channels){
+    m_width = std::max(0, width);
+    m_height = std::max(0, height);
+    m_channels = std::max(0, channels);
+    m_data.resize((size_t)m_width*m_height*m_channels);
+}
+
+void FloatImage::DecodeSRGB(const uint8_t* pixels, int width, int height, int channels, unsigned int threadCount){
+    Allocate(width, height, channels);
+    if(pixels == nullptr){
+        return;
+    }
+    size_t rowValues = (size_t)m_width*m_channels;
+    ForEachRowBand(m_height, rowValues*sizeof(float), threadCount, [&](int begin, int end){
+        SRGBToLinear(pixels + begin*rowValues, m_data.data() + begin*rowValues, (end - begin)*rowValues);
+    });
+}
+
+void FloatImage::EncodeSRGB(uint8_t* out, unsigned int threadCount) const{
+    if(out == nullptr){
+        return;
+    }
+    size_t rowValues = (size_t)m_width*m_channels;
+    ForEachRowBand(m_height, rowValues*sizeof(float), threadCount, [&](int begin, int end){
+        LinearToSRGB(m_data.data() + begin*rowValues, out + begin*rowValues, (end - begin)*rowValues);
+    });
+}
+
+void FloatImage::LoadHalf(const uint16_t* values, int width, int height, int channels){
+    Allocate(width, height, channels);
+    if(values != nullptr){
+        HalfToFloat(values, m_data.data(), m_data.size());
+    }
+}
+
+void FloatImage::StoreHalf(uint16_t* out) const{
+    if(out != nullptr){
+        FloatToHalf(m_data.data(), out, m_data.size());
+    }
+}
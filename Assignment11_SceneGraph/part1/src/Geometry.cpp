@@ -39,6 +39,21 @@ void Geometry::AddVertex(float x, float y, float z, float s, float t){
 	m_biTangents.push_back(1.0f);
 }
 
+// Remaps our own copy of the coordinates, and the copy in m_bufferData
+// if Gen() has already been called.
+void Geometry::RemapTextureCoords(float offsetS, float offsetT, float scaleS, float scaleT){
+	for(size_t i=0; i < m_textureCoords.size(); i+=2){
+		m_textureCoords[i+0] = offsetS + glm::clamp(m_textureCoords[i+0], 0.0f, 1.0f)*scaleS;
+		m_textureCoords[i+1] = offsetT + glm::clamp(m_textureCoords[i+1], 0.0f, 1.0f)*scaleT;
+	}
+	// Gen() stores 14 floats per vertex, with s,t after the position and normal
+	const size_t stride = 14;
+	for(size_t i=0; i < m_bufferData.size()/stride; ++i){
+		m_bufferData[i*stride+6] = m_textureCoords[i*2+0];
+		m_bufferData[i*stride+7] = m_textureCoords[i*2+1];
+	}
+}
+
 // Allows for adding one index at a time manually if 
 // you know which vertices are needed to make a triangle.
 void Geometry::AddIndex(unsigned int i){
@@ -5,6 +5,11 @@
 #include <stdio.h>
 #include <cstdint>
 #include <memory>
+#include <utility>
+#include <chrono>
+
+#include "PPMFormat.hpp"
+#include "BufferPool.hpp"
 
 // Constructor
 Image::Image(std::string filepath) : m_filepath(filepath){
@@ -16,95 +21,237 @@ Image::~Image (){
     // Delete our pixel data.	
     // Note: We could actually do this sooner
     // in our rendering process.
-    if(m_pixelData!=NULL){
-        delete[] m_pixelData;
+    ReleasePixelData();
+}
+
+// Frees our pixel data, or unmaps it if it came straight from the file.
+void Image::ReleasePixelData(){
+    if(m_pixelData!=nullptr && m_ownsPixelData){
+        BufferPool::Release(m_pixelData, m_pixelDataSize);
+    }
+    m_pixelData = nullptr;
+    m_ownsPixelData = false;
+    m_pixelDataSize = 0;
+    m_layout = PixelLayout::Linear;
+    m_file.Close();
+}
+
+// Copies the pixels into a new buffer in the requested order
+void Image::SetLayout(PixelLayout layout){
+    if(layout == m_layout || m_pixelData == nullptr){
+        return;
     }
+    size_t size = GetPixelDataSize(layout, m_width, m_height);
+    uint8_t* converted = BufferPool::Acquire(size);
+    if(layout == PixelLayout::Tiled){
+        ConvertLinearToTiled(m_pixelData, m_width, m_height, converted);
+    }else{
+        ConvertTiledToLinear(m_pixelData, m_width, m_height, converted);
+    }
+    ReleasePixelData();
+    m_pixelData = converted;
+    m_ownsPixelData = true;
+    m_pixelDataSize = size;
+    m_layout = layout;
+}
+
+// Allocates black pixels to draw into
+void Image::Create(int width, int height){
+    ReleasePixelData();
+    m_width = width;
+    m_height = height;
+    m_pixelDataSize = (size_t)width*height*3;
+    m_pixelData = BufferPool::Acquire(m_pixelDataSize);
+    m_ownsPixelData = true;
+    memset(m_pixelData, 0, m_pixelDataSize);
 }
 
 // Little function for loading the pixel data
 // from a PPM image.
-// TODO: Expects a very specific version of PPM!
+// Both ASCII (P3) and binary (P6) files are supported.
+// A P6 file is memory mapped, and when no flip is requested
+// the pixels are used in place without ever being copied.
+// (Texture always flips, so it gets one reversed copy instead;
+// it avoids the copy on later runs through the TextureCache.)
 //
 // flip - Will flip the pixels upside down in the data
 //        If you use this be consistent.
-void Image::LoadPPM(bool flip){
-
-  // Open an input file stream for reading a file
-  std::ifstream ppmFile(m_filepath.c_str());
-  // If our file successfully opens, begin to process it.
-  if (ppmFile.is_open()){
-      // line will store one line of input
-      std::string line;
-      // Our loop invariant is to continue reading input until
-      // we reach the end of the file and it reads in a NULL character
-      std::cout << "Reading in ppm file: " << m_filepath << std::endl;
-      unsigned int iteration = 0;
-      unsigned int pos = 0;
-      while ( getline (ppmFile,line) ){
-         // Ignore comments in the file
-         if (line[0]=='#'){
-            continue;
-         }
-         if(line[0]=='P'){
-            magicNumber = line;
-         }else if(iteration==1){
-            // Returns first token 
-            char *token = strtok((char*)line.c_str(), " "); 
-            m_width = atoi(token);
-            token = strtok(NULL, " ");
-            m_height = atoi(token);
-            std::cout << "PPM width,height=" << m_width << "," << m_height << "\n";	
-            if(m_width > 0 && m_height > 0){
-                m_pixelData = new uint8_t[m_width*m_height*3];
-                if(m_pixelData==NULL){
-                    std::cout << "Unable to allocate memory for ppm" << std::endl;
-                    exit(1);
-                 }
-             }else{
-                std::cout << "PPM not parsed correctly, width and/or height dimensions are 0" << std::endl;
-                exit(1);
-             }
-         }else if(iteration==2){
-            // max color range is stored here
-            // TODO: Can be stored optionally
-         }else{
-            m_pixelData[pos] = (uint8_t)atoi(line.c_str());
-            ++pos;
-         }
-          iteration++;
-    }             
-    ppmFile.close();
-  }
-  else{
-      std::cout << "Unable to open ppm file:" << m_filepath << std::endl;
-  } 
-
-    // Flip all of the pixels
-    if(flip){
-        // Copy all of the data to a temporary stack-allocated array
-        uint8_t* copyData = new uint8_t[m_width*m_height*3];
-        for(int i =0; i < m_width*m_height*3; ++i){
-            copyData[i]=m_pixelData[i];
-        }
-        //memcpy(copyData,m_pixelData,(m_width*m_height*3)*sizeof(uint8_t));
-        unsigned int pos = (m_width*m_height*3)-1;
-        for(int i =0; i < m_width*m_height*3; i+=3){
-            m_pixelData[pos]=copyData[i+2];
-            m_pixelData[pos-1]=copyData[i+1];
-            m_pixelData[pos-2]=copyData[i];
-            pos-=3;
+// This may run on a TextureLoader worker, so a bad file is reported
+// by returning false rather than ending the program.
+bool Image::LoadPPM(bool flip){
+    ReleasePixelData();
+    m_width = 0;
+    m_height = 0;
+    std::cout << "Reading in ppm file: " << m_filepath << std::endl;
+
+    // Map the file so we can look at the header
+    if(!m_file.Open(m_filepath)){
+        std::cout << "Unable to open ppm file:" << m_filepath << std::endl;
+        return false;
+    }
+    PPMHeader header;
+    if(!ParsePPMHeader(m_file.GetData(), m_file.GetSize(), header)){
+        std::cout << "PPM not parsed correctly: " << m_filepath << std::endl;
+        m_file.Close();
+        return false;
+    }
+    magicNumber = header.binary ? "P6" : "P3";
+    m_width = header.width;
+    m_height = header.height;
+    std::cout << "PPM width,height=" << m_width << "," << m_height << "\n";	
+
+    if(header.binary){
+        LoadBinaryPPM(header.dataOffset, flip);
+    }else{
+        LoadAsciiPPM(header.dataOffset);
+        // Flip all of the pixels
+        if(flip){
+            FlipPixels();
         }
-        delete[] copyData;
+    }
+    return true;
+}
+
+// Decodes the pixel values of a P3 file that is already mapped in m_file.
+// The payload is tokenized straight out of the mapping (split across
+// threads for large files), so comments and any mix of spaces and
+// newlines are fine.
+void Image::LoadAsciiPPM(size_t dataOffset){
+    size_t valueCount = (size_t)m_width*m_height*3;
+    m_pixelData = BufferPool::Acquire(valueCount);
+    m_ownsPixelData = true;
+    m_pixelDataSize = valueCount;
+
+    const uint8_t* payload = m_file.GetData() + dataOffset;
+    const uint8_t* end = m_file.GetData() + m_file.GetSize();
+    auto startTime = std::chrono::steady_clock::now();
+    size_t parsed = ParseASCIIValuesParallel(payload, end, m_pixelData, valueCount);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    if(parsed < valueCount){
+        std::cout << "PPM has " << parsed << " of " << valueCount << " expected values, filling the rest with 0" << std::endl;
+        memset(m_pixelData+parsed, 0, valueCount-parsed);
+    }
+    double megabytes = (end-payload)/(1024.0*1024.0);
+    std::cout << "Parsed " << megabytes << " MB of P3 data in " << elapsed.count()*1000.0 << " ms ("
+              << (elapsed.count() > 0.0 ? megabytes/elapsed.count() : 0.0) << " MB/s)" << std::endl;
+    // The mapping is no longer needed
+    m_file.Close();
+}
+
+// Uses the binary payload of a P6 file that is already mapped in m_file.
+// Without a flip we point straight into the mapping, so the bytes
+// handed to OpenGL are the very pages the kernel read from disk.
+// With a flip we make one reversed copy out of the mapping.
+void Image::LoadBinaryPPM(size_t dataOffset, bool flip){
+    uint8_t* payload = m_file.GetData() + dataOffset;
+    if(!flip){
+        m_pixelData = payload;
+        m_ownsPixelData = false;
+        return;
+    }
+
+    size_t pixelCount = (size_t)m_width*m_height;
+    m_pixelData = BufferPool::Acquire(pixelCount*3);
+    m_ownsPixelData = true;
+    m_pixelDataSize = pixelCount*3;
+    const uint8_t* source = payload + (pixelCount-1)*3;
+    uint8_t* destination = m_pixelData;
+    for(size_t i=0; i < pixelCount; ++i){
+        destination[0] = source[0];
+        destination[1] = source[1];
+        destination[2] = source[2];
+        destination += 3;
+        source -= 3;
+    }
+    // Nothing points into the file anymore
+    m_file.Close();
+}
+
+// Adopts pixels that already live in a mapped file, so they can be
+// handed to OpenGL without being parsed or copied.
+void Image::LoadMappedPixels(MappedFile&& file, size_t dataOffset, int width, int height){
+    ReleasePixelData();
+    m_file = std::move(file);
+    m_width = width;
+    m_height = height;
+    m_pixelData = m_file.GetData() + dataOffset;
+    m_ownsPixelData = false;
+}
+
+// Rotates the pixels 180 degrees by swapping pixels
+// from each end of the array towards the middle.
+void Image::FlipPixels(){
+    if(m_pixelData==nullptr){
+        return;
+    }
+    size_t pixelCount = (size_t)m_width*m_height;
+    uint8_t* front = m_pixelData;
+    uint8_t* back = m_pixelData + (pixelCount-1)*3;
+    while(front < back){
+        std::swap(front[0],back[0]);
+        std::swap(front[1],back[1]);
+        std::swap(front[2],back[2]);
+        front += 3;
+        back -= 3;
     }
 }
 
+// Saves our pixels out to a PPM file.
+// binary - true writes a P6 file, false writes a P3 file.
+// Returns false if the file could not be written.
+bool Image::SavePPM(std::string filepath, bool binary){
+    if(m_pixelData==nullptr){
+        std::cout << "No pixel data to save to " << filepath << std::endl;
+        return false;
+    }
+    if(m_layout != PixelLayout::Linear){
+        std::unique_ptr<uint8_t[]> linear(new uint8_t[(size_t)m_width*m_height*3]);
+        ConvertTiledToLinear(m_pixelData, m_width, m_height, linear.get());
+        return WritePPM(filepath, linear.get(), m_width, m_height, 255, binary);
+    }
+    return WritePPM(filepath, m_pixelData, m_width, m_height, 255, binary);
+}
+
+// Pixels of image in row order, converted into scratch if it is tiled
+static const uint8_t* GetLinearPixels(Image& image, std::unique_ptr<uint8_t[]>& scratch){
+    if(image.GetLayout() == PixelLayout::Linear){
+        return image.GetPixelDataPtr();
+    }
+    scratch.reset(new uint8_t[(size_t)image.GetWidth()*image.GetHeight()*3]);
+    ConvertTiledToLinear(image.GetPixelDataPtr(), image.GetWidth(), image.GetHeight(), scratch.get());
+    return scratch.get();
+}
+
+bool Image::Compare(Image& other, ImageDifference& result, const CompareSettings& settings){
+    if(m_pixelData==nullptr || other.m_pixelData==nullptr || m_width!=other.m_width || m_height!=other.m_height){
+        std::cout << "Can not compare " << m_filepath << " (" << m_width << "x" << m_height << ") with "
+                  << other.m_filepath << " (" << other.m_width << "x" << other.m_height << ")" << std::endl;
+        return false;
+    }
+    std::unique_ptr<uint8_t[]> scratch, otherScratch;
+    CompareImages(GetLinearPixels(*this, scratch), GetLinearPixels(other, otherScratch), m_width, m_height, result, settings);
+    return true;
+}
+
+bool Image::SaveDifferenceHeatmap(Image& other, std::string filepath, int scale){
+    if(m_pixelData==nullptr || other.m_pixelData==nullptr || m_width!=other.m_width || m_height!=other.m_height){
+        std::cout << "Can not compare " << m_filepath << " (" << m_width << "x" << m_height << ") with "
+                  << other.m_filepath << " (" << other.m_width << "x" << other.m_height << ")" << std::endl;
+        return false;
+    }
+    std::unique_ptr<uint8_t[]> scratch, otherScratch;
+    return WriteDifferenceHeatmap(filepath, GetLinearPixels(*this, scratch), GetLinearPixels(other, otherScratch),
+                                  m_width, m_height, scale);
+}
+
 /*  ===============================================
 Desc: Sets a pixel in our array a specific color
 Precondition: 
 Post-condition:
 =============================================== */ 
 void Image::SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b){
-  if(x > m_width || y > m_height){
+  if(x < 0 || y < 0 || x >= m_width || y >= m_height){
     return;
   }
   else{
@@ -112,9 +259,10 @@ void Image::SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b){
               << x << "," << y << "from (" <<
               (int)color[x*y] << "," << (int)color[x*y+1] << "," <<
 (int)color[x*y+2] << ")";*/
-    m_pixelData[(x*3)+m_height*(y*3)] = r;
-    m_pixelData[(x*3)+m_height*(y*3)+1] = g;
-    m_pixelData[(x*3)+m_height*(y*3)+2] = b;
+    size_t offset = GetPixelOffset(x, y);
+    m_pixelData[offset] = r;
+    m_pixelData[offset+1] = g;
+    m_pixelData[offset+2] = b;
 /*    std::cout << " to (" << (int)color[x*y] << "," << (int)color[x*y+1] << ","
 << (int)color[x*y+2] << ")" << std::endl;*/
   }
@@ -126,8 +274,10 @@ Precondition:
 Post-condition:
 =============================================== */ 
 void Image::PrintPixels(){
-    for(int x = 0; x <  m_width*m_height*3; ++x){
-        std::cout << " " << (int)m_pixelData[x];
+    for(int y = 0; y < m_height; ++y){
+        for(int x = 0; x < m_width; ++x){
+            std::cout << " " << GetPixelR(x,y) << " " << GetPixelG(x,y) << " " << GetPixelB(x,y);
+        }
     }
     std::cout << "\n";
 }
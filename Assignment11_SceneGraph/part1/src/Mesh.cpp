@@ -0,0 +1,391 @@
+#include "Mesh.hpp"
+#include "ObjParser.hpp"
+#include "VertexWelder.hpp"
+
+#include "glm/glm.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+
+// Where one vertex attribute lives inside a vertex
+struct MeshFileAttribute{
+    uint32_t location;      // Attribute location in the shader
+    uint32_t components;    // Number of floats
+    uint32_t offset;        // Floats from the start of the vertex
+};
+
+// Layout of the start of every cache file. The vertex data, index data,
+// and submeshes follow at their offsets, each 16 byte aligned.
+struct MeshFileHeader{
+    char magic[8];          // Always "MESHFILE"
+    uint32_t version;       // Bumped whenever the layout changes
+    uint32_t stride;        // Floats per vertex
+    uint32_t attributeCount;
+    MeshFileAttribute attributes[5];
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t submeshCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t submeshOffset;
+    uint64_t dataEnd;       // Offset of the end of the last section
+    uint64_t checksum;      // Hash of every byte up to dataEnd, with this field as 0
+    char materialLibrary[256]; // First 'mtllib' of the OBJ, as written there
+};
+
+static const char s_meshMagic[8] = {'M','E','S','H','F','I','L','E'};
+static const uint32_t s_meshVersion = 3;
+
+// The attributes of VertexBufferLayout::CreateNormalBufferLayout
+static const MeshFileAttribute s_normalLayout[5] = {
+    {0, 3, 0},      // position
+    {1, 3, 3},      // normal
+    {2, 2, 6},      // texture coordinate
+    {3, 3, 8},      // tangent
+    {4, 3, 11},     // bitangent
+};
+
+// Quick 64 bit hash of a block of memory, continuing from seed.
+// Consumes 8 bytes at a time, so checking a mesh costs far less than
+// parsing the OBJ it came from.
+static uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t seed=0xCBF29CE484222325ull){
+    const uint64_t prime = 0x100000001B3ull;
+    uint64_t hash = seed ^ size;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        uint64_t word;
+        memcpy(&word, data+i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for(; i < size; ++i){
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+// Checksum of a cache file: the header (with its checksum field zeroed,
+// so bounds, counts and the material library are covered) followed by
+// every byte after it up to dataEnd
+static uint64_t HashMeshFile(const MeshFileHeader& header, const uint8_t* file){
+    // Copied byte for byte, so the padding hashes the same as in the file
+    MeshFileHeader zeroed;
+    memcpy(&zeroed, &header, sizeof(zeroed));
+    zeroed.checksum = 0;
+    uint64_t hash = HashBytes(reinterpret_cast<const uint8_t*>(&zeroed), sizeof(zeroed));
+    return HashBytes(file + sizeof(header), header.dataEnd - sizeof(header), hash);
+}
+
+// Rounds offset up to the next multiple of 16
+static uint64_t AlignOffset(uint64_t offset){
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+// Size and modification time of the OBJ. The contents are not hashed,
+// that would mean reading the very file the cache is meant to skip.
+static bool GetSourceKey(const std::string& filepath, uint64_t& size, int64_t& modifiedTime){
+    std::error_code error;
+    size = std::filesystem::file_size(filepath, error);
+    if(error){
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(filepath, error);
+    if(error){
+        return false;
+    }
+    modifiedTime = time.time_since_epoch().count();
+    return true;
+}
+
+// Directory part of path, including the last '/', or empty
+static std::string GetDirectory(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Constructor
+Mesh::Mesh(){
+}
+
+// Destructor
+Mesh::~Mesh(){
+}
+
+// The cache file sits right next to the model it came from
+std::string Mesh::GetCachePath(const std::string& filepath){
+    return filepath + ".mesh";
+}
+
+bool Mesh::LoadOBJ(const std::string& filepath){
+    auto start = std::chrono::steady_clock::now();
+    bool cached = LoadCache(filepath);
+    if(!cached){
+        if(!Build(filepath)){
+            return false;
+        }
+        StoreCache(filepath);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (cached ? "Mesh cache hit: " : "Mesh cache miss: ") << filepath << " ("
+              << m_vertexCount << " vertices, " << m_indexCount/3 << " triangles in "
+              << elapsed.count()*1000.0 << " ms)" << std::endl;
+    return true;
+}
+
+void Mesh::ReleaseData(){
+    m_file.Close();
+    m_vertices.clear();
+    m_vertices.shrink_to_fit();
+    m_indices.clear();
+    m_indices.shrink_to_fit();
+    m_vertexData = nullptr;
+    m_indexData = nullptr;
+}
+
+// Tries to map the cache file for filepath
+bool Mesh::LoadCache(const std::string& filepath){
+    uint64_t sourceSize = 0;
+    int64_t sourceModifiedTime = 0;
+    MappedFile cacheFile;
+    if(!GetSourceKey(filepath, sourceSize, sourceModifiedTime) || !cacheFile.Open(GetCachePath(filepath))
+       || cacheFile.GetSize() < sizeof(MeshFileHeader)){
+        return false;
+    }
+    MeshFileHeader header;
+    memcpy(&header, cacheFile.GetData(), sizeof(header));
+    uint64_t vertexSize = (uint64_t)header.vertexCount*s_stride*sizeof(float);
+    uint64_t indexSize = (uint64_t)header.indexCount*sizeof(unsigned int);
+    uint64_t submeshSize = (uint64_t)header.submeshCount*sizeof(Submesh);
+    bool valid = memcmp(header.magic, s_meshMagic, sizeof(s_meshMagic)) == 0
+              && header.version == s_meshVersion
+              && header.stride == s_stride
+              && header.attributeCount == 5
+              && memcmp(header.attributes, s_normalLayout, sizeof(s_normalLayout)) == 0
+              && header.sourceSize == sourceSize
+              && header.sourceModifiedTime == sourceModifiedTime
+              && header.vertexOffset >= sizeof(header)
+              && header.vertexOffset + vertexSize <= header.indexOffset
+              && header.indexOffset + indexSize <= header.submeshOffset
+              && header.submeshOffset + submeshSize <= header.dataEnd
+              && header.dataEnd <= cacheFile.GetSize()
+              && header.vertexOffset % 16 == 0 && header.indexOffset % 16 == 0;
+    if(!valid){
+        return false;
+    }
+    // A cut short or damaged file must not reach the GPU
+    uint8_t* data = cacheFile.GetData();
+    if(HashMeshFile(header, data) != header.checksum){
+        std::cout << "Mesh cache is damaged, rebuilding: " << GetCachePath(filepath) << std::endl;
+        return false;
+    }
+    m_vertexCount = header.vertexCount;
+    m_indexCount = header.indexCount;
+    m_vertexData = reinterpret_cast<float*>(data + header.vertexOffset);
+    m_indexData = reinterpret_cast<unsigned int*>(data + header.indexOffset);
+    m_submeshes.resize(header.submeshCount);
+    if(header.submeshCount > 0){
+        memcpy(m_submeshes.data(), data + header.submeshOffset, submeshSize);
+    }
+    m_boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    m_boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    header.materialLibrary[sizeof(header.materialLibrary)-1] = '\0';
+    m_materialLibrary = header.materialLibrary;
+    if(!m_materialLibrary.empty()){
+        m_materialLibrary = GetDirectory(filepath) + m_materialLibrary;
+    }
+    m_file = std::move(cacheFile);
+    return true;
+}
+
+// Writes our data to the cache file for filepath.
+// The file is written under a temporary name and then renamed, so a
+// crash part way through never leaves a half written cache behind.
+void Mesh::StoreCache(const std::string& filepath){
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    if(!GetSourceKey(filepath, header.sourceSize, header.sourceModifiedTime)){
+        return;
+    }
+    memcpy(header.magic, s_meshMagic, sizeof(s_meshMagic));
+    header.version = s_meshVersion;
+    header.stride = s_stride;
+    header.attributeCount = 5;
+    memcpy(header.attributes, s_normalLayout, sizeof(s_normalLayout));
+    header.vertexCount = m_vertexCount;
+    header.indexCount = m_indexCount;
+    header.submeshCount = m_submeshes.size();
+    for(int i=0; i < 3; ++i){
+        header.boundsMin[i] = m_boundsMin[i];
+        header.boundsMax[i] = m_boundsMax[i];
+    }
+    strncpy(header.materialLibrary, m_materialLibraryName.c_str(), sizeof(header.materialLibrary)-1);
+    uint64_t vertexSize = (uint64_t)m_vertexCount*s_stride*sizeof(float);
+    uint64_t indexSize = (uint64_t)m_indexCount*sizeof(unsigned int);
+    uint64_t submeshSize = (uint64_t)m_submeshes.size()*sizeof(Submesh);
+    header.vertexOffset = AlignOffset(sizeof(header));
+    header.indexOffset = AlignOffset(header.vertexOffset + vertexSize);
+    header.submeshOffset = AlignOffset(header.indexOffset + indexSize);
+    header.dataEnd = header.submeshOffset + submeshSize;
+
+    // Lay the whole file out in memory once, so the checksum covers the
+    // padding too and the file is written with a single call
+    std::vector<uint8_t> file(header.dataEnd, 0);
+    memcpy(file.data() + header.vertexOffset, m_vertexData, vertexSize);
+    memcpy(file.data() + header.indexOffset, m_indexData, indexSize);
+    if(submeshSize > 0){
+        memcpy(file.data() + header.submeshOffset, m_submeshes.data(), submeshSize);
+    }
+    header.checksum = HashMeshFile(header, file.data());
+    memcpy(file.data(), &header, sizeof(header));
+
+    std::string cachePath = GetCachePath(filepath);
+    std::string temporaryPath = cachePath + ".tmp";
+    std::ofstream outFile(temporaryPath.c_str(), std::ios::binary);
+    if(!outFile.is_open()){
+        std::cout << "Unable to write mesh cache: " << cachePath << std::endl;
+        return;
+    }
+    outFile.write(reinterpret_cast<const char*>(file.data()), file.size());
+    outFile.close();
+    // Windows will not rename over an existing file
+    std::remove(cachePath.c_str());
+    if(!outFile || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0){
+        std::cout << "Unable to write mesh cache: " << cachePath << std::endl;
+        std::remove(temporaryPath.c_str());
+    }
+}
+
+// Parses the OBJ and builds the vertices CreateNormalBufferLayout expects
+bool Mesh::Build(const std::string& filepath){
+    ObjData data;
+    if(!loadOBJFile(filepath, data)){
+        return false;
+    }
+    // Corners shared between triangles become one vertex
+    std::vector<ObjCorner> unique;
+    std::vector<uint32_t> indices;
+    weldCorners(data.corners, unique, indices);
+
+    // Sort the triangles by material (keeping their order otherwise), so
+    // every material is one contiguous range of indices and one draw.
+    // Triangles before any 'usemtl' go first.
+    const size_t materialCount = data.materialNames.size();
+    std::vector<uint32_t> materialStart(materialCount + 2, 0);
+    for(int material : data.triangleMaterials){
+        ++materialStart[material + 2];
+    }
+    for(size_t i=1; i < materialStart.size(); ++i){
+        materialStart[i] += materialStart[i-1];
+    }
+    m_submeshes.clear();
+    for(size_t i=0; i + 1 < materialStart.size(); ++i){
+        uint32_t count = materialStart[i+1] - materialStart[i];
+        if(count == 0){
+            continue;
+        }
+        Submesh submesh;
+        memset(&submesh, 0, sizeof(submesh));
+        submesh.indexOffset = materialStart[i]*3;
+        submesh.indexCount = count*3;
+        if(i > 0){
+            strncpy(submesh.material, data.materialNames[i-1].c_str(), sizeof(submesh.material)-1);
+        }
+        m_submeshes.push_back(submesh);
+    }
+    m_indices.resize(indices.size());
+    for(size_t triangle=0; triangle < data.triangleMaterials.size(); ++triangle){
+        uint32_t destination = materialStart[data.triangleMaterials[triangle] + 1]++;
+        for(int k=0; k < 3; ++k){
+            m_indices[destination*3 + k] = indices[triangle*3 + k];
+        }
+    }
+    m_materialLibraryName = data.materialLibraries.empty() ? std::string() : data.materialLibraries[0];
+    m_materialLibrary = m_materialLibraryName.empty() ? std::string() : GetDirectory(filepath) + m_materialLibraryName;
+
+    m_vertices.assign(unique.size()*s_stride, 0.0f);
+    m_vertexCount = unique.size();
+    m_indexCount = m_indices.size();
+
+    m_boundsMin = glm::vec3(INFINITY);
+    m_boundsMax = glm::vec3(-INFINITY);
+    for(size_t i=0; i < unique.size(); ++i){
+        float* vertex = &m_vertices[i*s_stride];
+        glm::vec3 position = data.positions[unique[i].position];
+        vertex[0] = position.x;
+        vertex[1] = position.y;
+        vertex[2] = position.z;
+        if(unique[i].normal >= 0){
+            vertex[3] = data.normals[unique[i].normal].x;
+            vertex[4] = data.normals[unique[i].normal].y;
+            vertex[5] = data.normals[unique[i].normal].z;
+        }
+        if(unique[i].texCoord >= 0){
+            vertex[6] = data.texCoords[unique[i].texCoord].x;
+            vertex[7] = data.texCoords[unique[i].texCoord].y;
+        }
+        m_boundsMin = glm::min(m_boundsMin, position);
+        m_boundsMax = glm::max(m_boundsMax, position);
+    }
+    if(unique.empty()){
+        m_boundsMin = m_boundsMax = glm::vec3(0.0f);
+    }
+
+    // Every vertex gets the sum of the tangents (and, if the OBJ gave it
+    // none, the normals) of the triangles around it, the same way
+    // Geometry::MakeTriangle computes them for a single triangle.
+    for(size_t i=0; i + 2 < m_indices.size(); i += 3){
+        float* vertex[3];
+        for(int k=0; k < 3; ++k){
+            vertex[k] = &m_vertices[m_indices[i+k]*s_stride];
+        }
+        glm::vec3 edge0 = glm::vec3(vertex[1][0], vertex[1][1], vertex[1][2]) - glm::vec3(vertex[0][0], vertex[0][1], vertex[0][2]);
+        glm::vec3 edge1 = glm::vec3(vertex[2][0], vertex[2][1], vertex[2][2]) - glm::vec3(vertex[0][0], vertex[0][1], vertex[0][2]);
+        glm::vec2 deltaUV0 = glm::vec2(vertex[1][6], vertex[1][7]) - glm::vec2(vertex[0][6], vertex[0][7]);
+        glm::vec2 deltaUV1 = glm::vec2(vertex[2][6], vertex[2][7]) - glm::vec2(vertex[0][6], vertex[0][7]);
+        glm::vec3 faceNormal = glm::cross(edge0, edge1);
+        glm::vec3 tangent(0.0f);
+        glm::vec3 bitangent(0.0f);
+        float determinant = deltaUV0.x * deltaUV1.y - deltaUV1.x * deltaUV0.y;
+        if(std::fabs(determinant) > 1e-12f){
+            float f = 1.0f / determinant;
+            tangent = f * (deltaUV1.y * edge0 - deltaUV0.y * edge1);
+            bitangent = f * (-deltaUV1.x * edge0 + deltaUV0.x * edge1);
+        }
+        for(int k=0; k < 3; ++k){
+            const ObjCorner& corner = unique[m_indices[i+k]];
+            if(corner.normal < 0){
+                vertex[k][3] += faceNormal.x;
+                vertex[k][4] += faceNormal.y;
+                vertex[k][5] += faceNormal.z;
+            }
+            vertex[k][8] += tangent.x;   vertex[k][9] += tangent.y;   vertex[k][10] += tangent.z;
+            vertex[k][11] += bitangent.x; vertex[k][12] += bitangent.y; vertex[k][13] += bitangent.z;
+        }
+    }
+    for(size_t i=0; i < unique.size(); ++i){
+        float* vertex = &m_vertices[i*s_stride];
+        for(int offset : {3, 8, 11}){
+            glm::vec3 v(vertex[offset], vertex[offset+1], vertex[offset+2]);
+            float length = glm::length(v);
+            if(length > 0.0f){
+                v /= length;
+                vertex[offset] = v.x;
+                vertex[offset+1] = v.y;
+                vertex[offset+2] = v.z;
+            }
+        }
+    }
+
+    m_vertexData = m_vertices.data();
+    m_indexData = m_indices.data();
+    return true;
+}
@@ -0,0 +1,81 @@
+#include "Model.hpp"
+#include "ObjParser.hpp"
+#include "TextureRegistry.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+
+// Loads the mesh and uploads it
+Model::Model(const std::string& filepath, const TextureSettings& settings){
+    if(!m_mesh.LoadOBJ(filepath)){
+        std::cout << "(Model.cpp) Unable to load model: " << filepath << std::endl;
+        return;
+    }
+    // The mesh is already in the layout the normal map shaders use,
+    // so (when cached) the mapped file goes straight to OpenGL.
+    m_vertexBufferLayout.CreateNormalBufferLayout(m_mesh.GetVertexDataSize(),
+                                                  m_mesh.GetIndexCount(),
+                                                  m_mesh.GetVertexData(),
+                                                  m_mesh.GetIndexData());
+    m_indexCount = m_mesh.GetIndexCount();
+    // The GPU has its own copy now
+    m_mesh.ReleaseData();
+    LoadMaterials(settings);
+}
+
+// Destructor
+Model::~Model(){
+}
+
+// Matches every submesh to the diffuse map of its material
+void Model::LoadMaterials(const TextureSettings& settings){
+    std::vector<ObjMaterial> materials;
+    if(!m_mesh.GetMaterialLibrary().empty() && !loadMTLFile(m_mesh.GetMaterialLibrary(), materials)){
+        std::cout << "(Model.cpp) Unable to load materials: " << m_mesh.GetMaterialLibrary() << std::endl;
+    }
+    std::unordered_map<std::string, const ObjMaterial*> byName;
+    for(const ObjMaterial& material : materials){
+        byName[material.name] = &material;
+    }
+    // Several submeshes may share a material, each problem is reported once
+    std::unordered_set<std::string> reported;
+    m_draws.clear();
+    for(const Submesh& submesh : m_mesh.GetSubmeshes()){
+        Draw draw{submesh.indexOffset, submesh.indexCount, nullptr};
+        auto found = byName.find(submesh.material);
+        if(found == byName.end()){
+            if(submesh.material[0] != '\0' && reported.insert(submesh.material).second){
+                std::cout << "(Model.cpp) Unknown material " << submesh.material << ", using the model's own texture" << std::endl;
+            }
+        }else if(!found->second->diffuseMap.empty()){
+            const std::string& diffuseMap = found->second->diffuseMap;
+            if(std::filesystem::exists(diffuseMap)){
+                draw.texture = TextureRegistry::Get(diffuseMap, settings);
+            }else if(reported.insert(diffuseMap).second){
+                std::cout << "(Model.cpp) Missing texture " << diffuseMap << ", using the model's own" << std::endl;
+            }
+        }
+        m_draws.push_back(draw);
+    }
+    // Draws that share a texture go one after another, so it is bound once
+    std::stable_sort(m_draws.begin(), m_draws.end(), [](const Draw& a, const Draw& b){
+        return a.texture.get() < b.texture.get();
+    });
+}
+
+// Render our model
+void Model::Render(){
+    if(m_indexCount == 0){
+        return;
+    }
+    // Only the buffers, every draw binds its own texture
+    m_vertexBufferLayout.Bind();
+    for(const Draw& draw : m_draws){
+        BindTexture(draw.texture != nullptr ? draw.texture : m_textureDiffuse);
+        glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_INT,
+                       reinterpret_cast<const void*>(draw.indexOffset*sizeof(unsigned int)));
+    }
+}
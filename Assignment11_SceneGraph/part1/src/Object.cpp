@@ -1,7 +1,10 @@
 #include "Object.hpp"
 #include "Camera.hpp"
 #include "Error.hpp"
+#include "TextureRegistry.hpp"
 
+GLuint Object::s_boundTexture = 0;
+unsigned int Object::s_textureBinds = 0;
 
 Object::Object(){
 }
@@ -13,9 +16,9 @@ Object::~Object(){
 // TODO: In the future it may be good to 
 // think about loading a 'default' texture
 // if the user forgets to do this action!
-void Object::LoadTexture(std::string fileName){
-        // Load our actual textures
-        m_textureDiffuse.LoadTexture(fileName);
+void Object::LoadTexture(std::string fileName, const TextureSettings& settings){
+        // Load our actual textures, or share one that is already loaded
+        m_textureDiffuse = TextureRegistry::Get(fileName, settings);
 }
 
 // Initialization of object as a 'quad'
@@ -52,7 +55,30 @@ void Object::MakeTexturedQuad(std::string fileName){
 
         // Load our actual texture
         // We are using the input parameter as our texture to load
-        m_textureDiffuse.LoadTexture(fileName.c_str());
+        m_textureDiffuse = TextureRegistry::Get(fileName);
+}
+
+// Moves our texture coordinates into the atlas (on the GPU as well)
+// and shares the atlas page as our texture
+bool Object::UseAtlas(const TextureAtlas& atlas, int id){
+        if(!atlas.RemapTextureCoords(m_geometry, id)){
+            return false;
+        }
+        m_vertexBufferLayout.UpdateVertexData(m_geometry.GetBufferDataSize(),
+                                              m_geometry.GetBufferDataPtr());
+        m_textureDiffuse = atlas.GetTexture(atlas.GetRegion(id).page);
+        return true;
+}
+
+// Forget what was bound last frame, something else may have
+// bound a texture in between (e.g. the TextureLoader)
+void Object::BeginFrame(){
+    s_boundTexture = 0;
+    s_textureBinds = 0;
+}
+
+unsigned int Object::GetTextureBindCount(){
+    return s_textureBinds;
 }
 
 // Bind everything we need in our object
@@ -62,7 +88,17 @@ void Object::Bind(){
         // Make sure we are updating the correct 'buffers'
         m_vertexBufferLayout.Bind();
         // Diffuse map is 0 by default, but it is good to set it explicitly
-        m_textureDiffuse.Bind(0);
+        BindTexture(m_textureDiffuse);
+}
+
+// The id (not the texture) is compared, since a texture that loads in
+// the background swaps its placeholder for a new id.
+void Object::BindTexture(const std::shared_ptr<Texture>& texture){
+    if(texture != nullptr && texture->GetID() != s_boundTexture){
+        texture->Bind(0);
+        s_boundTexture = texture->GetID();
+        ++s_textureBinds;
+    }
 }
 
 // Render our geometry
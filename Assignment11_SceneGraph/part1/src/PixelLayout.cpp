@@ -0,0 +1,34 @@
+#include "PixelLayout.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+size_t GetPixelDataSize(PixelLayout layout, int width, int height){
+    if(layout == PixelLayout::Linear){
+        return (size_t)width*height*3;
+    }
+    size_t tilesAcross = (width + s_pixelTileSize - 1)/s_pixelTileSize;
+    size_t tilesDown = (height + s_pixelTileSize - 1)/s_pixelTileSize;
+    return tilesAcross*tilesDown*s_pixelTileSize*s_pixelTileSize*3;
+}
+
+// Each row of a tile (8 pixels, 24 bytes) is one run in both layouts,
+// so whole tile rows are copied at once.
+void ConvertLinearToTiled(const uint8_t* pixels, int width, int height, uint8_t* out){
+    memset(out, 0, GetPixelDataSize(PixelLayout::Tiled, width, height));
+    for(int y=0; y < height; ++y){
+        for(int x=0; x < width; x += s_pixelTileSize){
+            int run = std::min(s_pixelTileSize, width - x);
+            memcpy(out + GetTiledPixelOffset(x, y, width), pixels + GetLinearPixelOffset(x, y, width), run*3);
+        }
+    }
+}
+
+void ConvertTiledToLinear(const uint8_t* pixels, int width, int height, uint8_t* out){
+    for(int y=0; y < height; ++y){
+        for(int x=0; x < width; x += s_pixelTileSize){
+            int run = std::min(s_pixelTileSize, width - x);
+            memcpy(out + GetLinearPixelOffset(x, y, width), pixels + GetTiledPixelOffset(x, y, width), run*3);
+        }
+    }
+}
@@ -58,6 +58,8 @@ void Renderer::Render(){
     // z-buffer that figures out how far away items are every frame
     // and we have to do this every frame!
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    // Start counting (and skipping) texture binds over
+    Object::BeginFrame();
 
     // Nice way to debug your scene in wireframe!
     //glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
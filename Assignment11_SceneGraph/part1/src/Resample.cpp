@@ -0,0 +1,211 @@
+#include "Resample.hpp"
+#include "RowBands.hpp"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// Output rows are produced in chunks of this many rows, so the row pass
+// results a chunk reads stay small enough for the cache
+static const int s_chunkRows = 32;
+
+// Half width of each filter, in source pixels, when not shrinking
+static float GetFilterRadius(ResampleFilter filter){
+    switch(filter){
+        case ResampleFilter::Bilinear: return 1.0f;
+        case ResampleFilter::Bicubic:  return 2.0f;
+        case ResampleFilter::Lanczos3: return 3.0f;
+    }
+    return 1.0f;
+}
+
+// Weight of a source pixel at distance x from the sample point.
+// Every filter is 1 at 0 and 0 at every other whole number, which is
+// why resizing to the same size changes nothing.
+static float EvaluateFilter(ResampleFilter filter, float x){
+    x = std::fabs(x);
+    switch(filter){
+        case ResampleFilter::Bilinear:
+            return std::max(0.0f, 1.0f - x);
+        case ResampleFilter::Bicubic:
+            // Catmull-Rom, i.e. Keys' cubic with a = -0.5
+            if(x < 1.0f){
+                return (1.5f*x - 2.5f)*x*x + 1.0f;
+            }
+            if(x < 2.0f){
+                return ((-0.5f*x + 2.5f)*x - 4.0f)*x + 2.0f;
+            }
+            return 0.0f;
+        case ResampleFilter::Lanczos3:
+            if(x < 1e-6f){
+                return 1.0f;
+            }
+            // sin(pi*x) is not exactly 0 in floating point
+            if(x == std::floor(x)){
+                return 0.0f;
+            }
+            if(x < 3.0f){
+                const float pi = 3.14159265358979f;
+                return 3.0f*std::sin(pi*x)*std::sin(pi*x/3.0f)/(pi*pi*x*x);
+            }
+            return 0.0f;
+    }
+    return 0.0f;
+}
+
+// The source pixels and weights that make up each output pixel along one axis
+struct ResampleTaps{
+    // Taps of output i are first[i] up to first[i+1]
+    std::vector<int> first;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+// Works out the taps for resizing sourceSize pixels to outSize pixels
+static ResampleTaps ComputeTaps(int sourceSize, int outSize, ResampleFilter filter){
+    ResampleTaps taps;
+    float ratio = (float)sourceSize/outSize;
+    // When shrinking, stretch the filter to cover every source pixel
+    float filterScale = std::max(1.0f, ratio);
+    float support = GetFilterRadius(filter)*filterScale;
+    taps.first.push_back(0);
+    for(int i=0; i < outSize; ++i){
+        // Pixel centers line up, so pixel i covers [i,i+1) in output space
+        float center = (i + 0.5f)*ratio - 0.5f;
+        int begin = (int)std::ceil(center - support);
+        int end = (int)std::floor(center + support);
+        size_t start = taps.weight.size();
+        float sum = 0.0f;
+        for(int j=begin; j <= end; ++j){
+            float w = EvaluateFilter(filter, (j - center)/filterScale);
+            if(w == 0.0f){
+                continue;
+            }
+            taps.index.push_back(std::min(std::max(j, 0), sourceSize-1));
+            taps.weight.push_back(w);
+            sum += w;
+        }
+        for(size_t k=start; k < taps.weight.size(); ++k){
+            taps.weight[k] /= sum;
+        }
+        taps.first.push_back((int)taps.weight.size());
+    }
+    return taps;
+}
+
+// Applies the column taps to one source row of channels values per pixel.
+// row must have one float of padding past its end, and out one float of
+// padding past outWidth*channels.
+static void ResampleRow(const float* row, int channels, const ResampleTaps& taps, int outWidth, float* out){
+#if defined(__SSE2__)
+    if(channels == 3 || channels == 4){
+        // One pixel per vector; for RGB the fourth lane is ignored
+        for(int x=0; x < outWidth; ++x){
+            __m128 sum = _mm_setzero_ps();
+            for(int k=taps.first[x]; k < taps.first[x+1]; ++k){
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + taps.index[k]*channels), _mm_set1_ps(taps.weight[k])));
+            }
+            _mm_storeu_ps(out + x*channels, sum);
+        }
+        return;
+    }
+#endif
+    for(int x=0; x < outWidth; ++x){
+        for(int c=0; c < channels; ++c){
+            float sum = 0.0f;
+            for(int k=taps.first[x]; k < taps.first[x+1]; ++k){
+                sum += row[taps.index[k]*channels + c]*taps.weight[k];
+            }
+            out[x*channels + c] = sum;
+        }
+    }
+}
+
+// out[i] += weight*in[i] for count floats
+static void MultiplyAdd(float* out, const float* in, float weight, size_t count){
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 w = _mm_set1_ps(weight);
+    for(; i + 4 <= count; i += 4){
+        _mm_storeu_ps(out+i, _mm_add_ps(_mm_loadu_ps(out+i), _mm_mul_ps(_mm_loadu_ps(in+i), w)));
+    }
+#endif
+    for(; i < count; ++i){
+        out[i] += weight*in[i];
+    }
+}
+
+// Resizes 8 bit or float values; the source rows are converted to floats
+// one at a time
+template<typename Value>
+static void ResampleValues(const Value* pixels, int width, int height, int channels,
+                           float* out, int outWidth, int outHeight,
+                           ResampleFilter filter, unsigned int threadCount){
+    if(pixels == nullptr || out == nullptr || width <= 0 || height <= 0 || outWidth <= 0 || outHeight <= 0 || channels <= 0){
+        return;
+    }
+    const ResampleTaps columns = ComputeTaps(width, outWidth, filter);
+    const ResampleTaps rows = ComputeTaps(height, outHeight, filter);
+    const size_t outStride = (size_t)outWidth*channels;
+
+    ForEachRowBand(outHeight, outStride*sizeof(float), threadCount, [&](int begin, int end){
+        // One source row as floats, and the row pass result of every
+        // source row the current chunk reads. Both have a float of padding.
+        std::vector<float> sourceRow((size_t)width*channels + 1);
+        std::vector<float> resampledRows;
+        std::vector<float> sums(outStride);
+        for(int chunk=begin; chunk < end; chunk += s_chunkRows){
+            int chunkEnd = std::min(end, chunk + s_chunkRows);
+            // Source rows read by this chunk
+            int low = *std::min_element(rows.index.begin()+rows.first[chunk], rows.index.begin()+rows.first[chunkEnd]);
+            int high = *std::max_element(rows.index.begin()+rows.first[chunk], rows.index.begin()+rows.first[chunkEnd]);
+            resampledRows.resize((size_t)(high - low + 1)*outStride + 1);
+            for(int y=low; y <= high; ++y){
+                const Value* source = pixels + (size_t)y*width*channels;
+                for(size_t i=0; i < (size_t)width*channels; ++i){
+                    sourceRow[i] = source[i];
+                }
+                ResampleRow(sourceRow.data(), channels, columns, outWidth, &resampledRows[(y - low)*outStride]);
+            }
+            for(int y=chunk; y < chunkEnd; ++y){
+                std::fill(sums.begin(), sums.end(), 0.0f);
+                for(int k=rows.first[y]; k < rows.first[y+1]; ++k){
+                    MultiplyAdd(sums.data(), &resampledRows[(rows.index[k] - low)*outStride], rows.weight[k], outStride);
+                }
+                std::copy(sums.begin(), sums.begin()+outStride, out + (size_t)y*outStride);
+            }
+        }
+    });
+}
+
+void Resample(const uint8_t* pixels, int width, int height, int channels,
+              float* out, int outWidth, int outHeight,
+              ResampleFilter filter, unsigned int threadCount){
+    ResampleValues(pixels, width, height, channels, out, outWidth, outHeight, filter, threadCount);
+}
+
+void Resample(const FloatImage& source, FloatImage& out, int outWidth, int outHeight,
+              ResampleFilter filter, unsigned int threadCount){
+    out.Allocate(outWidth, outHeight, source.GetChannels());
+    ResampleValues(source.GetDataPtr(), source.GetWidth(), source.GetHeight(), source.GetChannels(),
+                   out.GetDataPtr(), outWidth, outHeight, filter, threadCount);
+}
+
+void Resample(const uint8_t* pixels, int width, int height, int channels,
+              uint8_t* out, int outWidth, int outHeight,
+              ResampleFilter filter, unsigned int threadCount){
+    if(out == nullptr || outWidth <= 0 || outHeight <= 0 || channels <= 0){
+        return;
+    }
+    size_t count = (size_t)outWidth*outHeight*channels;
+    std::vector<float> result(count);
+    Resample(pixels, width, height, channels, result.data(), outWidth, outHeight, filter, threadCount);
+    // Bicubic and Lanczos can overshoot near sharp edges
+    for(size_t i=0; i < count; ++i){
+        out[i] = (uint8_t)(std::min(255.0f, std::max(0.0f, result[i])) + 0.5f);
+    }
+}
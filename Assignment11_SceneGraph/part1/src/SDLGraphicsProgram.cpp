@@ -2,6 +2,10 @@
 #include "Camera.hpp"
 #include "Terrain.hpp"
 #include "Sphere.hpp"
+#include "TextureRegistry.hpp"
+#include "TextureLoader.hpp"
+#include "TextureAtlas.hpp"
+#include "Model.hpp"
 
 #include <iostream>
 #include <string>
@@ -137,53 +141,84 @@ void SDLGraphicsProgram::Loop(){
 
     // ================== Initialize the planets ===============
 
+    // The planet textures are stored block compressed on the GPU
+    // (when the driver supports it), which takes a sixth of the memory.
+    TextureSettings planetTextures;
+    planetTextures.compression = BlockFormat::BC1;
+
+    // Every planet image is packed into one atlas, so drawing the whole
+    // system binds a single texture rather than one per image.
+    AtlasSettings planetAtlasSettings;
+    planetAtlasSettings.textureSettings = planetTextures;
+    TextureAtlas planetAtlas(planetAtlasSettings);
+    planetAtlas.Add("./../../common/textures/sun.ppm");
+    planetAtlas.Add("./../../common/textures/earth.ppm");
+    planetAtlas.Add("./../../common/textures/mercury.ppm");
+    planetAtlas.Add("./../../common/textures/rock.ppm");
+    planetAtlas.Build();
+    // Images that did not make it into the atlas get their own texture
+    auto UsePlanetTexture = [&](Object* sphere, const std::string& filepath){
+        if(!sphere->UseAtlas(planetAtlas, planetAtlas.Add(filepath))){
+            sphere->LoadTexture(filepath, planetTextures);
+        }
+    };
+
     // Create the Sun
     Object* sunSphere = new Sphere();
-    sunSphere->LoadTexture("./../../common/textures/sun.ppm");
+    UsePlanetTexture(sunSphere, "./../../common/textures/sun.ppm");
     SceneNode* Sun = new SceneNode(sunSphere);
 
     // Create Planet1
     Object* planet1Sphere = new Sphere();
-    planet1Sphere->LoadTexture("./../../common/textures/earth.ppm");
+    UsePlanetTexture(planet1Sphere, "./../../common/textures/earth.ppm");
     SceneNode* Planet1 = new SceneNode(planet1Sphere);
 
     // Create Planet1 moons
     Object* planet1Moon1Sphere = new Sphere();
-    planet1Moon1Sphere->LoadTexture("./../../common/textures/rock.ppm");
+    UsePlanetTexture(planet1Moon1Sphere, "./../../common/textures/rock.ppm");
     SceneNode* Planet1Moon1 = new SceneNode(planet1Moon1Sphere);
 
     Object* planet1Moon2Sphere = new Sphere();
-    planet1Moon2Sphere->LoadTexture("./../../common/textures/rock.ppm");
+    UsePlanetTexture(planet1Moon2Sphere, "./../../common/textures/rock.ppm");
     SceneNode* Planet1Moon2 = new SceneNode(planet1Moon2Sphere);
 
     // Create Planet2
     Object* planet2Sphere = new Sphere();
-    planet2Sphere->LoadTexture("./../../common/textures/mercury.ppm");
+    UsePlanetTexture(planet2Sphere, "./../../common/textures/mercury.ppm");
     SceneNode* Planet2 = new SceneNode(planet2Sphere);
 
     // Create Planet2 moons
     Object* planet2Moon1Sphere = new Sphere();
-    planet2Moon1Sphere->LoadTexture("./../../common/textures/rock.ppm");
+    UsePlanetTexture(planet2Moon1Sphere, "./../../common/textures/rock.ppm");
     SceneNode* Planet2Moon1 = new SceneNode(planet2Moon1Sphere);
 
     Object* planet2Moon2Sphere = new Sphere();
-    planet2Moon2Sphere->LoadTexture("./../../common/textures/rock.ppm");
+    UsePlanetTexture(planet2Moon2Sphere, "./../../common/textures/rock.ppm");
     SceneNode* Planet2Moon2 = new SceneNode(planet2Moon2Sphere);
 
     // Create Planet3
     Object* planet3Sphere = new Sphere();
-    planet3Sphere->LoadTexture("./../../common/textures/earth.ppm");
+    UsePlanetTexture(planet3Sphere, "./../../common/textures/earth.ppm");
     SceneNode* Planet3 = new SceneNode(planet3Sphere);
 
     // Create Planet3 moons
     Object* planet3Moon1Sphere = new Sphere();
-    planet3Moon1Sphere->LoadTexture("./../../common/textures/rock.ppm");
+    UsePlanetTexture(planet3Moon1Sphere, "./../../common/textures/rock.ppm");
     SceneNode* Planet3Moon1 = new SceneNode(planet3Moon1Sphere);
 
     Object* planet3Moon2Sphere = new Sphere();
-    planet3Moon2Sphere->LoadTexture("./../../common/textures/rock.ppm");
+    UsePlanetTexture(planet3Moon2Sphere, "./../../common/textures/rock.ppm");
     SceneNode* Planet3Moon2 = new SceneNode(planet3Moon2Sphere);
 
+    // A house standing on Planet1. Its diffuse map comes from house_obj.mtl,
+    // grass.ppm is only drawn if that map goes missing.
+    Object* houseModel = new Model("./../../common/objects/house/house_obj.obj", planetTextures);
+    houseModel->LoadTexture("./../../common/textures/grass.ppm", planetTextures);
+    SceneNode* House = new SceneNode(houseModel);
+
+    // Only images missing from the atlas were loaded on their own
+    TextureRegistry::PrintStatistics();
+
     // ================== Build the scene graph hierarchy ===============
 
     // Render our scene starting from the sun.
@@ -197,6 +232,7 @@ void SDLGraphicsProgram::Loop(){
     // Make the moons children of the planets
     Planet1->AddChild(Planet1Moon1);
     Planet1->AddChild(Planet1Moon2);
+    Planet1->AddChild(House);
 
     Planet2->AddChild(Planet2Moon1);
     Planet2->AddChild(Planet2Moon2);
@@ -337,10 +373,16 @@ void SDLGraphicsProgram::Loop(){
         Planet3Moon2->GetLocalTransform().Translate(-6.0f, 0.0f, 0.0f);
         Planet3Moon2->GetLocalTransform().Scale(0.35f, 0.35f, 0.35f);
 
+        House->GetLocalTransform().LoadIdentity();
+        House->GetLocalTransform().Translate(0.0f, 1.0f, 0.0f);
+        House->GetLocalTransform().Scale(0.6f, 0.6f, 0.6f);
+
         // ================== Update and render the scene ==================
 
         // Update our scene through our renderer
         m_renderer->Update();
+        // Stream any textures that finished loading to the GPU
+        TextureLoader::Update();
         // Render our scene using our selected renderer
         m_renderer->Render();
         // Delay to slow things down just a bit!
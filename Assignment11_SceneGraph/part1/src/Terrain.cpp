@@ -1,30 +1,52 @@
 #include "Terrain.hpp"
 #include "Image.hpp"
+#include "TextureCache.hpp"
+#include "Resample.hpp"
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 // Constructor for our object
 // Calls the initialization method
-Terrain::Terrain(unsigned int xSegs, unsigned int zSegs, std::string fileName) : 
+Terrain::Terrain(unsigned int xSegs, unsigned int zSegs, std::string fileName, ResampleFilter filter) : 
                 m_xSegments(xSegs), m_zSegments(zSegs) {
     std::cout << "(Terrain.cpp) Constructor called \n";
 
     // Load up some image data
     Image heightMap(fileName);
-    heightMap.LoadPPM(true);
+    if(!TextureCache::LoadImage(fileName, heightMap)){
+        std::cout << "(Terrain.cpp) Unable to load heightmap, the terrain will be flat: " << fileName << std::endl;
+    }
     // Set the height data for the image
-    // TODO: Currently there is a 1-1 mapping between a pixel and a segment
-    // You might consider interpolating values if there are more segments
-    // than pixels. 
+    // The heightmap is resampled to exactly one height per segment, so
+    // there may be more or fewer segments than pixels. With as many
+    // segments as pixels the heights are the pixel values themselves.
     float scale = 5.0f; // Note that this scales down the values to make
                         // the image a bit more flat.
     // Create height data
-    m_heightData = new int[m_xSegments*m_zSegments];
+    m_heightData = new float[m_xSegments*m_zSegments];
     // Set the height data equal to the grayscale value of the heightmap
     // Because the R,G,B will all be equal in a grayscale image, then
     // we just grab one of the color components.
-
-    // TODO: (Inclass) Implement populate heightData!
+    // A heightmap that failed to load is read as a single black pixel
+    int imageWidth = std::max(1, heightMap.GetWidth());
+    int imageHeight = std::max(1, heightMap.GetHeight());
+    std::vector<uint8_t> gray((size_t)imageWidth*imageHeight, 0);
+    const uint8_t* pixels = heightMap.GetPixelDataPtr();
+    for(size_t i=0; pixels != nullptr && i < gray.size(); ++i){
+        gray[i] = pixels[i*3];
+    }
+    // Segment (x,z) reads the pixel in column z of row x, so the resized
+    // image is zSegments wide and xSegments tall.
+    std::vector<float> heights((size_t)m_xSegments*m_zSegments);
+    Resample(gray.data(), imageWidth, imageHeight, 1, heights.data(), m_zSegments, m_xSegments, filter);
+
+    for(unsigned int z=0; z < m_zSegments; ++z){
+        for(unsigned int x=0; x < m_xSegments; ++x){
+            m_heightData[x+z*m_xSegments] = heights[(size_t)x*m_zSegments+z]/scale;
+        }
+    }
 
     Init();
 }
@@ -33,7 +55,7 @@ Terrain::Terrain(unsigned int xSegs, unsigned int zSegs, std::string fileName) :
 Terrain::~Terrain(){
     // Delete our allocatted higheithmap data
     if(m_heightData!=nullptr){
-        delete m_heightData;
+        delete[] m_heightData;
     }
 }
 
@@ -6,6 +6,8 @@
 
 
 #include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "TextureLoader.hpp"
 
 #include <stdio.h>
 #include <string.h>
@@ -14,6 +16,8 @@
 #include <iostream>
 #include <glad/glad.h>
 #include <memory>
+#include <algorithm>
+#include <cstring>
 
 // Default Constructor
 Texture::Texture(){
@@ -24,7 +28,16 @@ Texture::Texture(){
 // Default Destructor
 Texture::~Texture(){
 	// Delete our texture from the GPU
-	glDeleteTextures(1,&m_textureID);
+	if(m_textureID != 0){
+		glDeleteTextures(1,&m_textureID);
+	}
+	// Delete anything left over from an upload that did not finish
+	if(m_pendingID != 0){
+		glDeleteTextures(1,&m_pendingID);
+	}
+	if(m_uploadBuffer != 0){
+		glDeleteBuffers(1,&m_uploadBuffer);
+	}
 
     // Delete our image
     if(m_image != nullptr){
@@ -33,13 +46,45 @@ Texture::~Texture(){
 
 }
 
-void Texture::LoadTexture(const std::string filepath){
+void Texture::LoadTexture(const std::string filepath, const TextureSettings& settings){
 	// Set member variable
     m_filepath = filepath;
+    m_settings = settings;
     // Load our actual image data
-    // This method loads .ppm files of pixel data
+    // If an up to date cache file exists, the decoded pixels (and the
+    // mipmap levels) are mapped straight from it. Otherwise we decode
+    // the .ppm file, build the levels, and save both for next time.
     m_image = new Image(filepath);
-    m_image->LoadPPM(true);
+    BlockFormat compression = IsCompressionSupported() ? m_settings.compression : BlockFormat::None;
+    if(!TextureCache::LoadImage(filepath, *m_image, m_settings.mipmaps ? &m_mips : nullptr,
+                                &m_compressed, compression)){
+        std::cout << "Unable to load texture: " << filepath << std::endl;
+        delete m_image;
+        m_image = nullptr;
+        return;
+    }
+    UploadImage();
+}
+
+// Same as above, but the pixels were made in memory rather than read from
+// a file, so there is nothing to cache and the levels are built here.
+void Texture::LoadTexture(Image* image, const TextureSettings& settings){
+    m_filepath = "";
+    m_settings = settings;
+    m_image = image;
+    if(m_settings.mipmaps){
+        m_mips.Generate(m_image->GetPixelDataPtr(), m_image->GetWidth(), m_image->GetHeight());
+    }
+    UploadImage();
+}
+
+// Sends m_image (and m_mips) to the GPU. Images loaded from a file
+// were already compressed (or read compressed from the cache).
+void Texture::UploadImage(){
+    if(m_compressed.GetLevelCount() == 0 && m_settings.compression != BlockFormat::None && IsCompressionSupported()){
+        m_compressed.Compress(m_image->GetPixelDataPtr(), m_image->GetWidth(), m_image->GetHeight(),
+                              &m_mips, m_settings.compression);
+    }
 
     glEnable(GL_TEXTURE_2D); 
 	// Generate a buffer for our texture
@@ -50,29 +95,271 @@ void Texture::LoadTexture(const std::string filepath){
     glBindTexture(GL_TEXTURE_2D, m_textureID);
 	// Now we are going to setup some information about
 	// our textures.
+	ApplySettings();
+	// Rows of RGB pixels are tightly packed, and for widths that are not
+	// a multiple of 4 the default unpack alignment of 4 would misread them.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// At this point, we are now ready to load and send some data to OpenGL.
+	if(m_compressed.GetLevelCount() > 0){
+		// Blocks are sent as they are, the GPU decodes them when sampling
+		for(unsigned int level=0; level < m_compressed.GetLevelCount(); ++level){
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, GetCompressedFormat(),
+			                       m_compressed.GetWidth(level), m_compressed.GetHeight(level), 0,
+			                       m_compressed.GetLevelSize(level), m_compressed.GetLevelData(level));
+		}
+	}else{
+        // Note: Textures are always loaded flipped, so a .ppm is copied
+        //       once while it is decoded. On a cache hit this pointer is
+        //       the memory mapped .texcache file itself (already flipped),
+        //       so no intermediate copy is made.
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     GL_RGB,
+                     m_image->GetWidth(),
+                     m_image->GetHeight(),
+                     0,
+                     GL_RGB,
+                     GL_UNSIGNED_BYTE,
+                     m_image->GetPixelDataPtr()); // Here is the raw pixel data
+        // Upload each of the smaller mipmap levels we made on the CPU
+        for(unsigned int level=1; level <= m_mips.GetLevelCount(); ++level){
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGB,
+                         m_mips.GetWidth(level), m_mips.GetHeight(level), 0,
+                         GL_RGB, GL_UNSIGNED_BYTE, m_mips.GetLevelData(level));
+        }
+	}
+	// We are done with our texture data so we can unbind.    
+	glBindTexture(GL_TEXTURE_2D, 0);
+    m_ready = true;
+    FinishUpload();
+}
+
+// The GPU has its own copy of every level now
+void Texture::FinishUpload(){
+    if(m_settings.keepPixels){
+        return;
+    }
+    if(m_image != nullptr){
+        delete m_image;
+        m_image = nullptr;
+    }
+    m_mips.Clear();
+    m_compressed.Clear();
+}
+
+// Asks the driver once whether it supports S3TC
+bool Texture::IsCompressionSupported(){
+    static int supported = -1;
+    if(supported == -1){
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for(GLint i=0; i < count; ++i){
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if(name != nullptr && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0){
+                supported = 1;
+                break;
+            }
+        }
+    }
+    return supported == 1;
+}
+
+GLenum Texture::GetCompressedFormat() const{
+    return (m_compressed.GetFormat() == BlockFormat::BC3) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                                         : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+// Sets the sampler state of the currently bound texture
+void Texture::ApplySettings(){
+    // A mipmap filter on a texture without levels would leave the
+    // texture incomplete (and drawn black), so fall back to linear.
+    GLint minFilter = m_settings.minFilter;
+    if(m_mips.GetLevelCount() == 0 && minFilter != GL_NEAREST && minFilter != GL_LINEAR){
+        minFilter = GL_LINEAR;
+    }
 	// There are four parameters that must be set.
 	// GL_TEXTURE_MIN_FILTER - How texture filters (linearly, etc.)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); 
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter); 
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_settings.magFilter); 
 	// Wrap mode describes what to do if we go outside the boundaries of
 	// texture.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	// At this point, we are now ready to load and send some data to OpenGL.
-	glTexImage2D(GL_TEXTURE_2D,
-							0 ,
-						GL_RGB,
-                        m_image->GetWidth(),
-                        m_image->GetHeight(),
-						0,
-						GL_RGB,
-						GL_UNSIGNED_BYTE,
-						 m_image->GetPixelDataPtr()); // Here is the raw pixel data
-    // We are done with our texture data so we can unbind.
-    // Generate a mipmap
-    glGenerateMipmap(GL_TEXTURE_2D);                        
-	// We are done with our texture data so we can unbind.    
-	glBindTexture(GL_TEXTURE_2D, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_settings.wrapS); 
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, m_settings.wrapT); 
+    // Tell OpenGL exactly how many levels we are going to provide
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_mips.GetLevelCount());
+}
+
+void Texture::LoadTextureAsync(const std::string filepath, const TextureSettings& settings){
+    m_filepath = filepath;
+    m_settings = settings;
+    m_ready = false;
+    // Until the real image arrives we bind a single mid gray pixel,
+    // so the object can be drawn right away.
+    const uint8_t placeholder[3] = {128, 128, 128};
+    glGenTextures(1,&m_textureID);
+    glBindTexture(GL_TEXTURE_2D, m_textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, placeholder);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    // Decode on a worker thread
+    BlockFormat compression = IsCompressionSupported() ? m_settings.compression : BlockFormat::None;
+    TextureLoader::Submit(shared_from_this(), filepath, m_settings.mipmaps, compression);
+}
+
+// Allocates the real texture (with no data yet) and a pixel buffer
+// object large enough for the whole image and its mipmap levels.
+bool Texture::BeginUpload(Image* image, MipChain&& mips, CompressedChain&& compressed){
+    if(m_image != nullptr){
+        delete m_image;
+    }
+    m_image = image;
+    m_mips = std::move(mips);
+    m_compressed = std::move(compressed);
+    m_uploadLevel = 0;
+    m_uploadedRows = 0;
+    if(m_image->GetPixelDataPtr() == nullptr || m_image->GetWidth() <= 0 || m_image->GetHeight() <= 0){
+        std::cout << "Unable to load texture, keeping placeholder: " << m_filepath << std::endl;
+        delete m_image;
+        m_image = nullptr;
+        return false;
+    }
+
+    glGenTextures(1,&m_pendingID);
+    glBindTexture(GL_TEXTURE_2D, m_pendingID);
+    ApplySettings();
+    size_t bufferSize = 0;
+    for(unsigned int level=0; level < GetUploadLevelCount(); ++level){
+        UploadLevel info = GetUploadLevel(level);
+        size_t levelSize = info.rowBytes*info.rowCount;
+        if(m_compressed.GetLevelCount() > 0){
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, GetCompressedFormat(),
+                                   info.width, info.height, 0, levelSize, nullptr);
+        }else{
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, info.width, info.height, 0,
+                         GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        }
+        bufferSize += levelSize;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1,&m_uploadBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+unsigned int Texture::GetUploadLevelCount() const{
+    if(m_compressed.GetLevelCount() > 0){
+        return m_compressed.GetLevelCount();
+    }
+    return 1 + m_mips.GetLevelCount();
+}
+
+Texture::UploadLevel Texture::GetUploadLevel(unsigned int level) const{
+    UploadLevel info;
+    if(m_compressed.GetLevelCount() > 0){
+        info.width = m_compressed.GetWidth(level);
+        info.height = m_compressed.GetHeight(level);
+        info.data = m_compressed.GetLevelData(level);
+        info.rowBytes = (size_t)((info.width+3)/4) * GetBlockSize(m_compressed.GetFormat());
+        info.rowCount = (info.height+3)/4;
+        info.pixelsPerRow = 4;
+    }else{
+        bool base = (level == 0);
+        info.width = base ? m_image->GetWidth() : m_mips.GetWidth(level);
+        info.height = base ? m_image->GetHeight() : m_mips.GetHeight(level);
+        info.data = base ? m_image->GetPixelDataPtr() : m_mips.GetLevelData(level);
+        info.rowBytes = (size_t)info.width*3;
+        info.rowCount = info.height;
+        info.pixelsPerRow = 1;
+    }
+    return info;
+}
+
+// Copies the next band of rows into the pixel buffer and has OpenGL
+// copy them from there into the texture. The driver can do that copy
+// without stalling us, and each call does a bounded amount of work so
+// a large texture is spread over several frames.
+// The full size image goes first, then each mipmap level in turn.
+size_t Texture::UploadRows(size_t maxBytes){
+    if(m_image == nullptr || m_uploadBuffer == 0){
+        return 0;
+    }
+    size_t uploaded = 0;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+    glBindTexture(GL_TEXTURE_2D, m_pendingID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    while(!m_ready && uploaded < maxBytes){
+        UploadLevel info = GetUploadLevel(m_uploadLevel);
+        // Levels sit back to back in the pixel buffer
+        size_t levelOffset = 0;
+        for(unsigned int level=0; level < m_uploadLevel; ++level){
+            UploadLevel previous = GetUploadLevel(level);
+            levelOffset += previous.rowBytes*previous.rowCount;
+        }
+
+        int rows = std::max<int>(1, std::min<size_t>((maxBytes - uploaded) / info.rowBytes, info.rowCount - m_uploadedRows));
+        size_t offset = levelOffset + info.rowBytes*m_uploadedRows;
+        size_t bytes = info.rowBytes*rows;
+
+        // Every band goes to its own part of the buffer, so there is
+        // never a need to wait for the GPU before writing.
+        const uint8_t* source = info.data + info.rowBytes*m_uploadedRows;
+        void* destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bytes,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        bool buffered = (destination != nullptr);
+        if(buffered){
+            memcpy(destination, source, bytes);
+            // GL_FALSE means the contents were lost while it was mapped
+            buffered = (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE);
+        }
+        // With a buffer bound, the 'pixels' argument is an offset into it.
+        // If the band never made it into the buffer, it is sent straight
+        // from our memory instead, so the texture never gets garbage.
+        const void* pixels = reinterpret_cast<const void*>(offset);
+        if(!buffered){
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            pixels = source;
+        }
+        int y = m_uploadedRows*info.pixelsPerRow;
+        int height = std::min(rows*info.pixelsPerRow, info.height - y);
+        if(m_compressed.GetLevelCount() > 0){
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, m_uploadLevel, 0, y, info.width, height,
+                                      GetCompressedFormat(), bytes, pixels);
+        }else{
+            glTexSubImage2D(GL_TEXTURE_2D, m_uploadLevel, 0, y, info.width, height,
+                            GL_RGB, GL_UNSIGNED_BYTE, pixels);
+        }
+        if(!buffered){
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+        }
+        m_uploadedRows += rows;
+        uploaded += bytes;
+
+        if(m_uploadedRows >= info.rowCount){
+            m_uploadedRows = 0;
+            ++m_uploadLevel;
+            if(m_uploadLevel >= GetUploadLevelCount()){
+                // Swap the placeholder out for the finished texture
+                glDeleteTextures(1,&m_textureID);
+                m_textureID = m_pendingID;
+                m_pendingID = 0;
+                m_ready = true;
+            }
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if(m_ready){
+        glDeleteBuffers(1,&m_uploadBuffer);
+        m_uploadBuffer = 0;
+        FinishUpload();
+    }
+    return uploaded;
 }
 
 
@@ -0,0 +1,69 @@
+#include "TextureRegistry.hpp"
+
+#include <iostream>
+#include <filesystem>
+
+std::unordered_map<std::string, std::weak_ptr<Texture>> TextureRegistry::s_textures;
+unsigned int TextureRegistry::s_loads = 0;
+unsigned int TextureRegistry::s_reuses = 0;
+
+// Two different spellings of the same file (e.g. "./a/../rock.ppm" and
+// "rock.ppm") should find the same texture, so the path is made canonical.
+std::string TextureRegistry::MakeKey(const std::string& filepath, const TextureSettings& settings){
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(filepath, error);
+    std::string key = error ? filepath : canonical.string();
+    key += "|" + std::to_string(settings.minFilter);
+    key += "|" + std::to_string(settings.magFilter);
+    key += "|" + std::to_string(settings.wrapS);
+    key += "|" + std::to_string(settings.wrapT);
+    key += settings.mipmaps ? "|mip" : "|nomip";
+    key += "|" + std::to_string((int)settings.compression);
+    key += settings.keepPixels ? "|keep" : "";
+    return key;
+}
+
+std::shared_ptr<Texture> TextureRegistry::Get(const std::string& filepath, const TextureSettings& settings){
+    std::string key = MakeKey(filepath, settings);
+    auto it = s_textures.find(key);
+    if(it != s_textures.end()){
+        std::shared_ptr<Texture> texture = it->second.lock();
+        if(texture != nullptr){
+            ++s_reuses;
+            return texture;
+        }
+    }
+    // Either never loaded, or every user has let go of it
+    RemoveExpired();
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+    // Decoded on a worker thread, a placeholder is shown until then
+    texture->LoadTextureAsync(filepath, settings);
+    s_textures[key] = texture;
+    ++s_loads;
+    return texture;
+}
+
+void TextureRegistry::RemoveExpired(){
+    for(auto it = s_textures.begin(); it != s_textures.end();){
+        if(it->second.expired()){
+            it = s_textures.erase(it);
+        }else{
+            ++it;
+        }
+    }
+}
+
+unsigned int TextureRegistry::GetLiveCount(){
+    unsigned int count = 0;
+    for(auto& entry : s_textures){
+        if(!entry.second.expired()){
+            ++count;
+        }
+    }
+    return count;
+}
+
+void TextureRegistry::PrintStatistics(){
+    std::cout << "Texture registry: " << s_loads << " loaded, " << s_reuses << " shared, "
+              << GetLiveCount() << " alive" << std::endl;
+}
@@ -265,3 +265,10 @@ void VertexBufferLayout::CreateNormalBufferLayout(unsigned int vcount,unsigned i
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferObject);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, icount*sizeof(unsigned int), idata,GL_STATIC_DRAW);
     }
+
+// Overwrites the vertex buffer in place. The layout of the attributes
+// stays the same, so the vertex array does not need to be set up again.
+void VertexBufferLayout::UpdateVertexData(unsigned int vcount, float* vdata){
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexPositionBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vcount*sizeof(float), vdata);
+}
@@ -0,0 +1,281 @@
+/** @file ImageTests.cpp
+ *  @brief Checks of the image code that need no window or GPU.
+ *
+ *  Each test prints PASS or FAIL with the numbers it checked, and the
+ *  program returns non-zero if any test failed.
+ *
+ *      BlockCompression    BC1 and BC3 round trips must stay above a PSNR
+ *                          threshold (measured with CompareImages)
+ *      TextureCacheBlocks  compressed levels stored in the texture cache
+ *                          must come back identical to fresh ones
+ *      ConvolutionShader   Convolve must match a pixel by pixel copy of
+ *                          the framebuffer shader within a PSNR tolerance
+ *      TiledLayout         a Tiled image must read, convert back, and
+ *                          convolve exactly like a Linear one
+ *
+ *  Run from the test directory so the default paths resolve:
+ *
+ *      python3 build.py && ./tests
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#include "Image.hpp"
+#include "ImageCompare.hpp"
+#include "BlockCompression.hpp"
+#include "MipChain.hpp"
+#include "TextureCache.hpp"
+#include "Convolution.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+// Where the textures used by the tests live
+static const std::string s_textureDirectory = "./../../../common/textures/";
+
+// Number of tests that failed so far
+static int s_failures = 0;
+
+// Prints the result of one check and counts it if it failed
+static void Check(bool passed, const std::string& name, const std::string& details){
+    std::cout << (passed ? "PASS " : "FAIL ") << name << ": " << details << std::endl;
+    if(!passed){
+        ++s_failures;
+    }
+}
+
+// Compresses pixels, expands the blocks again, and returns the PSNR of
+// the result against the original
+static double RoundTripPSNR(const uint8_t* pixels, int width, int height, BlockFormat format){
+    std::vector<uint8_t> blocks(GetCompressedSize(format, width, height));
+    CompressBlocks(pixels, width, height, 3, format, blocks.data());
+    std::vector<uint8_t> decoded((size_t)width*height*3);
+    DecompressBlocks(blocks.data(), width, height, format, decoded.data(), 3);
+    ImageDifference difference;
+    CompareSettings settings;
+    settings.computeSSIM = false;
+    CompareImages(pixels, decoded.data(), width, height, difference, settings);
+    return difference.psnr;
+}
+
+// BC1 and BC3 keep 5:6:5 colors and four shades per 4x4 block, which
+// costs photographs a few dB. 30 dB is well below what every texture
+// here reaches, but far above what a broken encoder (wrong endpoints,
+// swapped indices) gets.
+static void TestBlockCompression(){
+    const double threshold = 30.0;
+    // A smooth gradient, 2 pixels past a multiple of 4 so the repeated
+    // edge pixels of partial blocks are covered too
+    const int width = 66, height = 34;
+    std::vector<uint8_t> gradient((size_t)width*height*3);
+    for(int y=0; y < height; ++y){
+        for(int x=0; x < width; ++x){
+            uint8_t* pixel = &gradient[((size_t)y*width + x)*3];
+            pixel[0] = x*255/(width-1);
+            pixel[1] = y*255/(height-1);
+            pixel[2] = 128;
+        }
+    }
+    for(BlockFormat format : {BlockFormat::BC1, BlockFormat::BC3}){
+        const char* formatName = (format == BlockFormat::BC1) ? "BC1" : "BC3";
+        double psnr = RoundTripPSNR(gradient.data(), width, height, format);
+        Check(psnr >= threshold, std::string("BlockCompression ") + formatName + " gradient",
+              "PSNR " + std::to_string(psnr) + " dB (at least " + std::to_string(threshold) + ")");
+        for(const char* name : {"rock.ppm", "brick.ppm", "container.ppm"}){
+            Image image(s_textureDirectory + name);
+            if(!image.LoadPPM(false)){
+                Check(false, std::string("BlockCompression ") + formatName + " " + name, "could not be loaded");
+                continue;
+            }
+            psnr = RoundTripPSNR(image.GetPixelDataPtr(), image.GetWidth(), image.GetHeight(), format);
+            Check(psnr >= threshold, std::string("BlockCompression ") + formatName + " " + name,
+                  "PSNR " + std::to_string(psnr) + " dB (at least " + std::to_string(threshold) + ")");
+        }
+    }
+}
+
+// The first load compresses and stores the blocks, the second must read
+// the very same blocks back without compressing again
+static void TestTextureCacheBlocks(){
+    std::string filepath = s_textureDirectory + "brick.ppm";
+    std::remove(TextureCache::GetCachePath(filepath).c_str());
+
+    Image first(filepath);
+    MipChain firstMips;
+    CompressedChain firstBlocks;
+    TextureCache::LoadImage(filepath, first, &firstMips, &firstBlocks, BlockFormat::BC1);
+
+    unsigned int hits = TextureCache::GetHits();
+    Image second(filepath);
+    MipChain secondMips;
+    CompressedChain secondBlocks;
+    bool hit = TextureCache::Load(filepath, second, &secondMips, &secondBlocks, BlockFormat::BC1);
+    bool same = hit && TextureCache::GetHits() == hits + 1
+             && secondBlocks.GetLevelCount() == 1 + secondMips.GetLevelCount()
+             && secondBlocks.GetLevelCount() == firstBlocks.GetLevelCount()
+             && secondBlocks.GetDataSize() == firstBlocks.GetDataSize()
+             && memcmp(secondBlocks.GetDataPtr(), firstBlocks.GetDataPtr(), firstBlocks.GetDataSize()) == 0;
+    Check(same, "TextureCacheBlocks BC1 brick.ppm",
+          std::to_string(secondBlocks.GetLevelCount()) + " levels, " + std::to_string(secondBlocks.GetDataSize())
+          + " bytes read back from the cache");
+
+    // Asking for another format still hits, just without blocks
+    Image third(filepath);
+    CompressedChain otherBlocks;
+    hit = TextureCache::Load(filepath, third, nullptr, &otherBlocks, BlockFormat::BC3);
+    Check(hit && otherBlocks.GetLevelCount() == 0, "TextureCacheBlocks BC3 brick.ppm",
+          "pixels hit, no BC3 blocks in a BC1 entry");
+}
+
+// What texture() returns for a GL_LINEAR, GL_REPEAT lookup at (u,v):
+// the four texels around the point blended by distance, 0 to 1
+static void SampleLinearRepeat(const uint8_t* pixels, int width, int height, float u, float v, float rgb[3]){
+    float x = u*width - 0.5f;
+    float y = v*height - 0.5f;
+    int x0 = (int)std::floor(x);
+    int y0 = (int)std::floor(y);
+    float fx = x - x0;
+    float fy = y - y0;
+    auto texel = [&](int tx, int ty, int c){
+        tx = ((tx % width) + width) % width;
+        ty = ((ty % height) + height) % height;
+        return pixels[((size_t)ty*width + tx)*3 + c]/255.0f;
+    };
+    for(int c=0; c < 3; ++c){
+        float bottom = texel(x0, y0, c)*(1.0f - fx) + texel(x0+1, y0, c)*fx;
+        float top = texel(x0, y0+1, c)*(1.0f - fx) + texel(x0+1, y0+1, c)*fx;
+        rgb[c] = bottom*(1.0f - fy) + top*fy;
+    }
+}
+
+// shaders/fboFrag.glsl from Assignment10_fbo run one pixel at a time,
+// written the way the shader is rather than the way Convolve is
+static void ShaderReference(const uint8_t* pixels, int width, int height, uint8_t* out){
+    const float offset = 1.0f/300.0f;
+    const float offsets[9][2] = {
+        {-offset,  offset}, {0.0f,  offset}, {offset,  offset},
+        {-offset,  0.0f},   {0.0f,  0.0f},   {offset,  0.0f},
+        {-offset, -offset}, {0.0f, -offset}, {offset, -offset}
+    };
+    const float kernel[9] = {1.0f,  1.0f, 1.0f,
+                             1.0f, -8.0f, 1.0f,
+                             1.0f,  1.0f, 1.0f};
+    for(int y=0; y < height; ++y){
+        for(int x=0; x < width; ++x){
+            float u = (x + 0.5f)/width;
+            float v = (y + 0.5f)/height;
+            float color[3] = {0.0f, 0.0f, 0.0f};
+            for(int i=0; i < 9; ++i){
+                float sample[3];
+                SampleLinearRepeat(pixels, width, height, u + offsets[i][0], v + offsets[i][1], sample);
+                for(int c=0; c < 3; ++c){
+                    color[c] += sample[c]*kernel[i];
+                }
+            }
+            // An 8 bit framebuffer clamps and rounds what the shader writes
+            for(int c=0; c < 3; ++c){
+                out[((size_t)y*width + x)*3 + c] = (uint8_t)(std::min(1.0f, std::max(0.0f, color[c]))*255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+// The framebuffer shader's taps are 1/300 of the texture apart, so they
+// fall between pixels for most sizes and are blended. GPUs blend with 8
+// bit fractions, so Convolve only has to come close to the reference:
+// 40 dB is far above what a wrong offset, edge mode or kernel row order
+// gets.
+static void TestConvolutionShader(){
+    const double threshold = 40.0;
+    for(const char* name : {"brick.ppm", "container.ppm"}){
+        Image image(s_textureDirectory + name);
+        if(!image.LoadPPM(true)){
+            Check(false, std::string("ConvolutionShader ") + name, "could not be loaded");
+            continue;
+        }
+        int width = image.GetWidth();
+        int height = image.GetHeight();
+        std::vector<uint8_t> expected((size_t)width*height*3);
+        std::vector<uint8_t> result(expected.size());
+        ShaderReference(image.GetPixelDataPtr(), width, height, expected.data());
+        Convolve(image.GetPixelDataPtr(), width, height, result.data(), ConvolutionKernel::Laplacian(),
+                 ConvolutionSettings::MatchShader(width, height));
+        ImageDifference difference;
+        CompareSettings settings;
+        settings.computeSSIM = false;
+        CompareImages(expected.data(), result.data(), width, height, difference, settings);
+        Check(difference.psnr >= threshold, std::string("ConvolutionShader ") + name,
+              std::to_string(width) + "x" + std::to_string(height) + ", PSNR " + std::to_string(difference.psnr)
+              + " dB (at least " + std::to_string(threshold) + "), max difference " + std::to_string(difference.maxDifference));
+    }
+}
+
+// Fills a width x height image with a pattern that differs in every
+// channel, row and column
+static void FillPattern(Image& image, int width, int height){
+    image.Create(width, height);
+    uint8_t* pixels = image.GetPixelDataPtr();
+    for(size_t i=0; i < (size_t)width*height*3; ++i){
+        pixels[i] = (uint8_t)(i*7 + (i/3/width)*13);
+    }
+}
+
+// Sizes that are not a whole number of tiles check the padding. The
+// kernels cover both the separable and the 2D path, whole and
+// fractional steps, and both edge modes.
+static void TestTiledLayout(){
+    for(int size : {37, 300}){
+        int width = size;
+        int height = size*2/3;
+        Image linear("linear");
+        Image tiled("tiled");
+        FillPattern(linear, width, height);
+        FillPattern(tiled, width, height);
+        tiled.SetLayout(PixelLayout::Tiled);
+        bool same = true;
+        for(int y=0; y < height; ++y){
+            for(int x=0; x < width; ++x){
+                same = same && tiled.GetPixelR(x, y) == linear.GetPixelR(x, y)
+                            && tiled.GetPixelG(x, y) == linear.GetPixelG(x, y)
+                            && tiled.GetPixelB(x, y) == linear.GetPixelB(x, y);
+            }
+        }
+        tiled.SetLayout(PixelLayout::Linear);
+        same = same && memcmp(tiled.GetPixelDataPtr(), linear.GetPixelDataPtr(), (size_t)width*height*3) == 0;
+        std::string dimensions = std::to_string(width) + "x" + std::to_string(height);
+        Check(same, "TiledLayout accessors " + dimensions, "every pixel reads the same and converts back unchanged");
+
+        ConvolutionSettings repeat = ConvolutionSettings::MatchShader(width, height);
+        ConvolutionSettings clamp;
+        clamp.edgeMode = EdgeMode::ClampToEdge;
+        const ConvolutionKernel kernels[] = {ConvolutionKernel::Laplacian(), ConvolutionKernel::Gaussian(2, 1.0f)};
+        for(const ConvolutionKernel& kernel : kernels){
+            for(const ConvolutionSettings& settings : {repeat, clamp}){
+                FillPattern(linear, width, height);
+                FillPattern(tiled, width, height);
+                tiled.SetLayout(PixelLayout::Tiled);
+                Convolve(linear, kernel, settings);
+                Convolve(tiled, kernel, settings);
+                tiled.SetLayout(PixelLayout::Linear);
+                same = memcmp(tiled.GetPixelDataPtr(), linear.GetPixelDataPtr(), (size_t)width*height*3) == 0;
+                Check(same, "TiledLayout Convolve " + dimensions,
+                      std::to_string(kernel.GetWidth()) + "x" + std::to_string(kernel.GetHeight())
+                      + (settings.edgeMode == EdgeMode::Repeat ? " repeat" : " clamp") + ", identical to Linear");
+            }
+        }
+    }
+}
+
+int main(){
+    TestBlockCompression();
+    TestTextureCacheBlocks();
+    TestConvolutionShader();
+    TestTiledLayout();
+    std::cout << (s_failures == 0 ? "All tests passed" : std::to_string(s_failures) + " test(s) failed") << std::endl;
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+# Run with: python3 build.py
+# Then run from this directory with: ./tests
+import os
+import platform
+
+# (1)==================== COMMON CONFIGURATION OPTIONS ======================= #
+COMPILER="g++ -O2 -g -std=c++17"   # The compiler we want to use 
+                                    #(You may try g++ if you have trouble)
+# Only the image code is built, so the tests need neither SDL nor OpenGL
+# and can run anywhere, e.g. on a machine without a display.
+PROJECT_SOURCES=["TextureCache","Image","MipChain","FloatImage","BufferPool","PixelLayout",
+                 "PPMFormat","MappedFile","ImageCompare","BlockCompression","Convolution"]
+SOURCE=" ".join("./../src/"+name+".cpp" for name in PROJECT_SOURCES)+" ./*.cpp"
+EXECUTABLE="tests"       # Name of the final executable
+# ======================= COMMON CONFIGURATION OPTIONS ======================= #
+
+# (2)=================== Platform specific configuration ===================== #
+# For each platform we need to set the following items
+ARGUMENTS=""            # Arguments needed for our program (Add others as you see fit)
+INCLUDE_DIR=""          # Which directories do we want to include.
+LIBRARIES=""            # What libraries do we want to include
+
+if platform.system()=="Linux":
+    ARGUMENTS="-D LINUX" # -D is a #define sent to preprocessor
+    INCLUDE_DIR="-I ./../include/ -I ./../../../common/thirdparty/glm/"
+    LIBRARIES="-pthread"
+elif platform.system()=="Darwin":
+    ARGUMENTS="-D MAC" # -D is a #define sent to the preprocessor.
+    INCLUDE_DIR="-I ./../include/ -I./../../../common/thirdparty/old/glm"
+    LIBRARIES=""
+elif platform.system()=="Windows":
+    ARGUMENTS="-D MINGW -static-libgcc -static-libstdc++" 
+    INCLUDE_DIR="-I./../include/ -I./../../../common/thirdparty/old/glm/"
+    EXECUTABLE="tests.exe"
+    LIBRARIES=""
+# (2)=================== Platform specific configuration ===================== #
+
+# (3)====================== Building the Executable ========================== #
+# Build a string of our compile commands that we run in the terminal
+compileString=COMPILER+" "+ARGUMENTS+" "+SOURCE+" -o "+EXECUTABLE+" "+" "+INCLUDE_DIR+" "+LIBRARIES
+# Print out the compile string
+# This is the command you can type
+print("============v (Command running on terminal) v===========================")
+print("Compilng on: "+platform.system())
+print(compileString)
+print("========================================================================")
+# Run our command 
+# Here I am using an exit_code so you can
+# also compile & run in one step as
+# python3 build.py && ./tests
+# If compilation fails, ./tests will not run.
+exit_code = os.system(compileString)
+exit(0 if exit_code==0 else 1)
+# ========================= Building the Executable ========================== #